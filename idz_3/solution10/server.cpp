@@ -14,6 +14,9 @@
 #include <map>
 #include <csignal>
 #include <atomic>
+#include <queue>
+#include <chrono>
+#include <condition_variable>
 
 // Глобальные переменные для обработки сигналов
 std::atomic<bool> serverRunning(true);
@@ -43,14 +46,22 @@ struct SwarmInfo {
     bool active;
     int lastAssignedArea;
     time_t lastSeen;
+    std::chrono::steady_clock::time_point deadline;  // Срок, после которого стая считается неактивной
 };
 
+// Срок неактивности стаи в очереди проверки
+typedef std::pair<std::chrono::steady_clock::time_point, int> SwarmDeadline;
+
 std::vector<LogEntry> systemLog;
 std::mutex logMutex;
 std::vector<Observer> observers;
 std::mutex observersMutex;
 std::map<int, SwarmInfo> swarmRegistry;  // Реестр всех стай
 std::mutex swarmMutex;
+// Очередь сроков неактивности (минимальная куча), защищена swarmMutex.
+// Каждое обращение стаи добавляет новый срок; устаревшие записи отбрасываются при извлечении
+std::priority_queue<SwarmDeadline, std::vector<SwarmDeadline>, std::greater<SwarmDeadline>> swarmDeadlines;
+std::condition_variable swarmDeadlineAdded;
 std::mutex forestAreasMutex;
 const int SWARM_TIMEOUT = 10;  // Таймаут в секундах для определения неактивных стай
 int serverSocket = -1;         // Глобальная переменная для серверного сокета
@@ -184,37 +195,56 @@ void handleObserver(int clientSocket) {
     close(clientSocket);
 }
 
-// Поток для проверки неактивных стай
+// Продлевает срок активности стаи. Вызывается под swarmMutex
+void scheduleSwarmDeadline(SwarmInfo& swarm) {
+    swarm.deadline = std::chrono::steady_clock::now() + std::chrono::seconds(SWARM_TIMEOUT);
+    swarmDeadlines.push(SwarmDeadline(swarm.deadline, swarm.id));
+    swarmDeadlineAdded.notify_one();
+}
+
+// Поток для проверки неактивных стай: спит до ближайшего срока и проверяет только истекшие
 void monitorInactiveSwarms(std::vector<ForestArea>& forestAreas) {
+    std::unique_lock<std::mutex> lockSwarm(swarmMutex);
     while (serverRunning) {
-        sleep(3); // Проверяем каждые 3 секунды
-        
-        if (!serverRunning) break; // Проверяем флаг остановки сервера
-        
-        time_t now = time(0);
-        std::lock_guard<std::mutex> lockSwarm(swarmMutex);
-        std::lock_guard<std::mutex> lockForest(forestAreasMutex);
-        
-        for (auto& swarmPair : swarmRegistry) {
-            if (swarmPair.second.active && 
-                (now - swarmPair.second.lastSeen) > SWARM_TIMEOUT) {
-                
-                int swarmId = swarmPair.first;
-                swarmPair.second.active = false;
-                
-                // Освобождаем участок, если он был назначен
-                for (auto& area : forestAreas) {
-                    if (area.assignedToSwarm == swarmId && !area.isSearched) {
-                        area.isAssigned = false;
-                        area.assignedToSwarm = -1;
-                        addLogEntry("Стая #" + std::to_string(swarmId) + 
-                                   " превысила таймаут неактивности. Участок #" + 
-                                   std::to_string(area.id) + 
-                                   " снова доступен для поиска.");
-                    }
+        auto now = std::chrono::steady_clock::now();
+
+        // Ожидание ограничено секундой, чтобы вовремя заметить остановку сервера
+        auto wakeUp = now + std::chrono::seconds(1);
+        if (swarmDeadlines.empty() || swarmDeadlines.top().first > now) {
+            if (!swarmDeadlines.empty()) wakeUp = std::min(wakeUp, swarmDeadlines.top().first);
+            swarmDeadlineAdded.wait_until(lockSwarm, wakeUp);
+            continue;
+        }
+
+        SwarmDeadline expired = swarmDeadlines.top();
+        swarmDeadlines.pop();
+
+        // Срок устарел, если стая с тех пор обращалась к серверу или уже неактивна
+        auto it = swarmRegistry.find(expired.second);
+        if (it == swarmRegistry.end() || !it->second.active || it->second.deadline != expired.first) {
+            continue;
+        }
+
+        int swarmId = expired.second;
+        it->second.active = false;
+
+        // Участки освобождаются без удержания swarmMutex, чтобы не нарушать порядок блокировок основного потока.
+        // Как и при DISCONNECT, освобождаются все необысканные участки стаи, а не только последний назначенный
+        lockSwarm.unlock();
+        {
+            std::lock_guard<std::mutex> lockForest(forestAreasMutex);
+            for (auto& area : forestAreas) {
+                if (area.assignedToSwarm == swarmId && !area.isSearched) {
+                    area.isAssigned = false;
+                    area.assignedToSwarm = -1;
+                    addLogEntry("Стая #" + std::to_string(swarmId) +
+                               " превысила таймаут неактивности. Участок #" +
+                               std::to_string(area.id) +
+                               " снова доступен для поиска.");
                 }
             }
         }
+        lockSwarm.lock();
     }
     std::cout << "Монитор неактивных стай завершил работу" << std::endl;
 }
@@ -390,6 +420,7 @@ int main(int argc, char* argv[]) {
                 if (swarmRegistry.find(swarmId) != swarmRegistry.end()) {
                     swarmRegistry[swarmId].lastSeen = time(0);
                     swarmRegistry[swarmId].active = true;
+                    scheduleSwarmDeadline(swarmRegistry[swarmId]);
                     addLogEntry("Стая #" + std::to_string(swarmId) + " возобновила работу");
                 } 
                 // Если стая новая, добавляем ее в реестр
@@ -400,6 +431,7 @@ int main(int argc, char* argv[]) {
                     newSwarm.lastAssignedArea = -1;
                     newSwarm.lastSeen = time(0);
                     swarmRegistry[swarmId] = newSwarm;
+                    scheduleSwarmDeadline(swarmRegistry[swarmId]);
                     addLogEntry("Стая #" + std::to_string(swarmId) + " начала работу");
                 }
             }
@@ -0,0 +1,405 @@
+// bee_assignment.h
+#ifndef BEE_ASSIGNMENT_H
+#define BEE_ASSIGNMENT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "bee_sector_allocator.h"
+
+#define ASSIGN_TILE_SIDE 8 // Сторона плитки пространственного индекса: 8x8 секторов в одном 64-битном слове
+#define SECTOR_COST_LEVELS 4 // Количество уровней оценки стоимости поиска (густота леса)
+#define SECTOR_COST_PATCH 4 // Густота леса одинакова на участке 4x4 сектора
+#define SEARCH_COST_WEIGHT 2.0 // Один уровень стоимости поиска в единицах перелета на соседний сектор
+#define MAX_PRIORITY_REGIONS 8 // Максимальное количество приоритетных областей
+
+// Политика выбора сектора для стаи. Выбирается при запуске сервера и действует во всех играх
+enum AssignmentPolicy {
+    POLICY_LOWEST,   // Свободный сектор с наименьшим номером (начиная с участка рабочего потока)
+    POLICY_LOCALITY, // Ближайший к последнему сектору стаи
+    POLICY_COST,     // Минимум перелета и оценки стоимости поиска: дешевые секторы ищутся раньше
+    POLICY_PRIORITY  // Сначала приоритетные области, внутри области - ближайший сектор
+};
+
+inline const char* policyName(AssignmentPolicy policy) {
+    static const char* names[] = {"lowest", "locality", "cost", "priority"};
+    return names[policy];
+}
+
+inline bool parsePolicy(const char* name, AssignmentPolicy& policy) {
+    for (int p = POLICY_LOWEST; p <= POLICY_PRIORITY; p++) {
+        if (strcmp(name, policyName((AssignmentPolicy)p)) == 0) {
+            policy = (AssignmentPolicy)p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Приоритетная область леса: прямоугольник секторов, границы включаются
+struct PriorityRegion {
+    int x0, y0, x1, y1;
+};
+
+// Лес - квадратная сетка: сектор с номером id находится в клетке (id % width, id / width).
+// Улей стоит в центре леса
+struct ForestGrid {
+    int count = 0;
+    int width = 1;
+    int height = 1;
+
+    void init(int sectorCount) {
+        count = sectorCount;
+        width = std::max(1, (int)std::ceil(std::sqrt((double)sectorCount)));
+        height = std::max(1, (sectorCount + width - 1) / width);
+    }
+
+    int x(int id) const { return id % width; }
+    int y(int id) const { return id / width; }
+    int hiveX() const { return width / 2; }
+    int hiveY() const { return height / 2; }
+
+    // Расстояние перелета между секторами; -1 - улей
+    double distance(int from, int to) const {
+        double fx = from < 0 ? hiveX() : x(from), fy = from < 0 ? hiveY() : y(from);
+        double tx = to < 0 ? hiveX() : x(to), ty = to < 0 ? hiveY() : y(to);
+        return std::sqrt((fx - tx) * (fx - tx) + (fy - ty) * (fy - ty));
+    }
+
+    // Оценка стоимости поиска в секторе от 1 до SECTOR_COST_LEVELS (детерминированная густота леса)
+    int cost(int id) const {
+        uint32_t h = (uint32_t)(x(id) / SECTOR_COST_PATCH) * 0x9E3779B1u ^ (uint32_t)(y(id) / SECTOR_COST_PATCH) * 0x85EBCA77u;
+        h ^= h >> 15;
+        h *= 0x2C1B3C6Du;
+        h ^= h >> 12;
+        return 1 + (int)(h % SECTOR_COST_LEVELS);
+    }
+};
+
+// Пространственный индекс свободных секторов: дерево квадрантов над плитками 8x8 секторов.
+// Лист - 64-битное слово плитки (бит установлен - сектор свободен), листья пронумерованы
+// кодом Мортона, поэтому потомки узла k уровня ниже - 4k..4k+3. Узел хранит число свободных
+// секторов под собой. Поиск ближайшего сектора идет по дереву лучшим-первым: раскрывается
+// узел с наименьшим расстоянием до его прямоугольника, пустые поддеревья пропускаются, так что
+// просматривается O(log n) узлов, пока рядом есть свободные секторы.
+// Захват - CAS над словом плитки, как в SectorAllocator; счетчики узлов обновляются после
+// и могут ненадолго отставать, что приводит лишь к лишнему просмотру узла
+class SpatialIndex {
+public:
+    // Строит индекс из секторов, для которых inLayer(id) истинно. Вызывается до запуска рабочих потоков
+    template <typename Predicate>
+    void init(const ForestGrid& forest, Predicate inLayer) {
+        grid = forest;
+        int tilesX = (grid.width + ASSIGN_TILE_SIDE - 1) / ASSIGN_TILE_SIDE;
+        int tilesY = (grid.height + ASSIGN_TILE_SIDE - 1) / ASSIGN_TILE_SIDE;
+        depth = 0;
+        while ((1 << depth) < std::max(tilesX, tilesY)) depth++;
+        side = 1 << depth;
+
+        size_t leafCount = (size_t)side * side;
+        words.reset(new std::atomic<uint64_t>[leafCount]);
+        for (size_t i = 0; i < leafCount; i++) words[i].store(0, std::memory_order_relaxed);
+        for (int id = 0; id < grid.count; id++) {
+            if (!inLayer(id)) continue;
+            uint64_t bit = 1ULL << bitOf(id);
+            words[leafOf(id)].store(words[leafOf(id)].load(std::memory_order_relaxed) | bit, std::memory_order_relaxed);
+        }
+
+        // Счетчики узлов снизу вверх
+        counts.clear();
+        counts.resize(depth);
+        for (int level = depth - 1; level >= 0; level--) {
+            size_t nodes = (size_t)1 << (2 * level);
+            counts[level].reset(new std::atomic<int>[nodes]);
+            for (size_t m = 0; m < nodes; m++) {
+                int sum = 0;
+                for (size_t c = 4 * m; c < 4 * m + 4; c++) {
+                    sum += level + 1 == depth ? __builtin_popcountll(words[c].load(std::memory_order_relaxed))
+                                              : counts[level + 1][c].load(std::memory_order_relaxed);
+                }
+                counts[level][m].store(sum, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Лучший свободный сектор среди индексов одного леса без захвата: минимум расстояния до
+    // клетки (px, py) плюс штраф индекса penalty[l]. Поиск общий для всех индексов и раскрывает
+    // только узлы, которые еще могут дать результат лучше найденного; номер индекса выбранного
+    // сектора возвращается в *layer. Возвращает -1, если свободных секторов нет
+    static int findBest(const SpatialIndex* layers, int layerCount, const double* penalty, int px, int py, int* layer) {
+        static thread_local std::vector<Candidate> heap;
+        heap.clear();
+
+        // Ближайший свободный сектор в плитке самой клетки ограничивает поиск сверху:
+        // когда рядом есть свободные секторы, дальние поддеревья не раскрываются
+        double bound = std::numeric_limits<double>::infinity();
+        for (int l = 0; l < layerCount; l++) {
+            const SpatialIndex& index = layers[l];
+            if (!index.words) continue;
+            if (px >= 0 && px < index.side * ASSIGN_TILE_SIDE && py >= 0 && py < index.side * ASSIGN_TILE_SIDE) {
+                uint32_t own = spreadBits(px / ASSIGN_TILE_SIDE) | (spreadBits(py / ASSIGN_TILE_SIDE) << 1);
+                Candidate nearby = index.nearestInTile(own, px, py, penalty[l], l);
+                if (nearby.level > 0 && nearby.key <= bound) {
+                    bound = nearby.key;
+                    push(heap, nearby);
+                }
+            }
+            if (penalty[l] <= bound) push(heap, {penalty[l], 0, 0, l});
+        }
+
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), farther);
+            Candidate c = heap.back();
+            heap.pop_back();
+            const SpatialIndex& index = layers[c.layer];
+
+            if (c.level > index.depth) {
+                *layer = c.layer;
+                return (int)c.index;
+            }
+            if (c.level == index.depth) {
+                // Плитка: ближайший свободный сектор в ней становится точным кандидатом
+                Candidate exact = index.nearestInTile(c.index, px, py, penalty[c.layer], c.layer);
+                if (exact.level > 0 && exact.key <= bound) {
+                    bound = exact.key;
+                    push(heap, exact);
+                }
+                continue;
+            }
+            for (uint32_t child = c.index * 4; child < c.index * 4 + 4; child++) {
+                bool empty = c.level + 1 == index.depth ? index.words[child].load(std::memory_order_acquire) == 0
+                                                        : index.counts[c.level + 1][child].load(std::memory_order_acquire) <= 0;
+                if (empty) continue;
+                double key = std::sqrt((double)index.nodeDistance(c.level + 1, child, px, py)) + penalty[c.layer];
+                if (key <= bound) push(heap, {key, c.level + 1, child, c.layer});
+            }
+        }
+        return -1;
+    }
+
+    // Ближайший к клетке (px, py) свободный сектор без захвата или -1
+    int findNearest(int px, int py) const {
+        double noPenalty = 0;
+        int layer = 0;
+        return findBest(this, 1, &noPenalty, px, py, &layer);
+    }
+
+    // Захватывает ближайший к клетке (px, py) свободный сектор или возвращает -1
+    int acquireNearest(int px, int py) {
+        while (true) {
+            int id = findNearest(px, py);
+            if (id < 0 || tryAcquire(id)) return id;
+            // Сектор перехватил другой поток - ищем заново
+        }
+    }
+
+    // Захватывает сектор id, если он свободен
+    bool tryAcquire(int id) {
+        std::atomic<uint64_t>& word = words[leafOf(id)];
+        uint64_t mask = 1ULL << bitOf(id);
+        uint64_t current = word.load(std::memory_order_acquire);
+        while (current & mask) {
+            if (word.compare_exchange_weak(current, current & ~mask, std::memory_order_acq_rel)) {
+                adjustCounts(leafOf(id), -1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Возвращает сектор в индекс
+    void release(int id) {
+        if (!(words[leafOf(id)].fetch_or(1ULL << bitOf(id), std::memory_order_acq_rel) & (1ULL << bitOf(id)))) {
+            adjustCounts(leafOf(id), 1);
+        }
+    }
+
+    // Исключает сектор из индекса (восстановление состояния)
+    void reserve(int id) {
+        if (words[leafOf(id)].fetch_and(~(1ULL << bitOf(id)), std::memory_order_acq_rel) & (1ULL << bitOf(id))) {
+            adjustCounts(leafOf(id), -1);
+        }
+    }
+
+private:
+    // Узел дерева индекса layer в очереди поиска: key - нижняя оценка расстояния плюс штраф индекса.
+    // level == depth + 1 - точный кандидат, index - номер сектора
+    struct Candidate {
+        double key;
+        int level;
+        uint32_t index;
+        int layer;
+    };
+
+    static bool farther(const Candidate& a, const Candidate& b) { return a.key > b.key; }
+
+    // Ближайший к клетке свободный сектор плитки как точный кандидат; level == 0 - плитка пуста
+    Candidate nearestInTile(uint32_t leaf, int px, int py, double penalty, int layer) const {
+        Candidate best = {0, 0, 0, layer};
+        int64_t bestDist = 0;
+        uint64_t free = words[leaf].load(std::memory_order_acquire);
+        int baseX = (int)compactBits(leaf) * ASSIGN_TILE_SIDE;
+        int baseY = (int)compactBits(leaf >> 1) * ASSIGN_TILE_SIDE;
+        while (free != 0) {
+            int bit = __builtin_ctzll(free);
+            free &= free - 1;
+            int x = baseX + bit % ASSIGN_TILE_SIDE, y = baseY + bit / ASSIGN_TILE_SIDE;
+            int64_t d = (int64_t)(x - px) * (x - px) + (int64_t)(y - py) * (y - py);
+            if (best.level == 0 || d < bestDist) {
+                best.level = depth + 1;
+                best.index = (uint32_t)(y * grid.width + x);
+                bestDist = d;
+            }
+        }
+        best.key = std::sqrt((double)bestDist) + penalty;
+        return best;
+    }
+
+    static void push(std::vector<Candidate>& heap, const Candidate& c) {
+        heap.push_back(c);
+        std::push_heap(heap.begin(), heap.end(), farther);
+    }
+
+    // Чередование битов координат плитки (код Мортона) и обратное преобразование
+    static uint32_t spreadBits(uint32_t v) {
+        v &= 0xFFFF;
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    }
+
+    static uint32_t compactBits(uint32_t v) {
+        v &= 0x55555555;
+        v = (v | (v >> 1)) & 0x33333333;
+        v = (v | (v >> 2)) & 0x0F0F0F0F;
+        v = (v | (v >> 4)) & 0x00FF00FF;
+        v = (v | (v >> 8)) & 0x0000FFFF;
+        return v;
+    }
+
+    uint32_t leafOf(int id) const {
+        return spreadBits(grid.x(id) / ASSIGN_TILE_SIDE) | (spreadBits(grid.y(id) / ASSIGN_TILE_SIDE) << 1);
+    }
+
+    int bitOf(int id) const {
+        return (grid.y(id) % ASSIGN_TILE_SIDE) * ASSIGN_TILE_SIDE + grid.x(id) % ASSIGN_TILE_SIDE;
+    }
+
+    // Квадрат расстояния от клетки до прямоугольника секторов узла
+    int64_t nodeDistance(int level, uint32_t index, int px, int py) const {
+        int span = (side >> level) * ASSIGN_TILE_SIDE;
+        int x0 = (int)compactBits(index) * span, y0 = (int)compactBits(index >> 1) * span;
+        int64_t dx = px < x0 ? x0 - px : (px >= x0 + span ? px - (x0 + span - 1) : 0);
+        int64_t dy = py < y0 ? y0 - py : (py >= y0 + span ? py - (y0 + span - 1) : 0);
+        return dx * dx + dy * dy;
+    }
+
+    void adjustCounts(uint32_t leaf, int delta) {
+        for (int level = depth - 1; level >= 0; level--) {
+            leaf >>= 2;
+            counts[level][leaf].fetch_add(delta, std::memory_order_acq_rel);
+        }
+    }
+
+    ForestGrid grid;
+    int depth = 0; // Уровень листьев; корень - уровень 0
+    int side = 1;  // Плиток по стороне дерева (степень двойки)
+    std::unique_ptr<std::atomic<uint64_t>[]> words;
+    std::vector<std::unique_ptr<std::atomic<int>[]>> counts; // Свободные секторы под узлами уровней 0..depth-1
+};
+
+// Выдача секторов игры по выбранной политике. Политика lowest использует битовую карту
+// SectorAllocator, остальные - пространственные индексы: один на весь лес (locality), по
+// одному на уровень стоимости (cost) или на приоритетные области и остальной лес (priority).
+// Каждый сектор всегда лежит ровно в одном индексе
+class SectorAssigner {
+public:
+    // Вызывается до запуска рабочих потоков
+    void init(int count, AssignmentPolicy assignmentPolicy, const std::vector<PriorityRegion>& priorityRegions) {
+        policy = assignmentPolicy;
+        regions = priorityRegions;
+        forest.init(count);
+        int layerCount = policy == POLICY_LOCALITY ? 1 : policy == POLICY_COST ? SECTOR_COST_LEVELS : policy == POLICY_PRIORITY ? 2 : 0;
+        if (layerCount == 0) {
+            allocator.init(count);
+            return;
+        }
+        layers = std::vector<SpatialIndex>(layerCount);
+        for (int l = 0; l < layerCount; l++) {
+            layers[l].init(forest, [this, l](int id) { return layerOf(id) == l; });
+        }
+    }
+
+    // Захватывает сектор для стаи, находящейся в секторе from (-1 - улей).
+    // hint - слово битовой карты, с которого начинает поиск политика lowest
+    int acquire(unsigned hint, int from) {
+        if (layers.empty()) return allocator.acquire(hint);
+        int px = from < 0 ? forest.hiveX() : forest.x(from);
+        int py = from < 0 ? forest.hiveY() : forest.y(from);
+
+        if (policy != POLICY_COST) {
+            // Индексы перебираются по убыванию приоритета
+            for (SpatialIndex& layer : layers) {
+                int id = layer.acquireNearest(px, py);
+                if (id >= 0) return id;
+            }
+            return -1;
+        }
+
+        // Лучший кандидат всех уровней стоимости сразу: минимум перелета и оценки поиска
+        double penalty[SECTOR_COST_LEVELS];
+        for (int l = 0; l < SECTOR_COST_LEVELS; l++) penalty[l] = SEARCH_COST_WEIGHT * (l + 1);
+        while (true) {
+            int layer = 0;
+            int id = SpatialIndex::findBest(layers.data(), (int)layers.size(), penalty, px, py, &layer);
+            if (id < 0 || layers[layer].tryAcquire(id)) return id;
+        }
+    }
+
+    // Возвращает сектор в пул свободных
+    void release(int id) {
+        if (id < 0 || id >= forest.count) return;
+        if (layers.empty()) allocator.release(id);
+        else layers[layerOf(id)].release(id);
+    }
+
+    // Исключает сектор из пула (восстановление состояния)
+    void reserve(int id) {
+        if (id < 0 || id >= forest.count) return;
+        if (layers.empty()) allocator.reserve(id);
+        else layers[layerOf(id)].reserve(id);
+    }
+
+    int wordsCount() const { return allocator.wordsCount(); }
+    AssignmentPolicy assignmentPolicy() const { return policy; }
+    const ForestGrid& grid() const { return forest; }
+
+private:
+    // Индекс, в котором лежит сектор
+    int layerOf(int id) const {
+        if (policy == POLICY_COST) return forest.cost(id) - 1;
+        if (policy == POLICY_PRIORITY) {
+            int x = forest.x(id), y = forest.y(id);
+            for (const PriorityRegion& r : regions) {
+                if (x >= r.x0 && x <= r.x1 && y >= r.y0 && y <= r.y1) return 0;
+            }
+            return 1;
+        }
+        return 0;
+    }
+
+    AssignmentPolicy policy = POLICY_LOWEST;
+    std::vector<PriorityRegion> regions;
+    ForestGrid forest;
+    SectorAllocator allocator;
+    std::vector<SpatialIndex> layers;
+};
+
+#endif // BEE_ASSIGNMENT_H
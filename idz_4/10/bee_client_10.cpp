@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -10,12 +11,29 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <vector>
+#include <memory>
+#include <cerrno>
 #include <fcntl.h>
 #include <signal.h>
+#include <sys/epoll.h>
+#include "bee_protocol.h"
+#include "bee_reliable.h"
+#include "bee_timer_wheel.h"
 
 #define HEARTBEAT_INTERVAL 3
 #define MIN_SEARCH_TIME 2
 #define MAX_SEARCH_TIME 5
+#define HELLO_TIMEOUT 1 // Время ожидания ответа на HELLO (сек)
+#define TEXT_REPLY_TIMEOUT 5 // Время ожидания ответа по текстовому протоколу, где запросы не повторяются (сек)
+#define HOST_TIMER_TICK_MS 10 // Длительность тика колеса таймеров в режиме нескольких стай (мс)
+#define HOST_TIMER_SLOTS 1024 // Количество ячеек колеса таймеров
+#define HOST_IO_BATCH 64 // Размер пакета для recvmmsg/sendmmsg
+#define HOST_RAMP_MS 1000 // Минимальный интервал, на который растягивается подключение стай (мс)
+#define HOST_RAMP_RATE 20 // Максимум подключающихся стай в миллисекунду
+#define HOST_HEARTBEAT_COALESCE_MS 100 // Сколько сигнал активности ждет других стай для группового HEARTBEAT (мс)
+#define HOST_STOP_TIMEOUT_MS 3000 // Сколько ждать подтверждений DISCONNECT после отправки последнего (мс)
+#define HOST_SOCKET_BUFFER_SIZE (4 * 1024 * 1024) // Размер буферов сокета в режиме нескольких стай
 
 volatile bool running = true;
 std::atomic<bool> disconnected(false);
@@ -28,21 +46,137 @@ socklen_t addrLen;
 std::mutex mtx;
 std::condition_variable cv;
 int swarmId = -1;
+bool binaryProtocol = false; // Согласован двоичный протокол
+int serverVersion = 0; // Версия протокола сервера из HELLO_ACK
+uint32_t gameId = BEE_DEFAULT_GAME; // Игра на сервере (параметр --game)
+int batchSize = 0; // Число секторов в одной аренде (0 - по одному сектору, как в версии 1)
+uint32_t sequence = 0; // Номер последнего надежного запроса (используется только основным потоком)
+uint32_t sessionFirst = 1; // Номер первого надежного запроса сеанса (см. beeSessionFirstSequence)
+RttEstimator rtt; // Время оборота до сервера и таймаут повтора
+unsigned long retransmits = 0;
+std::atomic<int64_t> lastSentMs(0); // Время последней отправки любого сообщения серверу
+unsigned long heartbeatsSent = 0;
 
-void signalHandler(int signum) {
+// Версия двоичных сообщений: до HELLO_ACK - своя, после - согласованная с сервером
+uint8_t messageVersion() {
+    return serverVersion > 0 ? std::min<uint8_t>(serverVersion, BEE_PROTOCOL_VERSION) : BEE_PROTOCOL_VERSION;
+}
+
+// Отправляет сообщение серверу в согласованном формате. Номер 0 - сообщение без подтверждения.
+// sectors - список секторов для REPORT по аренде нескольких секторов
+void sendMessage(uint8_t type, uint32_t seq = 0, int32_t sectorId = -1, const int32_t* sectors = nullptr, int count = 0) {
+    BeeMessage msg;
+    msg.type = type;
+    msg.binary = binaryProtocol;
+    msg.version = messageVersion();
+    msg.gameId = gameId;
+    msg.swarmId = swarmId;
+    msg.sectorId = sectorId;
+    msg.sequence = seq;
+    msg.sessionStart = seq != 0 && seq == sessionFirst;
+    if (type == MSG_REQUEST) msg.batchSize = (uint8_t)batchSize;
+    msg.sectorCount = (uint8_t)count;
+    std::copy(sectors, sectors + count, msg.sectors);
+
+    char data[BEE_MAX_MESSAGE_SIZE];
+    size_t len = encodeBeeMessage(msg, data);
+    sendto(sockfd, data, len, 0, (struct sockaddr*)&serverAddr, addrLen);
+    lastSentMs = monotonicMs();
+}
+
+// Принимает ответ сервера, пропуская подтверждения сигналов активности.
+// Возвращает false при таймауте или ошибке приема (errno сохраняется)
+bool receiveMessage(BeeMessage& msg) {
+    char buffer[1024];
+    while (true) {
+        int n = recvfrom(sockfd, buffer, sizeof(buffer) - 1, 0, (struct sockaddr*)&serverAddr, &addrLen);
+        if (n < 0) return false;
+        buffer[n] = '\0';
+        if (parseBeeMessage(buffer, n, msg) && msg.type != MSG_HEARTBEAT_ACK) return true;
+        if (!running) {
+            errno = EAGAIN;
+            return false;
+        }
+    }
+}
+
+// Устанавливает таймаут ожидания ответа
+void setReceiveTimeoutMs(int64_t ms) {
+    struct timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+void setReceiveTimeout(int seconds) {
+    setReceiveTimeoutMs((int64_t)seconds * 1000);
+}
+
+// Отправляет надежный запрос (REQUEST, REPORT, DISCONNECT) и ждет ответа с его номером.
+// По двоичному протоколу запрос с тем же номером повторяется по таймауту RTO; ответы на старые
+// запросы пропускаются, а уведомления сервера (номер 0) возвращаются сразу.
+// Возвращает false, если ответа нет после всех повторов или при ошибке приема (errno сохраняется)
+bool sendReliable(BeeMessage& reply, uint8_t type, int32_t sectorId = -1, const int32_t* sectors = nullptr, int count = 0) {
+    uint32_t seq = sequence = beeNextSequence(sequence);
+    int attempts = binaryProtocol ? BEE_MAX_RETRANSMITS + 1 : 1;
+    for (int attempt = 0; attempt < attempts && running; attempt++) {
+        if (attempt > 0) retransmits++;
+        int64_t sentUs = monotonicUs();
+        int64_t deadlineUs = sentUs + (binaryProtocol ? rtt.timeoutMs(attempt) : TEXT_REPLY_TIMEOUT * 1000) * 1000;
+        sendMessage(type, seq, sectorId, sectors, count);
+
+        int64_t leftUs;
+        while ((leftUs = deadlineUs - monotonicUs()) > 0) {
+            setReceiveTimeoutMs(std::max<int64_t>(1, leftUs / 1000));
+            if (!receiveMessage(reply)) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+                return false;
+            }
+            if (binaryProtocol && reply.sequence != seq && reply.sequence != 0) continue;
+            // Одиночная стая исследует сектор до конца: отмену копии она не прерывает
+            if (reply.type == MSG_CANCEL) continue;
+
+            // Время оборота измеряется только без повторов: ответ на повтор мог прийти на первую отправку
+            if (attempt == 0 && reply.sequence == seq) rtt.sample(monotonicUs() - sentUs);
+            return true;
+        }
+    }
+    errno = EAGAIN;
+    return false;
+}
+
+// Согласует с сервером двоичный протокол; если сервер не ответил HELLO_ACK, остается текстовый
+void negotiateProtocol() {
+    binaryProtocol = true;
+    sendMessage(MSG_HELLO);
+    setReceiveTimeout(HELLO_TIMEOUT);
+
+    BeeMessage reply;
+    binaryProtocol = receiveMessage(reply) && reply.type == MSG_HELLO_ACK;
+    if (binaryProtocol) serverVersion = reply.version;
+    sessionFirst = beeSessionFirstSequence(binaryProtocol ? messageVersion() : 0);
+    sequence = sessionFirst - 1;
+    std::cout << "Стая #" << swarmId << ": Используется " << (binaryProtocol ? "двоичный" : "текстовый") << " протокол" << std::endl;
+}
+
+void signalHandler(int) {
     running = false;
     cv.notify_all();
 }
 
+// Сервер считает признаком активности любое сообщение стаи, поэтому HEARTBEAT отправляется,
+// только если стая ничего не отправляла HEARTBEAT_INTERVAL секунд (например, во время долгого поиска)
 void heartbeatThread() {
     while (running && !disconnected && !serverShutdown) {
-        if (sockfd >= 0) {
-            char heartbeatMsg[32];
-            sprintf(heartbeatMsg, "HEARTBEAT:%d", swarmId);
-            sendto(sockfd, heartbeatMsg, strlen(heartbeatMsg), 0, (struct sockaddr*)&serverAddr, addrLen);
+        int64_t idleMs = monotonicMs() - lastSentMs;
+        if (idleMs >= HEARTBEAT_INTERVAL * 1000 && sockfd >= 0) {
+            sendMessage(MSG_HEARTBEAT);
+            heartbeatsSent++;
+            idleMs = 0;
         }
         std::unique_lock<std::mutex> lock(mtx);
-        cv.wait_for(lock, std::chrono::seconds(HEARTBEAT_INTERVAL), []{ return !running || disconnected.load() || serverShutdown.load(); });
+        cv.wait_for(lock, std::chrono::milliseconds(HEARTBEAT_INTERVAL * 1000 - idleMs),
+                    []{ return !running || disconnected.load() || serverShutdown.load(); });
     }
 }
 
@@ -69,24 +203,462 @@ bool searchForWinnieInSector(int sectorId) {
 
 bool disconnectFromServer() {
     if (sockfd < 0) return false;
-    char disconnectMsg[] = "DISCONNECT";
-    sendto(sockfd, disconnectMsg, strlen(disconnectMsg), 0, (struct sockaddr*)&serverAddr, addrLen);
-    struct timeval tv;
-    tv.tv_sec = 2;
-    tv.tv_usec = 0;
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-    char buffer[1024] = {0};
-    int n = recvfrom(sockfd, buffer, sizeof(buffer), 0, (struct sockaddr*)&serverAddr, &addrLen);
-    if (n > 0 && strcmp(buffer, "DISCONNECT_ACK") == 0) {
+    BeeMessage reply;
+    if (sendReliable(reply, MSG_DISCONNECT) && reply.type == MSG_DISCONNECT_ACK) {
         disconnected = true;
         return true;
     }
     return false;
 }
 
+// ===== Режим нескольких стай в одном процессе (--swarms M) =====
+// M стай обслуживаются одним потоком через один сокет и один цикл epoll. Каждая стая - небольшой
+// автомат состояний, а поиск, паузы, повторы запросов и сигналы активности - таймеры колеса
+// вместо sleep_for, поэтому процесс может вести сотни тысяч стай.
+
+// Состояние стаи в режиме нескольких стай
+enum HostedState : uint8_t {
+    HOSTED_IDLE,          // Ждет таймера, чтобы отправить REQUEST
+    HOSTED_REQUESTING,    // Отправлен REQUEST
+    HOSTED_SEARCHING,     // Получен SEARCH, идет поиск
+    HOSTED_REPORTING,     // Отправлен REPORT
+    HOSTED_DISCONNECTING, // Отправлен DISCONNECT
+    HOSTED_DONE           // Стая завершила работу
+};
+
+struct HostedSwarm {
+    int32_t id;
+    HostedState state = HOSTED_IDLE;
+    uint8_t attempts = 0;   // Повторы последнего запроса
+    uint8_t leaseCount = 0; // Арендованные секторы
+    uint32_t sequence = 0;  // Номер последнего надежного запроса
+    uint32_t sessionFirst = 1; // Номер первого надежного запроса сеанса
+    int64_t sentUs = 0;     // Время первой отправки последнего запроса
+    int32_t lease[BEE_MAX_BATCH];
+};
+
+// Все стаи процесса и общий для них ввод-вывод
+struct SwarmHost {
+    int firstId = 0;
+    std::vector<HostedSwarm> swarms;
+    size_t done = 0;
+    bool stopping = false;  // Получен сигнал завершения: стаи отключаются от сервера
+    TimerWheel actions;    // Следующее действие стаи: запрос, конец поиска или повтор
+    TimerWheel heartbeats; // Сигналы активности простаивающих стай
+    bool groupHeartbeats = false;
+    int32_t heartbeatIds[BEE_MAX_HEARTBEAT_BATCH + 1];
+    int heartbeatCount = 0;
+    std::mt19937 gen{std::random_device()()};
+
+    // Исходящие датаграммы, отправляемые одним вызовом sendmmsg
+    int sendCount = 0;
+    struct mmsghdr sendMsgs[HOST_IO_BATCH];
+    struct iovec sendIovs[HOST_IO_BATCH];
+    char sendData[HOST_IO_BATCH][BEE_MAX_HEARTBEAT_SIZE];
+
+    // Статистика
+    unsigned long searchedSectors = 0;
+    unsigned long heartbeatsSent = 0;
+    unsigned long heartbeatDatagrams = 0;
+    unsigned long hostRetransmits = 0;
+    unsigned long cancelledSectors = 0; // Секторы, поиск в которых отменен: их раньше исследовала другая стая
+};
+
+void flushHostQueue(SwarmHost& host) {
+    int sent = 0;
+    while (sent < host.sendCount) {
+        int n = sendmmsg(sockfd, host.sendMsgs + sent, host.sendCount - sent, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // Переполнение буфера сокета - запросы будут повторены по таймауту
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) perror("Ошибка sendmmsg");
+            break;
+        }
+        sent += n;
+    }
+    host.sendCount = 0;
+}
+
+// Место под следующую исходящую датаграмму; длина задается после кодирования
+char* nextHostDatagram(SwarmHost& host) {
+    if (host.sendCount >= HOST_IO_BATCH) flushHostQueue(host);
+    return host.sendData[host.sendCount];
+}
+
+void commitHostDatagram(SwarmHost& host, size_t len) {
+    int i = host.sendCount++;
+    host.sendIovs[i].iov_base = host.sendData[i];
+    host.sendIovs[i].iov_len = len;
+    memset(&host.sendMsgs[i], 0, sizeof(host.sendMsgs[i]));
+    host.sendMsgs[i].msg_hdr.msg_name = &serverAddr;
+    host.sendMsgs[i].msg_hdr.msg_namelen = addrLen;
+    host.sendMsgs[i].msg_hdr.msg_iov = &host.sendIovs[i];
+    host.sendMsgs[i].msg_hdr.msg_iovlen = 1;
+}
+
+void queueHostMessage(SwarmHost& host, const HostedSwarm& swarm, uint8_t type, uint32_t seq) {
+    BeeMessage msg;
+    msg.type = type;
+    msg.binary = true;
+    msg.version = messageVersion();
+    msg.gameId = gameId;
+    msg.swarmId = swarm.id;
+    msg.sectorId = swarm.leaseCount > 0 ? swarm.lease[0] : -1;
+    msg.sequence = seq;
+    msg.sessionStart = seq == swarm.sessionFirst;
+    if (type == MSG_REQUEST) {
+        msg.batchSize = (uint8_t)batchSize;
+    } else if (type == MSG_REPORT && batchSize > 0) {
+        msg.sectorCount = swarm.leaseCount;
+        std::copy(swarm.lease, swarm.lease + swarm.leaseCount, msg.sectors);
+    }
+    char* buf = nextHostDatagram(host);
+    commitHostDatagram(host, encodeBeeMessage(msg, buf));
+}
+
+// Групповой HEARTBEAT за накопленные стаи
+void queueHostHeartbeats(SwarmHost& host) {
+    char* buf = nextHostDatagram(host);
+    commitHostDatagram(host, encodeBeeHeartbeats(host.heartbeatIds, host.heartbeatCount, buf, messageVersion(), gameId));
+    host.heartbeatCount = 0;
+    host.heartbeatDatagrams++;
+}
+
+// Любое сообщение стаи продлевает ее активность на сервере, поэтому HEARTBEAT нужен только после простоя
+void postponeHostHeartbeat(SwarmHost& host, int index) {
+    host.heartbeats.schedule(index, monotonicMs() + HEARTBEAT_INTERVAL * 1000);
+}
+
+// Отправляет новый надежный запрос стаи и ставит таймер повтора
+void sendHostRequest(SwarmHost& host, int index, uint8_t type, HostedState state) {
+    HostedSwarm& swarm = host.swarms[index];
+    swarm.state = state;
+    swarm.attempts = 0;
+    swarm.sentUs = monotonicUs();
+    swarm.sequence = beeNextSequence(swarm.sequence);
+    queueHostMessage(host, swarm, type, swarm.sequence);
+    host.actions.schedule(index, swarm.sentUs / 1000 + rtt.timeoutMs(0));
+    postponeHostHeartbeat(host, index);
+}
+
+void finishHostedSwarm(SwarmHost& host, int index) {
+    HostedSwarm& swarm = host.swarms[index];
+    if (swarm.state == HOSTED_DONE) return;
+    swarm.state = HOSTED_DONE;
+    host.done++;
+    host.actions.cancel(index);
+    host.heartbeats.cancel(index);
+}
+
+// Срабатывание таймера действия стаи
+void onHostAction(SwarmHost& host, int index) {
+    HostedSwarm& swarm = host.swarms[index];
+    static const uint8_t pendingType[] = {MSG_UNKNOWN, MSG_REQUEST, MSG_UNKNOWN, MSG_REPORT, MSG_DISCONNECT, MSG_UNKNOWN};
+
+    // При завершении стая, не ждущая ответа, отключается вместо следующего шага
+    if (host.stopping && (swarm.state == HOSTED_IDLE || swarm.state == HOSTED_SEARCHING)) {
+        sendHostRequest(host, index, MSG_DISCONNECT, HOSTED_DISCONNECTING);
+        return;
+    }
+
+    switch (swarm.state) {
+    case HOSTED_IDLE:
+        sendHostRequest(host, index, MSG_REQUEST, HOSTED_REQUESTING);
+        break;
+    case HOSTED_SEARCHING:
+        sendHostRequest(host, index, MSG_REPORT, HOSTED_REPORTING);
+        break;
+    case HOSTED_REQUESTING:
+    case HOSTED_REPORTING:
+    case HOSTED_DISCONNECTING:
+        if (swarm.attempts >= BEE_MAX_RETRANSMITS) {
+            // Сервер не отвечает: отключение считается выполненным, поиск начинается заново
+            if (swarm.state == HOSTED_DISCONNECTING) {
+                finishHostedSwarm(host, index);
+            } else {
+                sendHostRequest(host, index, MSG_REQUEST, HOSTED_REQUESTING);
+            }
+            break;
+        }
+        // Повтор с тем же номером: сервер ответит на него, не обрабатывая заново
+        swarm.attempts++;
+        host.hostRetransmits++;
+        queueHostMessage(host, swarm, pendingType[swarm.state], swarm.sequence);
+        host.actions.schedule(index, monotonicMs() + rtt.timeoutMs(swarm.attempts));
+        postponeHostHeartbeat(host, index);
+        break;
+    case HOSTED_DONE:
+        break;
+    }
+}
+
+// Срабатывание таймера сигнала активности
+void onHostHeartbeat(SwarmHost& host, int index) {
+    HostedSwarm& swarm = host.swarms[index];
+    if (swarm.state == HOSTED_DONE) return;
+    host.heartbeatsSent++;
+    if (host.groupHeartbeats) {
+        host.heartbeatIds[host.heartbeatCount++] = swarm.id;
+        if (host.heartbeatCount > BEE_MAX_HEARTBEAT_BATCH) queueHostHeartbeats(host);
+    } else {
+        queueHostMessage(host, swarm, MSG_HEARTBEAT, 0);
+        host.heartbeatDatagrams++;
+    }
+    postponeHostHeartbeat(host, index);
+}
+
+// Время поиска в арендованных секторах: перелет и поиск в каждом, как у отдельной стаи
+int64_t hostedSearchMs(SwarmHost& host, int sectors) {
+    std::uniform_int_distribution<int> searchTime(MIN_SEARCH_TIME * 1000, MAX_SEARCH_TIME * 1000);
+    int64_t total = 0;
+    for (int i = 0; i < sectors; i++) total += 1000 + searchTime(host.gen);
+    return total;
+}
+
+// Обработка ответа сервера одной из стай
+void handleHostReply(SwarmHost& host, const char* data, size_t len) {
+    BeeMessage reply;
+    if (!parseBeeMessage(data, len, reply) || !reply.binary) return;
+
+    if (reply.type == MSG_SERVER_SHUTDOWN) {
+        if (!serverShutdown) std::cout << "Стаи: Сервер завершает работу." << std::endl;
+        serverShutdown = true;
+        return;
+    }
+
+    int index = reply.swarmId - host.firstId;
+    if (index < 0 || index >= (int)host.swarms.size() || reply.type == MSG_HEARTBEAT_ACK) return;
+    HostedSwarm& swarm = host.swarms[index];
+    if (swarm.state == HOSTED_DONE) return;
+
+    // Уведомление о находке (номер 0) приходит в любом состоянии
+    if (reply.type == MSG_WINNIE_FOUND && reply.sequence == 0) {
+        winnieFound = true;
+        if (swarm.state != HOSTED_DISCONNECTING) sendHostRequest(host, index, MSG_DISCONNECT, HOSTED_DISCONNECTING);
+        return;
+    }
+
+    // Сектор уже исследовала другая стая: он исключается из аренды, а пустая аренда завершает поиск без отчета
+    if (reply.type == MSG_CANCEL) {
+        int32_t* end = swarm.lease + swarm.leaseCount;
+        int32_t* cancelled = std::find(swarm.lease, end, reply.sectorId);
+        if (swarm.state != HOSTED_SEARCHING || cancelled == end) return;
+        std::copy(cancelled + 1, end, cancelled);
+        swarm.leaseCount--;
+        host.cancelledSectors++;
+        if (swarm.leaseCount == 0) {
+            swarm.state = HOSTED_IDLE;
+            host.actions.schedule(index, monotonicMs());
+        }
+        return;
+    }
+    if (reply.sequence != swarm.sequence) return;
+
+    int64_t nowUs = monotonicUs();
+    if (swarm.attempts == 0) rtt.sample(nowUs - swarm.sentUs);
+
+    switch (reply.type) {
+    case MSG_SEARCH:
+        if (swarm.state != HOSTED_REQUESTING) break;
+        if (reply.sectorCount > 0) {
+            swarm.leaseCount = reply.sectorCount;
+            std::copy(reply.sectors, reply.sectors + reply.sectorCount, swarm.lease);
+        } else {
+            swarm.leaseCount = 1;
+            swarm.lease[0] = reply.sectorId;
+        }
+        swarm.state = HOSTED_SEARCHING;
+        host.actions.schedule(index, nowUs / 1000 + (host.stopping ? 0 : hostedSearchMs(host, swarm.leaseCount)));
+        break;
+
+    case MSG_CONTINUE:
+        if (swarm.state != HOSTED_REPORTING) break;
+        host.searchedSectors += swarm.leaseCount;
+        swarm.leaseCount = 0;
+        swarm.state = HOSTED_IDLE;
+        host.actions.schedule(index, nowUs / 1000 + (host.stopping ? 0 : 1000));
+        break;
+
+    case MSG_WINNIE_FOUND:
+        if (swarm.state == HOSTED_REPORTING) {
+            std::cout << "Стая #" << swarm.id << ": Винни-Пух найден! Завершаем поиск." << std::endl;
+            host.searchedSectors += swarm.leaseCount;
+            swarm.leaseCount = 0;
+        }
+        winnieFound = true;
+        if (swarm.state != HOSTED_DISCONNECTING) sendHostRequest(host, index, MSG_DISCONNECT, HOSTED_DISCONNECTING);
+        break;
+
+    case MSG_NO_MORE_SECTORS:
+        // Все сектора проверены или назначены: стая возвращается в улей
+        if (swarm.state == HOSTED_REQUESTING) sendHostRequest(host, index, MSG_DISCONNECT, HOSTED_DISCONNECTING);
+        break;
+
+    case MSG_DENIED:
+        if (swarm.state != HOSTED_REQUESTING) break;
+        std::cout << "Стая #" << swarm.id << ": Сервер отклонил подключение." << std::endl;
+        finishHostedSwarm(host, index);
+        break;
+
+    case MSG_DISCONNECT_ACK:
+        if (swarm.state == HOSTED_DISCONNECTING) finishHostedSwarm(host, index);
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Принимает все ответы, накопившиеся в сокете
+void drainHostSocket(SwarmHost& host) {
+    static struct mmsghdr msgs[HOST_IO_BATCH];
+    static struct iovec iovs[HOST_IO_BATCH];
+    static char data[HOST_IO_BATCH][BEE_MAX_MESSAGE_SIZE];
+
+    while (true) {
+        for (int i = 0; i < HOST_IO_BATCH; i++) {
+            iovs[i].iov_base = data[i];
+            iovs[i].iov_len = sizeof(data[i]);
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = recvmmsg(sockfd, msgs, HOST_IO_BATCH, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("Ошибка recvmmsg");
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            handleHostReply(host, data[i], msgs[i].msg_len);
+        }
+        if (n < HOST_IO_BATCH) return;
+    }
+}
+
+// Запускает count стай с номерами swarmId .. swarmId + count - 1 в одном цикле событий
+int runSwarmHost(int count) {
+    if (!binaryProtocol) {
+        std::cerr << "Режим нескольких стай работает только по двоичному протоколу" << std::endl;
+        return 1;
+    }
+
+    int bufferSize = HOST_SOCKET_BUFFER_SIZE;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+    int epollFd = epoll_create1(0);
+    if (epollFd < 0) {
+        perror("Ошибка создания epoll");
+        return 1;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = sockfd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        perror("Ошибка настройки epoll");
+        close(epollFd);
+        return 1;
+    }
+
+    // Первые запросы растянуты во времени, чтобы стаи не пришли на сервер одним залпом
+    // и ответы не переполнили буфер сокета
+    std::unique_ptr<SwarmHost> hostPtr(new SwarmHost());
+    SwarmHost& host = *hostPtr;
+    int64_t startMs = monotonicMs();
+    host.firstId = swarmId;
+    host.groupHeartbeats = serverVersion >= BEE_HEARTBEAT_BATCH_VERSION;
+    host.actions.init(startMs, HOST_TIMER_TICK_MS, HOST_TIMER_SLOTS);
+    host.heartbeats.init(startMs, HOST_TIMER_TICK_MS, HOST_TIMER_SLOTS);
+    host.swarms.resize(count);
+    std::uniform_int_distribution<int> ramp(0, std::max(HOST_RAMP_MS, count / HOST_RAMP_RATE));
+    for (int i = 0; i < count; i++) {
+        host.swarms[i].id = swarmId + i;
+        host.swarms[i].sessionFirst = beeSessionFirstSequence(messageVersion());
+        host.swarms[i].sequence = host.swarms[i].sessionFirst - 1;
+        host.actions.schedule(i, startMs + ramp(host.gen));
+    }
+
+    std::cout << "Стаи #" << swarmId << " - #" << swarmId + count - 1 << ": " << count
+              << " стай в одном процессе, групповые сигналы активности " << (host.groupHeartbeats ? "включены" : "недоступны") << std::endl;
+
+    struct epoll_event events[1];
+    int64_t nextHeartbeatFlushMs = 0;
+    int64_t nextReportMs = startMs + 1000;
+    int64_t stopDeadlineMs = 0;
+    while (host.done < host.swarms.size() && !serverShutdown) {
+        if (epoll_wait(epollFd, events, 1, HOST_TIMER_TICK_MS) > 0) {
+            drainHostSocket(host);
+        }
+        int64_t now = monotonicMs();
+
+        // По сигналу завершения все стаи отключаются от сервера, так же растянуто во времени, как подключались
+        if (!running && !host.stopping) {
+            host.stopping = true;
+            stopDeadlineMs = now + HOST_STOP_TIMEOUT_MS + count / HOST_RAMP_RATE;
+            for (int i = 0; i < count; i++) {
+                HostedState state = host.swarms[i].state;
+                if (state == HOSTED_IDLE || state == HOSTED_SEARCHING) host.actions.schedule(i, now + i / HOST_RAMP_RATE);
+            }
+        }
+        if (stopDeadlineMs != 0 && now >= stopDeadlineMs) break;
+
+        host.actions.advance(now, [&host](uint64_t key) { onHostAction(host, (int)key); });
+        host.heartbeats.advance(now, [&host](uint64_t key) { onHostHeartbeat(host, (int)key); });
+
+        // Неполный групповой HEARTBEAT ждет другие стаи не дольше HOST_HEARTBEAT_COALESCE_MS
+        if (host.heartbeatCount > 0 && now >= nextHeartbeatFlushMs) {
+            queueHostHeartbeats(host);
+            nextHeartbeatFlushMs = now + HOST_HEARTBEAT_COALESCE_MS;
+        }
+        if (host.sendCount > 0) flushHostQueue(host);
+
+        if (now >= nextReportMs) {
+            size_t searching = 0, waiting = 0;
+            for (const HostedSwarm& swarm : host.swarms) {
+                if (swarm.state == HOSTED_SEARCHING) searching++;
+                else if (swarm.state == HOSTED_REQUESTING || swarm.state == HOSTED_REPORTING || swarm.state == HOSTED_DISCONNECTING) waiting++;
+            }
+            std::cout << "Стаи: в поиске " << searching << ", ждут ответа " << waiting << ", завершили " << host.done
+                      << ", исследовано секторов " << host.searchedSectors << std::endl;
+            nextReportMs = now + 1000;
+        }
+    }
+    close(epollFd);
+
+    if (winnieFound) std::cout << "Стаи: Винни-Пух найден." << std::endl;
+    std::cout << "Стаи: исследовано секторов " << host.searchedSectors << ", отменено поисков " << host.cancelledSectors
+              << ", повторено запросов " << host.hostRetransmits
+              << ", сигналов активности " << host.heartbeatsSent << " в " << host.heartbeatDatagrams
+              << " датаграммах, среднее время оборота " << rtt.smoothedUs() / 1000.0 << " мс" << std::endl;
+    close(sockfd);
+    std::cout << "Стаи #" << swarmId << " - #" << swarmId + count - 1 << ": Работа завершена." << std::endl;
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        std::cerr << "Использование: " << argv[0] << " <SERVER_IP> <SERVER_PORT> <BEE_SWARM_ID>" << std::endl;
+    bool textProtocol = false;
+    int hostedCount = 0;
+    bool badArgs = argc < 4;
+    for (int i = 4; i < argc && !badArgs; i++) {
+        if (strcmp(argv[i], "--text") == 0) {
+            textProtocol = true;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchSize = atoi(argv[++i]);
+            badArgs = batchSize < 1 || batchSize > BEE_MAX_BATCH;
+        } else if (strcmp(argv[i], "--swarms") == 0 && i + 1 < argc) {
+            hostedCount = atoi(argv[++i]);
+            badArgs = hostedCount < 1;
+        } else if (strcmp(argv[i], "--game") == 0 && i + 1 < argc) {
+            gameId = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else {
+            badArgs = true;
+        }
+    }
+    if (badArgs) {
+        std::cerr << "Использование: " << argv[0] << " <SERVER_IP> <SERVER_PORT> <BEE_SWARM_ID> [--text] [--batch 1-"
+                  << BEE_MAX_BATCH << "] [--swarms M] [--game G]" << std::endl;
         return 1;
     }
 
@@ -111,23 +683,39 @@ int main(int argc, char* argv[]) {
 
     std::cout << "Стая пчел #" << swarmId << " готова к поиску Винни-Пуха!" << std::endl;
     std::cout << "Подключение к серверу " << serverIP << ":" << serverPort << std::endl;
+    if (gameId != BEE_DEFAULT_GAME) std::cout << "Игра #" << gameId << std::endl;
+
+    // Флаг --text отключает согласование двоичного протокола
+    if (!textProtocol) {
+        negotiateProtocol();
+    }
+
+    // Игры, кроме игры по умолчанию, доступны только по двоичному протоколу версии 4 и выше
+    if (gameId != BEE_DEFAULT_GAME && serverVersion < BEE_GAME_PROTOCOL_VERSION) {
+        std::cerr << "Стая #" << swarmId << ": Игра #" << gameId << " доступна только по двоичному протоколу версии "
+                  << BEE_GAME_PROTOCOL_VERSION << " и выше" << std::endl;
+        close(sockfd);
+        return 1;
+    }
+
+    // Аренда нескольких секторов доступна только по двоичному протоколу версии 2 и выше
+    if (batchSize > 0 && serverVersion < BEE_BATCH_PROTOCOL_VERSION) {
+        std::cout << "Стая #" << swarmId << ": Сервер не поддерживает аренду нескольких секторов, берем по одному" << std::endl;
+        batchSize = 0;
+    }
+
+    // Стаи с номерами BEE_SWARM_ID .. BEE_SWARM_ID + M - 1 в одном процессе
+    if (hostedCount > 0) {
+        return runSwarmHost(hostedCount);
+    }
 
     std::thread heartbeat(heartbeatThread);
 
     bool searching = true;
+    bool denied = false;
     while (running && searching && !disconnected && !winnieFound && !serverShutdown) {
-        char request[32];
-        sprintf(request, "REQUEST:%d", swarmId);
-        sendto(sockfd, request, strlen(request), 0, (struct sockaddr*)&serverAddr, addrLen);
-
-        char buffer[1024] = {0};
-        struct timeval tv;
-        tv.tv_sec = 5;
-        tv.tv_usec = 0;
-        setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-        int n = recvfrom(sockfd, buffer, sizeof(buffer), 0, (struct sockaddr*)&serverAddr, &addrLen);
-
-        if (n < 0) {
+        BeeMessage reply;
+        if (!sendReliable(reply, MSG_REQUEST)) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 if (!running || disconnected || winnieFound || serverShutdown) break;
                 continue;
@@ -137,51 +725,75 @@ int main(int argc, char* argv[]) {
             }
         }
 
-        if (strncmp(buffer, "SEARCH:", 7) == 0) {
-            int sectorId;
-            sscanf(buffer + 7, "%d", &sectorId);
-            std::cout << "Стая #" << swarmId << ": Отправляемся в сектор " << sectorId << std::endl;
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            if (!searchForWinnieInSector(sectorId)) break;
-            char report[32];
-            sprintf(report, "REPORT:%d:%d:", swarmId, sectorId);
-            sendto(sockfd, report, strlen(report), 0, (struct sockaddr*)&serverAddr, addrLen);
-
-            memset(buffer, 0, sizeof(buffer));
-            n = recvfrom(sockfd, buffer, sizeof(buffer), 0, (struct sockaddr*)&serverAddr, &addrLen);
+        switch (reply.type) {
+        case MSG_SEARCH: {
+            int sectorId = reply.sectorId;
+            bool replied;
+            if (reply.sectorCount > 0) {
+                // Аренда нескольких секторов: исследуем их по очереди и сообщаем обо всех одним отчетом
+                int32_t searched[BEE_MAX_BATCH];
+                int searchedCount = 0;
+                std::cout << "Стая #" << swarmId << ": Получено секторов: " << (int)reply.sectorCount << std::endl;
+                for (int i = 0; i < reply.sectorCount; i++) {
+                    std::cout << "Стая #" << swarmId << ": Отправляемся в сектор " << reply.sectors[i] << std::endl;
+                    if (!searchForWinnieInSector(reply.sectors[i])) break;
+                    searched[searchedCount++] = reply.sectors[i];
+                }
+                if (searchedCount < reply.sectorCount) {
+                    searching = false;
+                    break;
+                }
+                replied = sendReliable(reply, MSG_REPORT, searched[0], searched, searchedCount);
+            } else {
+                std::cout << "Стая #" << swarmId << ": Отправляемся в сектор " << sectorId << std::endl;
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                if (!searchForWinnieInSector(sectorId)) {
+                    searching = false;
+                    break;
+                }
+                replied = sendReliable(reply, MSG_REPORT, sectorId);
+            }
 
-            if (n < 0) {
+            if (!replied) {
                 if (errno == EAGAIN || errno == EWOULDBLOCK) continue;
-                else break;
+                searching = false;
+                break;
             }
 
-            if (strcmp(buffer, "WINNIE_FOUND") == 0) {
+            if (reply.type == MSG_WINNIE_FOUND) {
                 std::cout << "Стая #" << swarmId << ": Винни-Пух найден! Завершаем поиск." << std::endl;
                 winnieFound = true;
                 searching = false;
-            } else if (strcmp(buffer, "CONTINUE") == 0) {
-                std::cout << "Стая #" << swarmId << ": Сектор " << sectorId << " проверен, Винни-Пух не обнаружен." << std::endl;
+            } else if (reply.type == MSG_CONTINUE) {
+                std::cout << "Стая #" << swarmId << ": Сектор " << sectorId << (batchSize > 0 ? " и остальные арендованные проверены" : " проверен")
+                          << ", Винни-Пух не обнаружен." << std::endl;
                 std::this_thread::sleep_for(std::chrono::seconds(1));
-            } else if (strcmp(buffer, "SERVER_SHUTDOWN") == 0) {
+            } else if (reply.type == MSG_SERVER_SHUTDOWN) {
                 std::cout << "Стая #" << swarmId << ": Сервер завершает работу." << std::endl;
                 serverShutdown = true;
-                break;
             }
-        } else if (strcmp(buffer, "DENIED") == 0) {
+            break;
+        }
+        case MSG_DENIED:
             std::cout << "Стая #" << swarmId << ": Сервер отклонил подключение." << std::endl;
             disconnected = true;
+            denied = true;
             break;
-        } else if (strcmp(buffer, "NO_MORE_SECTORS") == 0) {
+        case MSG_NO_MORE_SECTORS:
             std::cout << "Стая #" << swarmId << ": Все сектора проверены. Возвращаемся в улей." << std::endl;
             searching = false;
-        } else if (strcmp(buffer, "WINNIE_FOUND") == 0) {
+            break;
+        case MSG_WINNIE_FOUND:
             std::cout << "Стая #" << swarmId << ": Получена информация, что Винни-Пух найден другой стаей. Завершаем поиск." << std::endl;
             winnieFound = true;
             searching = false;
-        } else if (strcmp(buffer, "SERVER_SHUTDOWN") == 0) {
+            break;
+        case MSG_SERVER_SHUTDOWN:
             std::cout << "Стая #" << swarmId << ": Сервер завершает работу." << std::endl;
             serverShutdown = true;
             break;
+        default:
+            break;
         }
     }
 
@@ -201,6 +813,10 @@ int main(int argc, char* argv[]) {
     if (heartbeat.joinable()) heartbeat.join();
     if (sockfd >= 0) close(sockfd);
 
+    std::cout << "Стая #" << swarmId << ": Повторено запросов: " << retransmits << ", отправлено сигналов активности: "
+              << heartbeatsSent << ", среднее время оборота " << rtt.smoothedUs() / 1000.0 << " мс" << std::endl;
     std::cout << "Стая #" << swarmId << ": Работа завершена." << std::endl;
-    return 0;
+    // Отказ - ненулевой код: супервизор (bee_manager --supervise) повторит запуск позже,
+    // например, когда истечет аренда прежнего процесса стаи с тем же номером
+    return denied ? 1 : 0;
 }
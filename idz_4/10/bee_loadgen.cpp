@@ -0,0 +1,807 @@
+#include <iostream>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <cerrno>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include "bee_protocol.h"
+#include "bee_timer_wheel.h"
+#include "bee_reliable.h"
+
+#define DEFAULT_SWARMS 1000 // Количество виртуальных стай по умолчанию
+#define DEFAULT_THREADS 2 // Количество потоков генератора по умолчанию
+#define DEFAULT_SOCKETS 4 // Количество сокетов на поток по умолчанию
+#define DEFAULT_DURATION 10 // Длительность измерения по умолчанию (сек)
+#define DEFAULT_HEARTBEAT_MS 3000 // Период сигналов активности каждой стаи по умолчанию (мс)
+#define DEFAULT_RAMP_MS 1000 // Интервал, на который растягивается подключение стай (мс)
+#define RETRY_DELAY_MS 1000 // Пауза перед новым запросом после NO_MORE_SECTORS (мс)
+#define TIMER_TICK_MS 1 // Длительность тика колеса таймеров генератора (мс)
+#define HEARTBEAT_COALESCE_MS 100 // Сколько сигнал активности ждет других стай для группового HEARTBEAT (мс)
+#define TIMER_WHEEL_SLOTS 4096 // Количество ячеек колеса таймеров
+#define SOCKET_BUFFER_SIZE (4 * 1024 * 1024) // Размер буферов сокета
+#define LOADGEN_BATCH_SIZE 64 // Размер пакета для recvmmsg/sendmmsg
+#define MAX_EPOLL_EVENTS 16 // Максимальное число событий за один вызов epoll_wait
+#define CONTROL_PORT_OFFSET 2000 // Смещение управляющего порта сервера
+#define CONTROL_TIMEOUT_MS 1000 // Время ожидания ответа управляющего порта (мс)
+#define DEFAULT_GAME_SECTORS 100000 // Секторов в каждой создаваемой игре по умолчанию
+#define STRAGGLER_FACTOR 20 // Во сколько раз дольше длится поиск отстающей стаи (--straggler)
+
+// Параметры нагрузки
+struct LoadConfig {
+    int swarms = DEFAULT_SWARMS;
+    int threads = DEFAULT_THREADS;
+    int socketsPerThread = DEFAULT_SOCKETS;
+    int duration = DEFAULT_DURATION;
+    int searchMs = 0;                     // Время "поиска" одного сектора между SEARCH и REPORT
+    int lease = 0;                        // Секторов в одной аренде (0 - по одному, как в версии 1)
+    int heartbeatMs = DEFAULT_HEARTBEAT_MS; // 0 - без сигналов активности
+    int heartbeatBatch = BEE_MAX_HEARTBEAT_BATCH + 1; // Стай в одном групповом HEARTBEAT (1 - отдельные датаграммы)
+    double churn = 0.0;                   // Вероятность отключения стаи после CONTINUE (%)
+    double straggler = 0.0;               // Вероятность, что поиск займет в STRAGGLER_FACTOR раз больше времени (%)
+    int firstId = 1;                      // Номер первой виртуальной стаи
+    int games = 0;                        // Игры, создаваемые на время измерения (0 - игра по умолчанию)
+    int gameSectors = DEFAULT_GAME_SECTORS; // Секторов в каждой создаваемой игре
+};
+
+// Состояние виртуальной стаи
+enum SwarmState : uint8_t {
+    STATE_IDLE,            // Ждет таймера, чтобы отправить REQUEST
+    STATE_WAIT_SEARCH,     // Отправлен REQUEST
+    STATE_SEARCHING,       // Получен SEARCH, ждет окончания поиска
+    STATE_WAIT_CONTINUE,   // Отправлен REPORT
+    STATE_WAIT_DISCONNECT, // Отправлен DISCONNECT
+    STATE_FINISHED         // Винни-Пух найден, стая больше ничего не отправляет
+};
+
+struct VirtualSwarm {
+    int32_t id;
+    uint32_t gameId = BEE_DEFAULT_GAME;
+    int socket;            // Номер сокета потока, через который идет обмен
+    SwarmState state = STATE_IDLE;
+    uint32_t sequence = 0; // Номер последнего запроса; ответы с другим номером устарели
+    uint32_t sessionFirst = 1; // Номер первого запроса сеанса стаи
+    int64_t sentUs = 0;    // Время первой отправки последнего запроса
+    uint8_t attempts = 0;  // Повторы последнего запроса
+    int32_t sectorId = -1;
+    uint8_t leaseCount = 0; // Арендованные секторы, о которых сообщает REPORT
+    int32_t lease[BEE_MAX_BATCH];
+};
+
+// Очередь исходящих датаграмм одного сокета, отправляемая одним вызовом sendmmsg
+struct SendQueue {
+    int count = 0;
+    struct mmsghdr msgs[LOADGEN_BATCH_SIZE];
+    struct iovec iovs[LOADGEN_BATCH_SIZE];
+    char data[LOADGEN_BATCH_SIZE][BEE_MAX_HEARTBEAT_SIZE];
+    int32_t heartbeatIds[BEE_MAX_HEARTBEAT_BATCH + 1]; // Стаи, ждущие группового HEARTBEAT
+    int heartbeatCount = 0;
+    uint32_t heartbeatGame = BEE_DEFAULT_GAME; // Игра этих стай: групповой HEARTBEAT относится к одной игре
+};
+
+// Результаты одного потока; читаются главным потоком только после его завершения,
+// кроме roundTrips, по которому выводится ход измерения
+struct LoadStats {
+    std::atomic<unsigned long> roundTrips{0};
+    unsigned long requests = 0;
+    unsigned long reports = 0;
+    unsigned long heartbeats = 0;          // Сигналы активности стай
+    unsigned long heartbeatDatagrams = 0;  // Датаграммы HEARTBEAT (групповые содержат несколько стай)
+    unsigned long heartbeatAcks = 0;
+    unsigned long disconnects = 0;
+    unsigned long denied = 0;
+    unsigned long noMoreSectors = 0;
+    unsigned long winnieFound = 0;
+    unsigned long retransmits = 0;
+    unsigned long stale = 0;
+    unsigned long cancelled = 0; // Поиски, отмененные сервером: сектор раньше исследовала другая стая
+    unsigned long sectors = 0; // Секторы, исследование которых подтверждено ответом CONTINUE
+    std::vector<uint32_t> requestLatencyUs; // REQUEST -> SEARCH
+    std::vector<uint32_t> reportLatencyUs;  // REPORT -> CONTINUE
+};
+
+struct LoadThread {
+    int index = 0;
+    int firstId = 0;
+    int epollFd = -1;
+    std::vector<int> sockets;
+    std::vector<SendQueue> queues;
+    std::vector<VirtualSwarm> swarms;
+    size_t finished = 0;   // Стаи в состоянии STATE_FINISHED
+    TimerWheel actions;    // Следующее действие стаи: запрос, отчет или повтор по таймауту
+    TimerWheel heartbeats; // Сигналы активности
+    RttEstimator rtt;      // Время оборота до сервера: у всех стай потока один и тот же путь
+    std::mt19937 gen;
+    LoadStats stats;
+    std::thread thread;
+};
+
+volatile bool running = true;
+std::atomic<bool> serverShutdown(false);
+std::atomic<int> activeThreads(0); // Потоки генератора, которые еще работают
+LoadConfig config;
+struct sockaddr_in serverAddr;
+
+void signalHandler(int) {
+    running = false;
+}
+
+// Отправляет все накопленные датаграммы сокета
+void flushQueue(LoadThread& t, int socket) {
+    SendQueue& queue = t.queues[socket];
+    int sent = 0;
+    while (sent < queue.count) {
+        int n = sendmmsg(t.sockets[socket], queue.msgs + sent, queue.count - sent, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // Переполнение буфера сокета - датаграммы считаются потерянными и будут повторены по таймауту
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) perror("Ошибка sendmmsg");
+            break;
+        }
+        sent += n;
+    }
+    queue.count = 0;
+}
+
+// Заполняет описание i-й датаграммы очереди длиной len
+void setQueuedLength(SendQueue& queue, int i, size_t len) {
+    queue.iovs[i].iov_base = queue.data[i];
+    queue.iovs[i].iov_len = len;
+    memset(&queue.msgs[i], 0, sizeof(queue.msgs[i]));
+    queue.msgs[i].msg_hdr.msg_iov = &queue.iovs[i];
+    queue.msgs[i].msg_hdr.msg_iovlen = 1;
+}
+
+// Ставит сообщение стаи в очередь ее сокета
+void queueMessage(LoadThread& t, VirtualSwarm& swarm, uint8_t type, uint32_t sequence) {
+    SendQueue& queue = t.queues[swarm.socket];
+    if (queue.count >= LOADGEN_BATCH_SIZE) flushQueue(t, swarm.socket);
+
+    BeeMessage msg;
+    msg.type = type;
+    msg.binary = true;
+    msg.gameId = swarm.gameId;
+    msg.swarmId = swarm.id;
+    msg.sectorId = swarm.sectorId;
+    msg.sequence = sequence;
+    msg.sessionStart = sequence == swarm.sessionFirst;
+    if (type == MSG_REQUEST) {
+        msg.batchSize = (uint8_t)config.lease;
+    } else if (type == MSG_REPORT) {
+        msg.sectorCount = swarm.leaseCount;
+        std::copy(swarm.lease, swarm.lease + swarm.leaseCount, msg.sectors);
+    }
+
+    int i = queue.count++;
+    size_t len = encodeBeeMessage(msg, queue.data[i]);
+    setQueuedLength(queue, i, len);
+}
+
+// Ставит в очередь сокета один групповой HEARTBEAT за все накопленные стаи
+void queueHeartbeats(LoadThread& t, int socket) {
+    SendQueue& queue = t.queues[socket];
+    if (queue.count >= LOADGEN_BATCH_SIZE) flushQueue(t, socket);
+
+    int i = queue.count++;
+    size_t len = encodeBeeHeartbeats(queue.heartbeatIds, queue.heartbeatCount, queue.data[i],
+                                     BEE_PROTOCOL_VERSION, queue.heartbeatGame);
+    setQueuedLength(queue, i, len);
+    queue.heartbeatCount = 0;
+    t.stats.heartbeatDatagrams++;
+}
+
+// Любой запрос стаи сервер считает признаком активности, поэтому HEARTBEAT нужен
+// только после heartbeatMs без запросов
+void postponeHeartbeat(LoadThread& t, int index) {
+    if (config.heartbeatMs > 0) t.heartbeats.schedule(index, monotonicMs() + config.heartbeatMs);
+}
+
+// Отправляет запрос, на который стая ждет ответа, и ставит таймер повтора
+void sendRequest(LoadThread& t, VirtualSwarm& swarm, int index, uint8_t type, SwarmState state) {
+    swarm.state = state;
+    swarm.sentUs = monotonicUs();
+    swarm.attempts = 0;
+    swarm.sequence = beeNextSequence(swarm.sequence);
+    queueMessage(t, swarm, type, swarm.sequence);
+    t.actions.schedule(index, swarm.sentUs / 1000 + t.rtt.timeoutMs(0));
+    postponeHeartbeat(t, index);
+
+    if (type == MSG_REQUEST) t.stats.requests++;
+    else if (type == MSG_REPORT) t.stats.reports++;
+}
+
+// Повторяет неподтвержденный запрос с тем же номером: сервер ответит на него, не обрабатывая заново
+void retransmitRequest(LoadThread& t, VirtualSwarm& swarm, int index, uint8_t type) {
+    if (swarm.attempts < UINT8_MAX) swarm.attempts++;
+    t.stats.retransmits++;
+    queueMessage(t, swarm, type, swarm.sequence);
+    t.actions.schedule(index, monotonicMs() + t.rtt.timeoutMs(swarm.attempts));
+    postponeHeartbeat(t, index);
+}
+
+// Срабатывание таймера действия стаи
+void onAction(LoadThread& t, int index) {
+    VirtualSwarm& swarm = t.swarms[index];
+    switch (swarm.state) {
+    case STATE_IDLE:
+        sendRequest(t, swarm, index, MSG_REQUEST, STATE_WAIT_SEARCH);
+        break;
+    case STATE_SEARCHING:
+        sendRequest(t, swarm, index, MSG_REPORT, STATE_WAIT_CONTINUE);
+        break;
+    case STATE_WAIT_SEARCH:
+        retransmitRequest(t, swarm, index, MSG_REQUEST);
+        break;
+    case STATE_WAIT_CONTINUE:
+        retransmitRequest(t, swarm, index, MSG_REPORT);
+        break;
+    case STATE_WAIT_DISCONNECT:
+        retransmitRequest(t, swarm, index, MSG_DISCONNECT);
+        break;
+    case STATE_FINISHED:
+        break;
+    }
+}
+
+// Срабатывание таймера сигнала активности
+void onHeartbeat(LoadThread& t, int index) {
+    VirtualSwarm& swarm = t.swarms[index];
+    if (swarm.state == STATE_FINISHED) return;
+    t.stats.heartbeats++;
+    if (config.heartbeatBatch > 1) {
+        // Сигналы активности стай одного сокета собираются в групповой HEARTBEAT
+        SendQueue& queue = t.queues[swarm.socket];
+        if (queue.heartbeatCount > 0 && queue.heartbeatGame != swarm.gameId) queueHeartbeats(t, swarm.socket);
+        queue.heartbeatGame = swarm.gameId;
+        queue.heartbeatIds[queue.heartbeatCount++] = swarm.id;
+        if (queue.heartbeatCount >= config.heartbeatBatch) queueHeartbeats(t, swarm.socket);
+    } else {
+        queueMessage(t, swarm, MSG_HEARTBEAT, 0);
+        t.stats.heartbeatDatagrams++;
+    }
+    t.heartbeats.schedule(index, monotonicMs() + config.heartbeatMs);
+}
+
+// Обработка ответа сервера
+void handleReply(LoadThread& t, const char* data, size_t len) {
+    BeeMessage reply;
+    if (!parseBeeMessage(data, len, reply)) return;
+
+    if (reply.type == MSG_SERVER_SHUTDOWN) {
+        serverShutdown = true;
+        return;
+    }
+
+    int index = reply.swarmId - t.firstId;
+    if (index < 0 || index >= (int)t.swarms.size()) return;
+    VirtualSwarm& swarm = t.swarms[index];
+
+    if (reply.type == MSG_HEARTBEAT_ACK) {
+        t.stats.heartbeatAcks++;
+        return;
+    }
+
+    // Уведомление о находке приходит без номера запроса
+    if (reply.type == MSG_WINNIE_FOUND) {
+        if (swarm.state != STATE_FINISHED) {
+            t.stats.winnieFound++;
+            swarm.state = STATE_FINISHED;
+            t.finished++;
+            t.actions.cancel(index);
+            t.heartbeats.cancel(index);
+        }
+        return;
+    }
+
+    // Сектор уже исследовала другая стая: он исключается из аренды, а пустая аренда завершает поиск без отчета
+    if (reply.type == MSG_CANCEL) {
+        if (swarm.state != STATE_SEARCHING) return;
+        if (swarm.leaseCount == 0) {
+            if (reply.sectorId != swarm.sectorId) return;
+        } else {
+            int32_t* end = swarm.lease + swarm.leaseCount;
+            int32_t* cancelled = std::find(swarm.lease, end, reply.sectorId);
+            if (cancelled == end) return;
+            std::copy(cancelled + 1, end, cancelled);
+            if (--swarm.leaseCount > 0) {
+                t.stats.cancelled++;
+                return;
+            }
+        }
+        t.stats.cancelled++;
+        swarm.sectorId = -1;
+        sendRequest(t, swarm, index, MSG_REQUEST, STATE_WAIT_SEARCH);
+        return;
+    }
+
+    if (reply.sequence != swarm.sequence) {
+        t.stats.stale++;
+        return;
+    }
+
+    // Задержка считается от первой отправки, время оборота - только по запросам без повторов
+    int64_t now = monotonicUs();
+    uint32_t latency = (uint32_t)std::min<int64_t>(now - swarm.sentUs, UINT32_MAX);
+    if (swarm.attempts == 0) t.rtt.sample(now - swarm.sentUs);
+
+    switch (reply.type) {
+    case MSG_SEARCH:
+        if (swarm.state != STATE_WAIT_SEARCH) break;
+        t.stats.requestLatencyUs.push_back(latency);
+        t.stats.roundTrips.fetch_add(1, std::memory_order_relaxed);
+        swarm.sectorId = reply.sectorId;
+        swarm.leaseCount = reply.sectorCount;
+        std::copy(reply.sectors, reply.sectors + reply.sectorCount, swarm.lease);
+        if (config.searchMs == 0) {
+            sendRequest(t, swarm, index, MSG_REPORT, STATE_WAIT_CONTINUE);
+        } else {
+            // Отстающие стаи моделируют тяжелый хвост времени поиска
+            int64_t searchMs = (int64_t)config.searchMs * std::max<int>(1, swarm.leaseCount);
+            if (config.straggler > 0 && std::uniform_real_distribution<>(0.0, 100.0)(t.gen) < config.straggler) {
+                searchMs *= STRAGGLER_FACTOR;
+            }
+            swarm.state = STATE_SEARCHING;
+            t.actions.schedule(index, now / 1000 + searchMs);
+        }
+        break;
+
+    case MSG_CONTINUE:
+        if (swarm.state != STATE_WAIT_CONTINUE) break;
+        t.stats.reportLatencyUs.push_back(latency);
+        t.stats.roundTrips.fetch_add(1, std::memory_order_relaxed);
+        t.stats.sectors += std::max<int>(1, swarm.leaseCount);
+        swarm.sectorId = -1;
+        swarm.leaseCount = 0;
+        if (config.churn > 0 && std::uniform_real_distribution<>(0.0, 100.0)(t.gen) < config.churn) {
+            sendRequest(t, swarm, index, MSG_DISCONNECT, STATE_WAIT_DISCONNECT);
+        } else {
+            sendRequest(t, swarm, index, MSG_REQUEST, STATE_WAIT_SEARCH);
+        }
+        break;
+
+    case MSG_DISCONNECT_ACK:
+        if (swarm.state != STATE_WAIT_DISCONNECT) break;
+        t.stats.disconnects++;
+        swarm.sectorId = -1;
+        swarm.leaseCount = 0;
+        sendRequest(t, swarm, index, MSG_REQUEST, STATE_WAIT_SEARCH);
+        break;
+
+    case MSG_DENIED:
+        // Сервер считает стаю занятой поиском (например, генератор перезапущен с теми же номерами стай): переподключаемся
+        if (swarm.state != STATE_WAIT_SEARCH) break;
+        t.stats.denied++;
+        sendRequest(t, swarm, index, MSG_DISCONNECT, STATE_WAIT_DISCONNECT);
+        break;
+
+    case MSG_NO_MORE_SECTORS:
+        if (swarm.state != STATE_WAIT_SEARCH) break;
+        t.stats.noMoreSectors++;
+        swarm.state = STATE_IDLE;
+        t.actions.schedule(index, now / 1000 + RETRY_DELAY_MS);
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Вычитывает сокет пакетами recvmmsg, пока он не опустеет
+void drainSocket(LoadThread& t, int fd) {
+    struct mmsghdr msgs[LOADGEN_BATCH_SIZE];
+    struct iovec iovs[LOADGEN_BATCH_SIZE];
+    char data[LOADGEN_BATCH_SIZE][BEE_MAX_MESSAGE_SIZE];
+
+    while (true) {
+        for (int i = 0; i < LOADGEN_BATCH_SIZE; i++) {
+            iovs[i].iov_base = data[i];
+            iovs[i].iov_len = sizeof(data[i]) - 1;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n = recvmmsg(fd, msgs, LOADGEN_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNREFUSED) {
+                perror("Ошибка приема");
+            }
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            data[i][msgs[i].msg_len] = '\0';
+            handleReply(t, data[i], msgs[i].msg_len);
+        }
+        if (n < LOADGEN_BATCH_SIZE) return;
+    }
+}
+
+// Создает неблокирующий UDP сокет, соединенный с сервером. Каждый сокет получает свой порт,
+// поэтому сервер с SO_REUSEPORT распределяет их по своим рабочим потокам
+int createSocket() {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("Ошибка создания сокета");
+        return -1;
+    }
+
+    int bufferSize = SOCKET_BUFFER_SIZE;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+    if (connect(fd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+        perror("Ошибка подключения сокета");
+        close(fd);
+        return -1;
+    }
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    return fd;
+}
+
+// Цикл потока генератора: прием ответов, таймеры стай и отправка накопленных запросов
+void runLoadThread(LoadThread& t, int64_t endMs) {
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int64_t nextHeartbeatFlushMs = 0;
+
+    // Поток завершается и после того, как все его стаи узнали о находке Винни-Пуха
+    while (running && !serverShutdown && monotonicMs() < endMs && t.finished < t.swarms.size()) {
+        int nfds = epoll_wait(t.epollFd, events, MAX_EPOLL_EVENTS, TIMER_TICK_MS);
+        if (nfds < 0 && errno != EINTR) {
+            perror("Ошибка epoll_wait");
+            break;
+        }
+        for (int i = 0; i < nfds; i++) {
+            drainSocket(t, events[i].data.fd);
+        }
+
+        int64_t now = monotonicMs();
+        t.actions.advance(now, [&t](uint64_t key) { onAction(t, (int)key); });
+        t.heartbeats.advance(now, [&t](uint64_t key) { onHeartbeat(t, (int)key); });
+
+        // Неполные групповые HEARTBEAT уходят раз в HEARTBEAT_COALESCE_MS, а не на каждом тике
+        bool flushHeartbeats = now >= nextHeartbeatFlushMs;
+        if (flushHeartbeats) nextHeartbeatFlushMs = now + HEARTBEAT_COALESCE_MS;
+        for (size_t s = 0; s < t.sockets.size(); s++) {
+            if (flushHeartbeats && t.queues[s].heartbeatCount > 0) queueHeartbeats(t, s);
+            if (t.queues[s].count > 0) flushQueue(t, s);
+        }
+    }
+    activeThreads--;
+}
+
+// Перцентиль задержки в микросекундах
+uint32_t percentile(std::vector<uint32_t>& samples, double p) {
+    if (samples.empty()) return 0;
+    size_t k = (size_t)(p * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+void printLatency(const char* name, std::vector<uint32_t>& samples) {
+    uint32_t p50 = percentile(samples, 0.50);
+    uint32_t p99 = percentile(samples, 0.99);
+    uint32_t p999 = percentile(samples, 0.999);
+    std::cout << name << ": " << samples.size() << " ответов, p50 " << p50 << " мкс, p99 " << p99
+              << " мкс, p999 " << p999 << " мкс" << std::endl;
+}
+
+// Отправляет команду на управляющий порт и ждет ответа; пустая строка - ответа нет
+std::string controlCommand(int fd, const std::string& command) {
+    if (send(fd, command.data(), command.size(), 0) < 0) {
+        perror("Ошибка отправки команды управления");
+        return "";
+    }
+    char buffer[1024];
+    ssize_t n = recv(fd, buffer, sizeof(buffer) - 1, 0);
+    if (n <= 0) return "";
+    buffer[n] = '\0';
+    return buffer;
+}
+
+// Создает config.games игр через управляющий порт сервера. Возвращает их номера или пустой список
+std::vector<uint32_t> createGames(int controlFd) {
+    std::vector<uint32_t> gameIds;
+    std::string command = "CREATE_GAME:" + std::to_string(config.gameSectors);
+    for (int i = 0; i < config.games; i++) {
+        std::string reply = controlCommand(controlFd, command);
+        if (reply.compare(0, 13, "GAME_CREATED:") != 0) {
+            std::cerr << "Не удалось создать игру: " << (reply.empty() ? "нет ответа" : reply) << std::endl;
+            break;
+        }
+        gameIds.push_back((uint32_t)strtoul(reply.c_str() + 13, nullptr, 10));
+    }
+    return gameIds;
+}
+
+// Запрашивает ASSIGN_STATS игр и выводит средний перелет на сектор и длительность игр
+void printAssignmentStats(int controlFd, const std::vector<uint32_t>& gameIds) {
+    std::string policy;
+    unsigned long assigned = 0, searchCost = 0;
+    double flight = 0;
+    long long totalMs = 0, maxMs = 0;
+    int answered = 0;
+    for (uint32_t gameId : gameIds) {
+        std::string reply = controlCommand(controlFd, "ASSIGN_STATS:" + std::to_string(gameId));
+        char name[32];
+        unsigned long gameAssigned, gameCost;
+        double gameFlight;
+        long long gameMs;
+        if (sscanf(reply.c_str(), "ASSIGN_STATS:%*u:%31[^:]:%lu:%lf:%lu:%lld", name, &gameAssigned, &gameFlight, &gameCost, &gameMs) != 5) continue;
+        policy = name;
+        assigned += gameAssigned;
+        flight += gameFlight;
+        searchCost += gameCost;
+        totalMs += gameMs;
+        maxMs = std::max(maxMs, gameMs);
+        answered++;
+    }
+    if (answered == 0 || assigned == 0) return;
+    std::cout << "Назначение секторов (" << policy << "): выдано " << assigned << ", перелет в среднем "
+              << flight / assigned << " на сектор, оценка поиска в среднем " << (double)searchCost / assigned
+              << ", игра длилась в среднем " << totalMs / answered << " мс (максимум " << maxMs << " мс)" << std::endl;
+
+    unsigned long copies = 0, wins = 0, losses = 0;
+    for (uint32_t gameId : gameIds) {
+        std::string reply = controlCommand(controlFd, "SPECULATION_STATS:" + std::to_string(gameId));
+        unsigned long gameCopies, gameWins, gameLosses;
+        if (sscanf(reply.c_str(), "SPECULATION_STATS:%*u:%lu:%lu:%lu", &gameCopies, &gameWins, &gameLosses) != 3) continue;
+        copies += gameCopies;
+        wins += gameWins;
+        losses += gameLosses;
+    }
+    std::cout << "Повторная выдача секторов: копий " << copies << ", опередили первую стаю " << wins
+              << ", не пригодились " << losses << std::endl;
+}
+
+// Сводка метрик сервера (команда METRICS): время обработки сообщений на сервере и ожидание мьютексов
+void printServerMetrics(int controlFd) {
+    std::string reply = controlCommand(controlFd, "METRICS");
+    unsigned long messages, malformed, locks, waits, queued, drops, journalPending;
+    double p50, p99, p999, waitP99, batch;
+    if (sscanf(reply.c_str(), "METRICS:%lu:%lu:%lf:%lf:%lf:%lu:%lu:%lf:%lf:%lu:%lu:%lu", &messages, &malformed,
+               &p50, &p99, &p999, &locks, &waits, &waitP99, &batch, &queued, &drops, &journalPending) != 12) return;
+    std::cout << "Сервер с момента запуска: обработано сообщений " << messages << " (p50 " << p50 << " мкс, p99 " << p99
+              << " мкс, p99.9 " << p999 << " мкс), мьютекс шарда занят при " << waits << " из " << locks
+              << " захватов (p99 ожидания " << waitP99 << " мкс), в среднем " << batch
+              << " датаграмм за recvmmsg, потеряно в очередях сокетов " << drops << std::endl;
+}
+
+// Соединенный сокет управляющего порта с таймаутом приема
+int createControlSocket() {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("Ошибка создания сокета управления");
+        return -1;
+    }
+    struct sockaddr_in controlAddr = serverAddr;
+    controlAddr.sin_port = htons(ntohs(serverAddr.sin_port) + CONTROL_PORT_OFFSET);
+    struct timeval tv;
+    tv.tv_sec = CONTROL_TIMEOUT_MS / 1000;
+    tv.tv_usec = (CONTROL_TIMEOUT_MS % 1000) * 1000;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0 ||
+        connect(fd, (struct sockaddr*)&controlAddr, sizeof(controlAddr)) < 0) {
+        perror("Ошибка настройки сокета управления");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Использование: " << argv[0] << " <SERVER_IP> <SERVER_PORT> [--swarms N] [--threads N] [--sockets N]"
+                  << " [--duration SEC] [--search-ms MS] [--heartbeat-ms MS] [--churn PERCENT] [--straggler PERCENT] [--first-id ID]"
+                  << " [--lease N] [--heartbeat-batch N] [--games N] [--game-sectors N]" << std::endl;
+        return 1;
+    }
+
+    for (int i = 3; i < argc; i++) {
+        if (i + 1 >= argc) {
+            std::cerr << "Не задано значение параметра " << argv[i] << std::endl;
+            return 1;
+        }
+        if (strcmp(argv[i], "--swarms") == 0) {
+            config.swarms = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            config.threads = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sockets") == 0) {
+            config.socketsPerThread = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0) {
+            config.duration = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--search-ms") == 0) {
+            config.searchMs = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--heartbeat-ms") == 0) {
+            config.heartbeatMs = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--churn") == 0) {
+            config.churn = std::stod(argv[++i]);
+        } else if (strcmp(argv[i], "--straggler") == 0) {
+            config.straggler = std::stod(argv[++i]);
+        } else if (strcmp(argv[i], "--first-id") == 0) {
+            config.firstId = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--heartbeat-batch") == 0) {
+            config.heartbeatBatch = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--lease") == 0) {
+            config.lease = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--games") == 0) {
+            config.games = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--game-sectors") == 0) {
+            config.gameSectors = std::stoi(argv[++i]);
+        } else {
+            std::cerr << "Неизвестный параметр: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    config.swarms = std::max(1, config.swarms);
+    config.threads = std::max(1, std::min(config.threads, config.swarms));
+    config.socketsPerThread = std::max(1, config.socketsPerThread);
+    config.duration = std::max(1, config.duration);
+    config.searchMs = std::max(0, config.searchMs);
+    config.heartbeatMs = std::max(0, config.heartbeatMs);
+    config.lease = std::max(0, std::min(config.lease, BEE_MAX_BATCH));
+    config.heartbeatBatch = std::max(1, std::min(config.heartbeatBatch, BEE_MAX_HEARTBEAT_BATCH + 1));
+
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(std::stoi(argv[2]));
+    if (inet_pton(AF_INET, argv[1], &serverAddr.sin_addr) != 1) {
+        std::cerr << "Неверный адрес сервера: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    // Отдельные игры на время измерения; стаи делятся между ними непрерывными диапазонами номеров
+    std::vector<uint32_t> gameIds;
+    int controlFd = -1;
+    if (config.games > 0) {
+        controlFd = createControlSocket();
+        if (controlFd < 0) return 1;
+        int64_t createStartMs = monotonicMs();
+        gameIds = createGames(controlFd);
+        if ((int)gameIds.size() < config.games) {
+            for (uint32_t gameId : gameIds) controlCommand(controlFd, "DESTROY_GAME:" + std::to_string(gameId));
+            close(controlFd);
+            return 1;
+        }
+        std::cout << "Генератор нагрузки: создано игр " << gameIds.size() << " по " << config.gameSectors
+                  << " секторов за " << monotonicMs() - createStartMs << " мс" << std::endl;
+    }
+
+    // Стаи делятся между потоками непрерывными диапазонами номеров
+    int64_t startMs = monotonicMs();
+    std::vector<std::unique_ptr<LoadThread>> threads;
+    for (int i = 0; i < config.threads; i++) {
+        std::unique_ptr<LoadThread> t(new LoadThread());
+        t->index = i;
+        int begin = (int)((int64_t)config.swarms * i / config.threads);
+        int end = (int)((int64_t)config.swarms * (i + 1) / config.threads);
+        t->firstId = config.firstId + begin;
+        t->gen.seed(std::random_device()() + i);
+        t->actions.init(startMs, TIMER_TICK_MS, TIMER_WHEEL_SLOTS);
+        t->heartbeats.init(startMs, TIMER_TICK_MS, TIMER_WHEEL_SLOTS);
+
+        t->epollFd = epoll_create1(0);
+        if (t->epollFd < 0) {
+            perror("Ошибка создания epoll");
+            return 1;
+        }
+        t->queues.resize(config.socketsPerThread);
+        for (int s = 0; s < config.socketsPerThread; s++) {
+            int fd = createSocket();
+            if (fd < 0) return 1;
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            if (epoll_ctl(t->epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                perror("Ошибка настройки epoll");
+                return 1;
+            }
+            t->sockets.push_back(fd);
+        }
+
+        // Первые запросы и сигналы активности растянуты во времени, чтобы не получить залп при старте
+        std::uniform_int_distribution<int> ramp(0, DEFAULT_RAMP_MS);
+        t->swarms.resize(end - begin);
+        for (int k = 0; k < end - begin; k++) {
+            t->swarms[k].id = t->firstId + k;
+            t->swarms[k].socket = k % config.socketsPerThread;
+            t->swarms[k].sessionFirst = beeSessionFirstSequence(BEE_PROTOCOL_VERSION);
+            t->swarms[k].sequence = t->swarms[k].sessionFirst - 1;
+            if (!gameIds.empty()) t->swarms[k].gameId = gameIds[(int64_t)(begin + k) * gameIds.size() / config.swarms];
+            t->actions.schedule(k, startMs + ramp(t->gen));
+            if (config.heartbeatMs > 0) {
+                t->heartbeats.schedule(k, startMs + ramp(t->gen) + config.heartbeatMs);
+            }
+        }
+        threads.push_back(std::move(t));
+    }
+
+    std::cout << "Генератор нагрузки: " << config.swarms << " стай, " << config.threads << " потоков по "
+              << config.socketsPerThread << " сокетов, поиск " << config.searchMs << " мс, сигналы активности "
+              << config.heartbeatMs << " мс, отключения " << config.churn << "%, аренда " << config.lease << " секторов" << std::endl;
+
+    int64_t endMs = startMs + (int64_t)config.duration * 1000;
+    activeThreads = config.threads;
+    for (auto& t : threads) {
+        LoadThread* thread = t.get();
+        thread->thread = std::thread([thread, endMs]() { runLoadThread(*thread, endMs); });
+    }
+
+    // Ход измерения раз в секунду
+    unsigned long lastRoundTrips = 0;
+    while (running && !serverShutdown && monotonicMs() < endMs && activeThreads > 0) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        unsigned long roundTrips = 0;
+        for (auto& t : threads) roundTrips += t->stats.roundTrips.load(std::memory_order_relaxed);
+        std::cout << "Генератор нагрузки: " << (roundTrips - lastRoundTrips) << " ответов/с" << std::endl;
+        lastRoundTrips = roundTrips;
+    }
+
+    LoadStats total;
+    for (auto& t : threads) {
+        t->thread.join();
+        LoadStats& s = t->stats;
+        total.requests += s.requests;
+        total.reports += s.reports;
+        total.heartbeats += s.heartbeats;
+        total.heartbeatDatagrams += s.heartbeatDatagrams;
+        total.heartbeatAcks += s.heartbeatAcks;
+        total.disconnects += s.disconnects;
+        total.denied += s.denied;
+        total.noMoreSectors += s.noMoreSectors;
+        total.winnieFound += s.winnieFound;
+        total.retransmits += s.retransmits;
+        total.stale += s.stale;
+        total.cancelled += s.cancelled;
+        total.sectors += s.sectors;
+        total.requestLatencyUs.insert(total.requestLatencyUs.end(), s.requestLatencyUs.begin(), s.requestLatencyUs.end());
+        total.reportLatencyUs.insert(total.reportLatencyUs.end(), s.reportLatencyUs.begin(), s.reportLatencyUs.end());
+
+        for (int fd : t->sockets) close(fd);
+        close(t->epollFd);
+    }
+    double elapsed = (monotonicMs() - startMs) / 1000.0;
+
+    if (serverShutdown) std::cout << "Генератор нагрузки: Сервер завершил работу" << std::endl;
+    std::cout << "Генератор нагрузки: за " << elapsed << " с отправлено " << total.requests << " REQUEST и "
+              << total.reports << " REPORT (" << (total.requests + total.reports) / elapsed << " запросов/с), "
+              << total.heartbeats << " HEARTBEAT в " << total.heartbeatDatagrams << " датаграммах" << std::endl;
+    std::cout << "Ответы: SEARCH " << total.requestLatencyUs.size() << ", CONTINUE " << total.reportLatencyUs.size()
+              << ", HEARTBEAT_ACK " << total.heartbeatAcks << ", DISCONNECT_ACK " << total.disconnects
+              << ", DENIED " << total.denied << ", NO_MORE_SECTORS " << total.noMoreSectors
+              << ", WINNIE_FOUND " << total.winnieFound << std::endl;
+    std::cout << "Исследовано секторов: " << total.sectors << " (" << total.sectors / elapsed << " секторов/с)" << std::endl;
+    std::cout << "Повторы запросов: " << total.retransmits << ", устаревшие ответы: " << total.stale
+              << ", отмененные поиски: " << total.cancelled << std::endl;
+    printLatency("REQUEST -> SEARCH", total.requestLatencyUs);
+    printLatency("REPORT -> CONTINUE", total.reportLatencyUs);
+
+    // Перелет и длительность игр по данным сервера (для сравнения политик --policy)
+    if (controlFd < 0) controlFd = createControlSocket();
+    if (controlFd >= 0) printAssignmentStats(controlFd, gameIds.empty() ? std::vector<uint32_t>{BEE_DEFAULT_GAME} : gameIds);
+    if (controlFd >= 0) printServerMetrics(controlFd);
+
+    if (!gameIds.empty()) {
+        int destroyed = 0;
+        for (uint32_t gameId : gameIds) {
+            if (controlCommand(controlFd, "DESTROY_GAME:" + std::to_string(gameId)).compare(0, 3, "OK:") == 0) destroyed++;
+        }
+        std::cout << "Генератор нагрузки: удалено игр " << destroyed << " из " << gameIds.size() << std::endl;
+    }
+    if (controlFd >= 0) close(controlFd);
+    return 0;
+}
@@ -0,0 +1,203 @@
+// bee_log.h
+#ifndef BEE_LOG_H
+#define BEE_LOG_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// Асинхронный журнал. Поток, который пишет в журнал, не форматирует текст и не выполняет
+// вывод: он кладет в свое кольцо запись фиксированного размера (время, уровень, указатель
+// на строку формата и целые аргументы). Фоновый поток периодически забирает записи из всех
+// колец, форматирует их и выводит одним вызовом write.
+// Записи сверх LOG_RATE_LIMIT в секунду на поток и записи, не поместившиеся в кольцо,
+// отбрасываются с подсчетом. Уровень журнала 0 отключает его полностью: запись сводится
+// к одному сравнению.
+#define LOG_RING_SIZE 8192 // Записей в кольце одного потока (степень двойки)
+#define LOG_MAX_ARGS 4 // Максимальное количество аргументов записи
+#define LOG_RATE_LIMIT 20000 // Максимум записей в секунду от одного потока (кроме предупреждений)
+#define LOG_FLUSH_INTERVAL_MS 20 // Период вывода накопленных записей (мс)
+#define LOG_OUTPUT_BUFFER_SIZE 65536 // Размер буфера вывода фонового потока
+
+// Уровни журнала
+enum LogLevel {
+    LOG_OFF = 0,
+    LOG_WARN = 1,  // Отключения по таймауту и другие отклонения
+    LOG_INFO = 2,  // Подключения, отключения, находка Винни-Пуха
+    LOG_DEBUG = 3  // Каждое назначение сектора и каждый отчет
+};
+
+// Запись журнала. format - строковый литерал: в кольце хранится только указатель.
+// В формате допустимы %d (целое) и %a (IPv4 адрес в порядке байт хоста)
+struct LogRecord {
+    int64_t timeNs;
+    const char* format;
+    uint8_t level;
+    uint8_t argCount;
+    int32_t args[LOG_MAX_ARGS];
+};
+
+// Кольцо одного потока: один писатель (поток-владелец) и один читатель (фоновый поток)
+struct LogRing {
+    LogRecord records[LOG_RING_SIZE];
+    std::atomic<uint64_t> head{0}; // Следующая запись писателя
+    std::atomic<uint64_t> tail{0}; // Следующая запись читателя
+    std::atomic<unsigned long> dropped{0};
+    int64_t rateSecond = 0; // Текущая секунда ограничения частоты (только для писателя)
+    int rateCount = 0;
+};
+
+inline std::atomic<int> logLevel(LOG_DEBUG);
+inline std::mutex logRingsMutex; // Список колец: регистрация нового потока и обход фоновым потоком
+inline std::vector<std::unique_ptr<LogRing>> logRings;
+inline std::atomic<bool> logWriterRunning(false);
+inline std::thread logWriter;
+
+inline int64_t logRealtimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Кольцо текущего потока; создается при первой записи
+inline LogRing& threadLogRing() {
+    thread_local LogRing* ring = nullptr;
+    if (ring == nullptr) {
+        std::unique_ptr<LogRing> created(new LogRing());
+        ring = created.get();
+        std::lock_guard<std::mutex> lock(logRingsMutex);
+        logRings.push_back(std::move(created));
+    }
+    return *ring;
+}
+
+inline void appendLogRecord(int level, const char* format, const int32_t* args, int argCount) {
+    LogRing& ring = threadLogRing();
+    int64_t now = logRealtimeNs();
+
+    // Ограничение частоты: предупреждения не отбрасываются
+    if (level > LOG_WARN) {
+        int64_t second = now / 1000000000;
+        if (second != ring.rateSecond) {
+            ring.rateSecond = second;
+            ring.rateCount = 0;
+        }
+        if (++ring.rateCount > LOG_RATE_LIMIT) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= LOG_RING_SIZE) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    LogRecord& record = ring.records[head & (LOG_RING_SIZE - 1)];
+    record.timeNs = now;
+    record.format = format;
+    record.level = (uint8_t)level;
+    record.argCount = (uint8_t)argCount;
+    for (int i = 0; i < argCount; i++) record.args[i] = args[i];
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+// Запись в журнал: logEvent(LOG_INFO, "Сервер: Стая #%d подключена", swarmId)
+template <class... Args>
+inline void logEvent(int level, const char* format, Args... args) {
+    static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Слишком много аргументов записи журнала");
+    if (level > logLevel.load(std::memory_order_relaxed)) return;
+    int32_t values[LOG_MAX_ARGS] = {(int32_t)args...};
+    appendLogRecord(level, format, values, sizeof...(Args));
+}
+
+// Форматирует запись в буфер, возвращает длину
+inline size_t formatLogRecord(const LogRecord& record, char* buf, size_t size) {
+    static const char* levelNames[] = {"", "WARN", "INFO", "DEBUG"};
+    time_t seconds = record.timeNs / 1000000000;
+    struct tm local;
+    localtime_r(&seconds, &local);
+    int n = snprintf(buf, size, "%02d:%02d:%02d.%03d [%s] ", local.tm_hour, local.tm_min, local.tm_sec,
+                     (int)(record.timeNs / 1000000 % 1000), levelNames[record.level & 3]);
+    size_t len = n > 0 ? (size_t)n : 0;
+
+    int arg = 0;
+    for (const char* p = record.format; *p != '\0' && len + 24 < size; p++) {
+        if (p[0] == '%' && (p[1] == 'd' || p[1] == 'a') && arg < record.argCount) {
+            int32_t value = record.args[arg++];
+            if (p[1] == 'd') {
+                len += snprintf(buf + len, size - len, "%d", value);
+            } else {
+                uint32_t ip = (uint32_t)value;
+                len += snprintf(buf + len, size - len, "%u.%u.%u.%u", ip >> 24, (ip >> 16) & 255, (ip >> 8) & 255, ip & 255);
+            }
+            p++;
+        } else {
+            buf[len++] = *p;
+        }
+    }
+    buf[len++] = '\n';
+    return len;
+}
+
+// Забирает записи из всех колец и выводит их. Записи разных потоков выводятся по кольцам,
+// поэтому порядок между потоками определяется временем в начале строки
+inline void drainLogRings() {
+    static char output[LOG_OUTPUT_BUFFER_SIZE];
+    size_t used = 0;
+    auto flush = [&used]() {
+        size_t written = 0;
+        while (written < used) {
+            ssize_t n = write(STDOUT_FILENO, output + written, used - written);
+            if (n <= 0) break;
+            written += n;
+        }
+        used = 0;
+    };
+
+    std::lock_guard<std::mutex> lock(logRingsMutex);
+    for (auto& ring : logRings) {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; tail++) {
+            if (LOG_OUTPUT_BUFFER_SIZE - used < 1024) flush();
+            used += formatLogRecord(ring->records[tail & (LOG_RING_SIZE - 1)], output + used, 1024);
+        }
+        ring->tail.store(tail, std::memory_order_release);
+
+        unsigned long dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            if (LOG_OUTPUT_BUFFER_SIZE - used < 1024) flush();
+            used += snprintf(output + used, 1024, "Журнал: пропущено записей: %lu\n", dropped);
+        }
+    }
+    flush();
+}
+
+// Запускает фоновый поток вывода журнала
+inline void startLogWriter() {
+    logWriterRunning = true;
+    logWriter = std::thread([]() {
+        while (logWriterRunning) {
+            drainLogRings();
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+        }
+    });
+}
+
+// Останавливает фоновый поток и выводит оставшиеся записи
+inline void stopLogWriter() {
+    logWriterRunning = false;
+    if (logWriter.joinable()) logWriter.join();
+    drainLogRings();
+}
+
+#endif // BEE_LOG_H
@@ -12,6 +12,16 @@
 #include <cstdlib>
 #include <signal.h>
 #include <limits>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+
+extern char** environ;
 // ANSI-коды цветов для терминала
 #define COLOR_RESET   "\033[0m"
 #define COLOR_RED     "\033[31m"
@@ -23,6 +33,17 @@
 #define COLOR_WHITE   "\033[37m"
 #define BOLD          "\033[1m"
 
+#define REPLY_BUFFER_SIZE 65536 // Ответ сервера - одна датаграмма UDP
+#define LIST_PAGE_SWARMS 20 // Стай на одной странице списка
+#define SUPERVISOR_PORT_OFFSET 1000 // Порт управления супервизором: порт управления сервера + смещение
+#define SUPERVISOR_MAX_SWARMS 100000 // Наибольшее число стай под супервизором
+#define SPAWN_BATCH 256 // Запусков за один проход цикла супервизора: между пачками принимаются сигналы и команды
+#define RESTART_BACKOFF_MIN_MS 500 // Задержка первого перезапуска упавшей стаи (мс)
+#define RESTART_BACKOFF_MAX_MS 30000 // Наибольшая задержка перезапуска (мс); задержка удваивается после каждого падения
+#define STABLE_RUN_MS 10000 // Стая, проработавшая дольше, после падения перезапускается с наименьшей задержкой (мс)
+#define STOP_TIMEOUT_MS 5000 // Ожидание завершения стай после SIGTERM перед SIGKILL (мс)
+#define SUPERVISOR_STATUS_MS 1000 // Наименьший интервал между строками состояния супервизора (мс)
+
 // Флаг для обработки Ctrl+C
 volatile bool running = true;
 
@@ -32,6 +53,7 @@ struct BeeInfo {
     bool active;
     bool disconnected;
     int currentSector;
+    long seenAgo; // Секунд с последнего контакта
 };
 
 // Обработчик сигнала для корректного завершения
@@ -51,7 +73,7 @@ std::string sendCommand(int sockfd, const std::string& command, const struct soc
     }
     
     // Получаем ответ
-    char buffer[4096] = {0};
+    static char buffer[REPLY_BUFFER_SIZE];
     socklen_t addrLen = sizeof(serverAddr);
     
     // Устанавливаем таймаут
@@ -71,9 +93,12 @@ std::string sendCommand(int sockfd, const std::string& command, const struct soc
     return std::string(buffer);
 }
 
-// Функция для парсинга списка стай из ответа сервера
-std::map<int, BeeInfo> parseBeesInfo(const std::string& response) {
+// Функция для парсинга страницы списка стай из ответа сервера
+// BEES:<курсор следующей страницы или END>:<id>:<активна>:<отключена>:<сектор>:<секунд с контакта>:...
+// В cursor записывается курсор следующей страницы (пустой, если страниц больше нет)
+std::map<int, BeeInfo> parseBeesInfo(const std::string& response, std::string& cursor) {
     std::map<int, BeeInfo> bees;
+    cursor.clear();
     
     if (response.substr(0, 5) != "BEES:") {
         return bees;
@@ -83,6 +108,8 @@ std::map<int, BeeInfo> parseBeesInfo(const std::string& response) {
     std::istringstream ss(data);
     std::string token;
     
+    if (std::getline(ss, token, ':') && token != "END") cursor = token;
+    
     while (std::getline(ss, token, ':')) {
         BeeInfo info;
         info.id = std::stoi(token);
@@ -90,6 +117,7 @@ std::map<int, BeeInfo> parseBeesInfo(const std::string& response) {
         if (std::getline(ss, token, ':')) info.active = (token == "1");
         if (std::getline(ss, token, ':')) info.disconnected = (token == "1");
         if (std::getline(ss, token, ':')) info.currentSector = std::stoi(token);
+        if (std::getline(ss, token, ':')) info.seenAgo = std::stol(token);
         
         bees[info.id] = info;
     }
@@ -97,6 +125,16 @@ std::map<int, BeeInfo> parseBeesInfo(const std::string& response) {
     return bees;
 }
 
+// Запрашивает страницу списка стай после курсора cursor (пустой - с начала) с условиями filter
+std::string requestBeesPage(int sockfd, const struct sockaddr_in& serverAddr, const std::string& cursor,
+                            const std::string& filter, int limit) {
+    std::string command = "LIST_BEES";
+    if (!cursor.empty()) command += ":" + cursor;
+    if (!filter.empty()) command += ":" + filter;
+    command += ":LIMIT=" + std::to_string(limit);
+    return sendCommand(sockfd, command, serverAddr);
+}
+
 // Функция для отображения списка стай
 void displayBees(const std::map<int, BeeInfo>& bees) {
     std::cout << BOLD << COLOR_CYAN << "=== Список стай пчел ===" << COLOR_RESET << std::endl;
@@ -106,8 +144,8 @@ void displayBees(const std::map<int, BeeInfo>& bees) {
         return;
     }
     
-    std::cout << BOLD << "ID  | Статус               | Текущий сектор" << COLOR_RESET << std::endl;
-    std::cout << "----+----------------------+---------------" << std::endl;
+    std::cout << BOLD << "ID  | Статус               | Текущий сектор | Последний контакт" << COLOR_RESET << std::endl;
+    std::cout << "----+----------------------+----------------+------------------" << std::endl;
     
     for (const auto& [id, info] : bees) {
         std::string status;
@@ -131,10 +169,35 @@ void displayBees(const std::map<int, BeeInfo>& bees) {
             sectorInfo = "В улье";
         }
         
-        printf("%s%-3d%s | %s%-20s%s | %s\n", 
+        printf("%s%-3d%s | %s%-20s%s | %-14s | %ld с назад\n", 
                BOLD, info.id, COLOR_RESET, 
                color.c_str(), status.c_str(), COLOR_RESET, 
-               sectorInfo.c_str());
+               sectorInfo.c_str(), info.seenAgo);
+    }
+}
+
+// Показывает список стай по страницам: условия отбора проверяет сервер, а в памяти
+// контроллера одновременно находится только одна страница
+void browseBees(int sockfd, const struct sockaddr_in& serverAddr, const std::string& filter) {
+    std::string cursor;
+    int page = 1;
+    while (true) {
+        std::string response = requestBeesPage(sockfd, serverAddr, cursor, filter, LIST_PAGE_SWARMS);
+        if (response.find("ERROR:") == 0) {
+            std::cout << COLOR_RED << response.substr(6) << COLOR_RESET << std::endl;
+            return;
+        }
+        
+        auto bees = parseBeesInfo(response, cursor);
+        std::cout << BOLD << COLOR_CYAN << "Страница " << page++ << COLOR_RESET << std::endl;
+        displayBees(bees);
+        if (cursor.empty()) return;
+        
+        // Страница может быть пустой: сервер ограничивает просмотр при редко выполняемых условиях
+        std::cout << "Enter - следующая страница, q - закончить просмотр: ";
+        std::string answer;
+        std::getline(std::cin, answer);
+        if (answer == "q" || answer == "Q") return;
     }
 }
 
@@ -191,6 +254,378 @@ void parseStatus(const std::string& response) {
     }
 }
 
+// ===== Режим супервизора (--supervise K) =====
+
+// Монотонное время в миллисекундах
+int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Запускает процесс стаи через posix_spawn: адресное пространство менеджера не копируется,
+// сигналы в процессе стаи - по умолчанию, а своя группа процессов не дает Ctrl+C в терминале
+// менеджера дойти до стай. Вывод стаи - в bee_<ID>.log (или никуда при logs = false).
+// Возвращает pid или -1
+pid_t spawnSwarm(const std::string& clientPath, const std::string& serverIP, int serverPort, int swarmId,
+                 const std::vector<std::string>& extraArgs, bool logs) {
+    std::vector<std::string> args = {clientPath, serverIP, std::to_string(serverPort), std::to_string(swarmId)};
+    args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+    std::vector<char*> argv;
+    for (std::string& arg : args) argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    std::string logPath = logs ? "bee_" + std::to_string(swarmId) + ".log" : "/dev/null";
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+    pid_t pid;
+    int error = posix_spawn(&pid, clientPath.c_str(), &actions, &attr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (error != 0) {
+        std::cerr << COLOR_RED << "Ошибка запуска стаи #" << swarmId << ": " << strerror(error) << COLOR_RESET << std::endl;
+        return -1;
+    }
+    return pid;
+}
+
+struct SupervisorConfig {
+    std::string serverIP;
+    int serverPort = 0;
+    int target = 0;                      // Число стай
+    int firstId = 1;                     // Номер первой стаи; стаи получают номера firstId .. firstId + K - 1
+    std::string clientPath = "./bee_client_10";
+    int listenPort = 0;                  // Порт управления супервизором
+    bool logs = true;                    // Вывод стай в bee_<ID>.log
+    std::vector<std::string> clientArgs; // Параметры стаи после "--"
+};
+
+// Супервизор поддерживает заданное число процессов стай: запускает их пачками через posix_spawn,
+// узнает о завершении через signalfd (SIGCHLD) и waitpid, перезапускает упавшие стаи с растущей
+// задержкой и меняет число стай по командам UDP-порта управления. Весь цикл - один поток и poll
+class SwarmSupervisor {
+public:
+    explicit SwarmSupervisor(const SupervisorConfig& supervisorConfig) : config(supervisorConfig) {}
+
+    int run() {
+        // Сигналы приходят в цикл как чтение signalfd, а не в асинхронный обработчик
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGCHLD);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        sigprocmask(SIG_BLOCK, &signals, nullptr);
+        signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (signalFd < 0) {
+            perror("Ошибка создания signalfd");
+            return 1;
+        }
+
+        // Управлять супервизором можно только с той же машины
+        controlFd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (controlFd < 0) {
+            perror("Ошибка создания сокета управления");
+            return 1;
+        }
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(config.listenPort);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(controlFd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+            perror("Ошибка привязки сокета управления");
+            return 1;
+        }
+
+        std::cout << BOLD << COLOR_GREEN << "Супервизор стай запущен: " << config.target << " стай с #" << config.firstId
+                  << ", сервер " << config.serverIP << ":" << config.serverPort << COLOR_RESET << std::endl;
+        std::cout << "Управление: UDP 127.0.0.1:" << config.listenPort
+                  << " (SCALE:<N>, SCALE:+<N>, SCALE:-<N>, STATUS, STOP)" << std::endl;
+
+        startedAt = nowMs();
+        scaleTo(config.target);
+
+        struct pollfd fds[2];
+        fds[0].fd = signalFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = controlFd;
+        fds[1].events = POLLIN;
+        while (!stopping) {
+            int64_t now = nowMs();
+            launchDue(now);
+
+            // Ждем до ближайшего перезапуска; если очередь запуска не разобрана - не ждем совсем
+            int timeout = SUPERVISOR_STATUS_MS;
+            if (!launchQueue.empty()) {
+                timeout = (int)std::max<int64_t>(0, std::min<int64_t>(timeout, launchQueue.begin()->first - nowMs()));
+            }
+            int ready = poll(fds, 2, timeout);
+            if (ready < 0 && errno != EINTR) {
+                perror("Ошибка poll");
+                break;
+            }
+            if (ready > 0 && (fds[0].revents & POLLIN)) handleSignals();
+            if (ready > 0 && (fds[1].revents & POLLIN)) handleCommands();
+            printStatus(false);
+        }
+
+        stopAll();
+        printStatus(true);
+        close(controlFd);
+        close(signalFd);
+        return 0;
+    }
+
+private:
+    struct SwarmProcess {
+        pid_t pid = 0;          // 0 - процесс не запущен
+        int64_t startedAt = 0;  // Время запуска (мс)
+        int64_t launchAt = 0;   // Время запланированного запуска; 0 - запуск не запланирован
+        int backoffMs = 0;      // Задержка перед последним перезапуском
+        bool finished = false;  // Стая завершилась сама (код 0) и не перезапускается
+        bool stopping = false;  // Стае отправлен SIGTERM при уменьшении числа стай
+    };
+
+    // Планирует запуск стаи с индексом index на время at
+    void schedule(size_t index, int64_t at) {
+        swarms[index].launchAt = at;
+        launchQueue.emplace(at, index);
+    }
+
+    // Меняет число стай: новые стаи запускаются сразу, лишние (с наибольшими номерами) получают SIGTERM
+    void scaleTo(int newTarget) {
+        int64_t now = nowMs();
+        if ((size_t)newTarget > swarms.size()) swarms.resize(newTarget);
+        for (int i = newTarget; i < target; i++) {
+            SwarmProcess& swarm = swarms[i];
+            swarm.launchAt = 0;
+            if (swarm.pid > 0 && !swarm.stopping) {
+                kill(swarm.pid, SIGTERM);
+                swarm.stopping = true;
+            }
+        }
+        for (int i = target; i < newTarget; i++) {
+            SwarmProcess& swarm = swarms[i];
+            swarm.finished = false;
+            swarm.backoffMs = 0;
+            if (swarm.pid == 0) schedule(i, now); // Останавливаемая стая запустится заново после завершения
+        }
+        target = newTarget;
+        statusChanged = true;
+    }
+
+    // Запускает стаи, время которых пришло, не больше SPAWN_BATCH за проход
+    void launchDue(int64_t now) {
+        int launched = 0;
+        while (!launchQueue.empty() && launchQueue.begin()->first <= now && launched < SPAWN_BATCH) {
+            auto [at, index] = *launchQueue.begin();
+            launchQueue.erase(launchQueue.begin());
+            SwarmProcess& swarm = swarms[index];
+            // Запись устарела: стая уже запущена, убрана или перепланирована
+            if ((int)index >= target || swarm.pid != 0 || swarm.finished || swarm.launchAt != at) continue;
+
+            swarm.launchAt = 0;
+            pid_t pid = spawnSwarm(config.clientPath, config.serverIP, config.serverPort, config.firstId + (int)index,
+                                   config.clientArgs, config.logs);
+            launched++;
+            if (pid < 0) {
+                // Например, исчерпан лимит процессов - повторяем позже, как после падения
+                spawnFailures++;
+                swarm.startedAt = now;
+                swarm.backoffMs = nextBackoff(swarm, now);
+                schedule(index, now + swarm.backoffMs);
+                continue;
+            }
+            swarm.pid = pid;
+            swarm.startedAt = now;
+            processes[pid] = index;
+            launches++;
+        }
+        if (launched > 0) statusChanged = true;
+    }
+
+    // Задержка перезапуска: удваивается после каждого падения подряд, сбрасывается после долгой работы.
+    // Случайная добавка до четверти задержки разводит перезапуски стай, упавших одновременно
+    int nextBackoff(const SwarmProcess& swarm, int64_t now) {
+        int backoff = RESTART_BACKOFF_MIN_MS;
+        if (swarm.backoffMs > 0 && now - swarm.startedAt < STABLE_RUN_MS) {
+            backoff = std::min(swarm.backoffMs * 2, RESTART_BACKOFF_MAX_MS);
+        }
+        return backoff + rand() % (backoff / 4 + 1);
+    }
+
+    // Читает сигналы из signalfd и забирает все завершившиеся процессы: несколько SIGCHLD
+    // могут слиться в один, поэтому waitpid вызывается, пока есть завершившиеся
+    void handleSignals() {
+        struct signalfd_siginfo info;
+        while (read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+            if (info.ssi_signo == SIGINT || info.ssi_signo == SIGTERM) {
+                std::cout << "\nСупервизор: получен сигнал завершения, останавливаем стаи..." << std::endl;
+                stopping = true;
+            }
+        }
+
+        int64_t now = nowMs();
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            auto it = processes.find(pid);
+            if (it == processes.end()) continue;
+            size_t index = it->second;
+            processes.erase(it);
+            reap(index, status, now);
+        }
+    }
+
+    void reap(size_t index, int status, int64_t now) {
+        SwarmProcess& swarm = swarms[index];
+        bool stopped = swarm.stopping;
+        bool crashed = !stopped && !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        swarm.pid = 0;
+        swarm.stopping = false;
+        statusChanged = true;
+        if (!crashed && !stopped) {
+            swarm.finished = true; // Стая закончила поиск сама
+            exits++;
+        }
+        if (stopping || (int)index >= target || swarm.finished) return;
+
+        if (crashed) {
+            int id = config.firstId + (int)index;
+            swarm.backoffMs = nextBackoff(swarm, now);
+            restarts++;
+            std::cout << COLOR_YELLOW << "Стая #" << id << " завершилась аварийно ("
+                      << (WIFSIGNALED(status) ? "сигнал " + std::to_string(WTERMSIG(status)) :
+                                                "код " + std::to_string(WEXITSTATUS(status)))
+                      << "), перезапуск через " << swarm.backoffMs << " мс" << COLOR_RESET << std::endl;
+            schedule(index, now + swarm.backoffMs);
+        } else {
+            schedule(index, now); // Остановка отменена новым увеличением числа стай
+        }
+    }
+
+    // Обрабатывает датаграммы порта управления
+    void handleCommands() {
+        char buffer[256];
+        struct sockaddr_in from;
+        socklen_t fromLen = sizeof(from);
+        int n;
+        while ((n = recvfrom(controlFd, buffer, sizeof(buffer) - 1, 0, (struct sockaddr*)&from, &fromLen)) > 0) {
+            buffer[n] = '\0';
+            while (n > 0 && (buffer[n - 1] == '\n' || buffer[n - 1] == '\r')) buffer[--n] = '\0';
+            std::string response = handleCommand(buffer);
+            sendto(controlFd, response.c_str(), response.size(), 0, (struct sockaddr*)&from, fromLen);
+            fromLen = sizeof(from);
+        }
+    }
+
+    std::string handleCommand(const std::string& command) {
+        if (command == "STATUS") {
+            return "SUPERVISOR:" + std::to_string(target) + ":" + std::to_string(processes.size()) + ":" +
+                   std::to_string(waitingCount()) + ":" + std::to_string(exits) + ":" + std::to_string(restarts);
+        }
+        if (command == "STOP") {
+            stopping = true;
+            return "OK:Супервизор останавливает стаи";
+        }
+        if (command.compare(0, 6, "SCALE:") == 0) {
+            std::string value = command.substr(6);
+            char* end = nullptr;
+            long number = strtol(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0') return "ERROR:Формат: SCALE:<N>, SCALE:+<N> или SCALE:-<N>";
+            long newTarget = (value[0] == '+' || value[0] == '-') ? target + number : number;
+            if (newTarget < 0 || newTarget > SUPERVISOR_MAX_SWARMS) {
+                return "ERROR:Число стай должно быть от 0 до " + std::to_string(SUPERVISOR_MAX_SWARMS);
+            }
+            std::cout << "Супервизор: число стай " << target << " -> " << newTarget << std::endl;
+            scaleTo((int)newTarget);
+            return "OK:Стай: " + std::to_string(target);
+        }
+        return "ERROR:Неизвестная команда. Команды: SCALE:<N>, SCALE:+<N>, SCALE:-<N>, STATUS, STOP";
+    }
+
+    // Стаи, ожидающие запуска или перезапуска; при остановке супервизора таких нет
+    size_t waitingCount() const {
+        size_t waiting = 0;
+        if (stopping) return 0;
+        for (int i = 0; i < target; i++) {
+            if (swarms[i].pid == 0 && !swarms[i].finished) waiting++;
+        }
+        return waiting;
+    }
+
+    // Отправляет SIGTERM всем стаям, ждет их завершения до STOP_TIMEOUT_MS и добивает оставшиеся SIGKILL
+    void stopAll() {
+        stopping = true;
+        for (auto& [pid, index] : processes) {
+            kill(pid, SIGTERM);
+            swarms[index].stopping = true;
+        }
+
+        int64_t deadline = nowMs() + STOP_TIMEOUT_MS;
+        struct pollfd fds;
+        fds.fd = signalFd;
+        fds.events = POLLIN;
+        while (!processes.empty()) {
+            int64_t left = deadline - nowMs();
+            if (left <= 0) break;
+            if (poll(&fds, 1, (int)left) > 0) handleSignals();
+        }
+
+        if (!processes.empty()) {
+            std::cout << COLOR_YELLOW << "Супервизор: " << processes.size() << " стай не завершились за "
+                      << STOP_TIMEOUT_MS << " мс, отправляем SIGKILL" << COLOR_RESET << std::endl;
+            for (auto& [pid, index] : processes) kill(pid, SIGKILL);
+            for (auto& [pid, index] : processes) waitpid(pid, nullptr, 0);
+            processes.clear();
+        }
+    }
+
+    // Строка состояния: при изменениях, не чаще раза в SUPERVISOR_STATUS_MS, и при завершении
+    void printStatus(bool final) {
+        int64_t now = nowMs();
+        if (!final && (!statusChanged || now - lastStatus < SUPERVISOR_STATUS_MS)) return;
+        std::cout << "Супервизор [" << (now - startedAt) / 1000.0 << " с]: стай " << target << ", работают "
+                  << processes.size() << ", ждут запуска " << waitingCount() << ", завершили поиск " << exits
+                  << ", запусков " << launches << ", перезапусков " << restarts;
+        if (spawnFailures > 0) std::cout << ", ошибок запуска " << spawnFailures;
+        std::cout << std::endl;
+        lastStatus = now;
+        statusChanged = false;
+    }
+
+    SupervisorConfig config;
+    int signalFd = -1;
+    int controlFd = -1;
+    int target = 0;
+    bool stopping = false;
+    std::vector<SwarmProcess> swarms;                 // Индекс - номер стаи минус firstId
+    std::unordered_map<pid_t, size_t> processes;      // Работающие процессы: pid -> индекс стаи
+    std::multimap<int64_t, size_t> launchQueue;       // Запланированные запуски по времени
+    int64_t startedAt = 0;
+    int64_t lastStatus = 0;
+    bool statusChanged = true;
+    unsigned long launches = 0;
+    unsigned long restarts = 0;
+    unsigned long exits = 0;
+    unsigned long spawnFailures = 0;
+};
+
 // Функция для очистки экрана
 void clearScreen() {
     // Для UNIX/Linux/MacOS
@@ -216,17 +651,51 @@ void displayMenu() {
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 3) {
-        std::cerr << COLOR_RED << "Использование: " << argv[0] << " <IP сервера> <CONTROL_PORT>" << COLOR_RESET << std::endl;
+    // Режим супервизора: ./bee_manager <IP> <CONTROL_PORT> --supervise K [параметры] [-- параметры стаи]
+    bool badArgs = argc < 3;
+    SupervisorConfig supervisor;
+    for (int i = 3; i < argc && !badArgs; i++) {
+        if (strcmp(argv[i], "--supervise") == 0 && i + 1 < argc) {
+            supervisor.target = atoi(argv[++i]);
+            badArgs = supervisor.target < 1 || supervisor.target > SUPERVISOR_MAX_SWARMS;
+        } else if (strcmp(argv[i], "--first-id") == 0 && i + 1 < argc) {
+            supervisor.firstId = atoi(argv[++i]);
+            badArgs = supervisor.firstId < 1;
+        } else if (strcmp(argv[i], "--client") == 0 && i + 1 < argc) {
+            supervisor.clientPath = argv[++i];
+        } else if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+            supervisor.listenPort = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-logs") == 0) {
+            supervisor.logs = false;
+        } else if (strcmp(argv[i], "--") == 0) {
+            supervisor.clientArgs.assign(argv + i + 1, argv + argc);
+            break;
+        } else {
+            badArgs = true;
+        }
+    }
+    if (badArgs || (argc > 3 && supervisor.target == 0)) {
+        std::cerr << COLOR_RED << "Использование: " << argv[0] << " <IP сервера> <CONTROL_PORT> [--supervise K [--first-id ID] "
+                  << "[--client PATH] [--listen PORT] [--no-logs] [-- параметры стаи]]" << COLOR_RESET << std::endl;
         return 1;
     }
     
-    // Устанавливаем обработчик сигнала для корректного завершения
-    signal(SIGINT, signalHandler);
-    
     const char* serverIP = argv[1];
     int controlPort = std::stoi(argv[2]);
     int serverPort = controlPort - 2000;  // Порт для запуска новых стай
+
+    if (supervisor.target > 0) {
+        supervisor.serverIP = serverIP;
+        supervisor.serverPort = serverPort;
+        if (supervisor.listenPort == 0) supervisor.listenPort = controlPort + SUPERVISOR_PORT_OFFSET;
+        SwarmSupervisor swarmSupervisor(supervisor);
+        return swarmSupervisor.run();
+    }
+    
+    // Устанавливаем обработчик сигнала для корректного завершения
+    signal(SIGINT, signalHandler);
+    // Запущенные из меню стаи не ждем: система сама забирает их после завершения
+    signal(SIGCHLD, SIG_IGN);
     
     // Создаем UDP сокет для связи с сервером
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -264,14 +733,10 @@ int main(int argc, char* argv[]) {
         
         switch (choice) {
             case 1: { // Показать список стай
-                std::string response = sendCommand(sockfd, "LIST_BEES", serverAddr);
-                
-                if (response.find("ERROR:") == 0) {
-                    std::cout << COLOR_RED << response.substr(6) << COLOR_RESET << std::endl;
-                } else {
-                    auto bees = parseBeesInfo(response);
-                    displayBees(bees);
-                }
+                std::cout << "Условия отбора через ':' (ACTIVE, DISCONNECTED, SECTOR=<от>-<до>, SEEN=<от>-<до> секунд; Enter - все стаи): ";
+                std::string filter;
+                std::getline(std::cin, filter);
+                browseBees(sockfd, serverAddr, filter);
                 
                 std::cout << "Нажмите Enter для продолжения...";
                 std::cin.get();
@@ -279,15 +744,9 @@ int main(int argc, char* argv[]) {
             }
             
             case 2: { // Отключить стаю
-                // Сначала получаем список стай
-                std::string response = sendCommand(sockfd, "LIST_BEES", serverAddr);
-                
-                                if (response.find("ERROR:") == 0) {
-                    std::cout << COLOR_RED << response.substr(6) << COLOR_RESET << std::endl;
-                } else {
-                    auto bees = parseBeesInfo(response);
-                    displayBees(bees);
-                }
+                // Сначала показываем активные стаи
+                browseBees(sockfd, serverAddr, "ACTIVE");
+                std::string response;
                 
                 // Запрашиваем ID стаи для отключения
                 int swarmId;
@@ -314,13 +773,14 @@ int main(int argc, char* argv[]) {
             }
             
             case 3: { // Переподключить стаю
-                // Сначала получаем список стай
-                std::string response = sendCommand(sockfd, "LIST_BEES", serverAddr);
+                // Сначала получаем первую страницу отключенных стай: отбор выполняет сервер
+                std::string cursor;
+                std::string response = requestBeesPage(sockfd, serverAddr, "", "DISCONNECTED", LIST_PAGE_SWARMS);
                 
                 if (response.find("ERROR:") == 0) {
                     std::cout << COLOR_RED << response.substr(6) << COLOR_RESET << std::endl;
                 } else {
-                    auto bees = parseBeesInfo(response);
+                    auto bees = parseBeesInfo(response, cursor);
                     
                     // Отображаем только отключенные стаи
                     std::cout << BOLD << COLOR_CYAN << "=== Отключенные стаи ===" << COLOR_RESET << std::endl;
@@ -391,23 +851,22 @@ int main(int argc, char* argv[]) {
                     break;
                 }
                 
-                // Получаем информацию о существующих стаях, чтобы не создавать дубликаты ID
-                std::string response = sendCommand(sockfd, "LIST_BEES", serverAddr);
-                std::map<int, BeeInfo> bees;
-                
-                if (response.find("ERROR:") != 0) {
-                    bees = parseBeesInfo(response);
-                }
-                
-                // Находим свободные ID для новых стай
+                // Находим свободные ID для новых стай: страницы списка идут по возрастанию номера,
+                // поэтому просмотр заканчивается, как только найдено достаточно пропусков
                 int nextId = 1;
                 std::vector<int> newIds;
-                
-                while (newIds.size() < numSwarms) {
-                    if (bees.find(nextId) == bees.end()) {
-                        newIds.push_back(nextId);
+                std::string cursor;
+                do {
+                    std::string response = requestBeesPage(sockfd, serverAddr, cursor, "", LIST_PAGE_SWARMS * 50);
+                    if (response.find("ERROR:") == 0) break;
+                    for (const auto& [id, info] : parseBeesInfo(response, cursor)) {
+                        while (nextId < id && (int)newIds.size() < numSwarms) newIds.push_back(nextId++);
+                        if (nextId == id) nextId++;
                     }
-                    nextId++;
+                } while (!cursor.empty() && (int)newIds.size() < numSwarms);
+                
+                while ((int)newIds.size() < numSwarms) {
+                    newIds.push_back(nextId++);
                 }
                 
                 std::cout << COLOR_GREEN << "Запуск " << numSwarms << " новых стай..." << COLOR_RESET << std::endl;
@@ -416,14 +875,10 @@ int main(int argc, char* argv[]) {
                 for (int swarmId : newIds) {
                     std::cout << "Запуск стаи #" << swarmId << "... ";
                     
-                    // Формируем команду для запуска стаи
-                    std::string cmd = "./bee_client_10 " + std::string(serverIP) + " " + 
-                                     std::to_string(serverPort) + " " + std::to_string(swarmId) + 
-                                     " > bee_" + std::to_string(swarmId) + ".log 2>&1 &";
-                    
-                    int result = system(cmd.c_str());
+                    // Стая запускается напрямую, без оболочки, с выводом в bee_<ID>.log
+                    pid_t pid = spawnSwarm("./bee_client_10", serverIP, serverPort, swarmId, {}, true);
                     
-                    if (result == 0) {
+                    if (pid > 0) {
                         std::cout << COLOR_GREEN << "OK" << COLOR_RESET << std::endl;
                     } else {
                         std::cout << COLOR_RED << "Ошибка" << COLOR_RESET << std::endl;
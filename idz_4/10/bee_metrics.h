@@ -0,0 +1,131 @@
+// bee_metrics.h
+#ifndef BEE_METRICS_H
+#define BEE_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+#define HISTOGRAM_SUB_BITS 4 // Каждая степень двойки делится на 16 интервалов: погрешность не больше 1/16
+#define HISTOGRAM_MAX_BITS 36 // Значения до 2^36 (69 с в наносекундах); большие попадают в последний интервал
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+#define METRIC_MESSAGE_TYPES 32 // Типы сообщений пчел, для которых ведутся гистограммы (больше любого MSG_*)
+
+// Монотонное время в наносекундах
+inline int64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Счетчик, который увеличивает только поток-владелец, а читать могут и другие потоки.
+// Увеличение - обычные чтение и запись без атомарной операции над общей строкой кэша
+struct Counter {
+    std::atomic<unsigned long> value{0};
+
+    void add(unsigned long n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    unsigned long get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// Номер интервала гистограммы для значения: значения меньше 16 хранятся точно, дальше
+// каждая степень двойки [2^k, 2^(k+1)) делится на 16 равных интервалов (как в HDR Histogram)
+inline int histogramBucket(uint64_t value) {
+    if (value < HISTOGRAM_SUB_COUNT) return (int)value;
+    int magnitude = 63 - __builtin_clzll(value);
+    if (magnitude >= HISTOGRAM_MAX_BITS) return HISTOGRAM_BUCKETS - 1;
+    int shift = magnitude - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_COUNT + (int)((value >> shift) & (HISTOGRAM_SUB_COUNT - 1));
+}
+
+// Наибольшее значение, попадающее в интервал bucket
+inline uint64_t histogramBucketLimit(int bucket) {
+    if (bucket < HISTOGRAM_SUB_COUNT) return bucket;
+    int shift = bucket / HISTOGRAM_SUB_COUNT - 1;
+    uint64_t lowest = (uint64_t)(HISTOGRAM_SUB_COUNT + bucket % HISTOGRAM_SUB_COUNT) << shift;
+    return lowest + ((uint64_t)1 << shift) - 1;
+}
+
+// Гистограмма одного потока: пишет только поток-владелец, читатели складывают
+// гистограммы всех потоков в HistogramTotals. Количество замеров - сумма интервалов,
+// поэтому оно всегда согласовано с ними, даже если поток пишет во время чтения
+struct Histogram {
+    Counter buckets[HISTOGRAM_BUCKETS];
+    Counter sum;
+
+    void record(uint64_t value) {
+        buckets[histogramBucket(value)].add(1);
+        sum.add(value);
+    }
+};
+
+// Сумма гистограмм нескольких потоков для вывода
+struct HistogramTotals {
+    unsigned long buckets[HISTOGRAM_BUCKETS] = {};
+    unsigned long count = 0;
+    unsigned long sum = 0;
+
+    void add(const Histogram& histogram) {
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            unsigned long n = histogram.buckets[i].get();
+            buckets[i] += n;
+            count += n;
+        }
+        sum += histogram.sum.get();
+    }
+
+    void add(const HistogramTotals& totals) {
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) buckets[i] += totals.buckets[i];
+        count += totals.count;
+        sum += totals.sum;
+    }
+
+    // Значение, не меньше которого доля quantile всех замеров (верхняя граница интервала)
+    uint64_t percentile(double quantile) const {
+        if (count == 0) return 0;
+        unsigned long rank = (unsigned long)(quantile * count);
+        if (rank < 1) rank = 1;
+        if (rank > count) rank = count;
+        unsigned long seen = 0;
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank) return histogramBucketLimit(i);
+        }
+        return histogramBucketLimit(HISTOGRAM_BUCKETS - 1);
+    }
+
+    // Количество замеров, не превышающих limit. Подсчет точный, если limit - граница интервала:
+    // значение меньше 16 или степень двойки без единицы
+    unsigned long countUpTo(uint64_t limit) const {
+        unsigned long total = 0;
+        for (int i = 0; i < HISTOGRAM_BUCKETS && histogramBucketLimit(i) <= limit; i++) total += buckets[i];
+        return total;
+    }
+};
+
+// Метрики рабочего потока. Каждый поток пишет только в свои метрики, поэтому на пути
+// обработки сообщений нет общих атомарных переменных; главный поток складывает их при запросе
+struct WorkerMetrics {
+    Histogram handling[METRIC_MESSAGE_TYPES]; // Время обработки сообщения пчелы по типам (нс)
+    Counter malformed; // Датаграммы пчел, которые не удалось разобрать
+    Counter lockAcquired; // Захваты мьютексов шардов
+    Histogram lockWait; // Ожидание занятого мьютекса шарда (нс); свободный мьютекс не замеряется
+    Histogram recvBatch; // Датаграммы, вычитанные одним вызовом recvmmsg
+    Histogram sendBatch; // Ответы, накопленные к вызову sendmmsg (глубина очереди ответов)
+    Histogram epollEvents; // События за одно пробуждение epoll_wait
+};
+
+// Замер времени обработки: записывается в гистограмму при выходе из области видимости
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& target) : histogram(target), start(monotonicNs()) {}
+    ~ScopedTimer() { histogram.record(monotonicNs() - start); }
+
+private:
+    Histogram& histogram;
+    int64_t start;
+};
+
+#endif // BEE_METRICS_H
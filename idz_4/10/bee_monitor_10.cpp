@@ -7,6 +7,7 @@
 #include <unistd.h>
 #include <vector>
 #include <map>
+#include <set>
 #include <string>
 #include <sstream>
 #include <thread>
@@ -15,17 +16,29 @@
 #include <mutex>
 #include <condition_variable>
 #include <cmath>
+#include <poll.h>
+#include <termios.h>
+#include <unordered_map>
+#include <algorithm>
+#include <ctime>
+#include "bee_screen.h"
 
-// ANSI-коды цветов для терминала
-#define COLOR_RESET   "\033[0m"
-#define COLOR_RED     "\033[31m"
-#define COLOR_GREEN   "\033[32m"
-#define COLOR_YELLOW  "\033[33m"
-#define COLOR_BLUE    "\033[34m"
-#define COLOR_MAGENTA "\033[35m"
-#define COLOR_CYAN    "\033[36m"
-#define COLOR_WHITE   "\033[37m"
-#define BOLD          "\033[1m"
+// ANSI-коды цветов для атрибутов клеток экрана (bee_screen.h)
+#define COLOR_RED     31
+#define COLOR_GREEN   32
+#define COLOR_YELLOW  33
+#define COLOR_BLUE    34
+#define COLOR_CYAN    36
+
+#define RECV_BUFFER_SIZE 2048 // Размер буфера для датаграммы снимка или события
+#define KEEPALIVE_INTERVAL 3 // Интервал отправки сигнала активности серверу (сек)
+#define RESYNC_TIMEOUT 3 // Время ожидания полного снимка перед повторным запросом (сек)
+#define REDRAW_INTERVAL_MS 500 // Минимальный интервал между перерисовками экрана (мс)
+#define DETAIL_CELL_WIDTH 4 // Ширина клетки сектора при масштабе 1:1 (номер стаи или сектора)
+#define HEAT_CELL_WIDTH 2 // Ширина клетки тепловой карты: две позиции дают почти квадратную клетку
+#define HEADER_ROWS 3 // Строки над картой: заголовок, сводка и пустая строка
+#define LISTED_SWARM_ROWS 2 // Строки со списком активных стай под картой
+#define FOOTER_ROWS (5 + LISTED_SWARM_ROWS) // Строки под картой: легенда, стаи, статус, время, клавиши
 
 // Структуры данных для мониторинга
 struct Sector {
@@ -55,8 +68,20 @@ bool allSectorsSearched = false;
 int winnieSector = -1;
 int totalSectors = 0;
 
+// Сводка, которую события обновляют по месту, чтобы кадр не пересчитывал ее по всему лесу
+std::unordered_map<int, int> swarmAtSector; // Сектор -> стая, которая в нем сейчас ищет
+int searchedSectors = 0;
+std::set<int> activeSwarmIds; // Номера активных стай по возрастанию - для списка под картой
+int disconnectedSwarms = 0;
+int winnieFoundSector = -1;
+
+bool screenActive = false;   // Кадры выводятся в альтернативный экран терминала
+bool keyboardActive = false; // Клавиши читаются из терминала без буферизации строк
+bool serverShutdown = false;
+
 // Обработчик сигналов
 void signalHandler(int signum) {
+    // SIGWINCH только прерывает poll, чтобы кадр сразу подстроился под новый размер терминала
     if (signum == SIGINT || signum == SIGTERM) {
         std::cout << "\nМонитор #" << monitorId << ": Получен сигнал завершения. Отключаемся от сервера..." << std::endl;
         running = false;
@@ -64,250 +89,594 @@ void signalHandler(int signum) {
     }
 }
 
-// Функция для очистки экрана
-void clearScreen() {
-    // Для UNIX/Linux/MacOS
-    #if defined(__unix__) || defined(__unix) || defined(__APPLE__)
-        system("clear");
-    // Для Windows
-    #elif defined(_WIN32) || defined(_WIN64)
-        system("cls");
-    #endif
+// Пирамида счетчиков для тепловой карты. Лес - сетка шириной ceil(sqrt(N)), как в bee_assignment.h.
+// Уровень k делит сетку на блоки 2^k x 2^k секторов и хранит для каждого блока число исследованных
+// секторов и активных стай; уровень 0 - сами секторы (sectors). Событие меняет по одному счетчику
+// на уровень, а кадр читает готовые счетчики видимых блоков, поэтому стоимость кадра не зависит
+// от размера леса
+class ForestHeatMap {
+public:
+    void reset(int sectorCount) {
+        count = sectorCount;
+        width = std::max(1, (int)std::ceil(std::sqrt((double)sectorCount)));
+        height = std::max(1, (sectorCount + width - 1) / width);
+        levels.assign(1, Level());
+        for (int k = 1; (1 << (k - 1)) < std::max(width, height); k++) {
+            Level level;
+            level.width = (width + (1 << k) - 1) >> k;
+            level.height = (height + (1 << k) - 1) >> k;
+            level.searched.assign((size_t)level.width * level.height, 0);
+            level.swarms.assign((size_t)level.width * level.height, 0);
+            levels.push_back(std::move(level));
+        }
+    }
+
+    int levelCount() const { return levels.size(); }
+    int gridWidth() const { return width; }
+    int gridHeight() const { return height; }
+    int x(int sectorId) const { return sectorId % width; }
+    int y(int sectorId) const { return sectorId / width; }
+
+    // Ширина и высота сетки в блоках уровня k
+    int blocksX(int k) const { return (width + (1 << k) - 1) >> k; }
+    int blocksY(int k) const { return (height + (1 << k) - 1) >> k; }
+
+    void addSearched(int sectorId) {
+        for (int k = 1; k < levelCount(); k++) levels[k].searched[index(k, sectorId)]++;
+    }
+
+    void addSwarm(int sectorId, int delta) {
+        for (int k = 1; k < levelCount(); k++) levels[k].swarms[index(k, sectorId)] += delta;
+    }
+
+    uint32_t searched(int k, int bx, int by) const { return levels[k].searched[(size_t)by * levels[k].width + bx]; }
+    uint32_t swarms(int k, int bx, int by) const { return levels[k].swarms[(size_t)by * levels[k].width + bx]; }
+
+    // Количество секторов леса в блоке: блоки у правого и нижнего края сетки неполные,
+    // а последняя строка сетки заполнена только до N
+    uint32_t sectorsIn(int k, int bx, int by) const {
+        int x0 = bx << k, x1 = std::min(width, (bx + 1) << k);
+        int y0 = by << k, y1 = std::min(height, (by + 1) << k);
+        if (x0 >= x1 || y0 >= y1) return 0;
+        int lastRow = height - 1;
+        int lastRowLength = count - lastRow * width;
+        uint32_t total = (uint32_t)(x1 - x0) * (std::min(y1, lastRow) - std::min(y0, lastRow));
+        if (y0 <= lastRow && lastRow < y1) total += std::max(0, std::min(x1, lastRowLength) - x0);
+        return total;
+    }
+
+private:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        std::vector<uint32_t> searched; // Исследованные секторы блока
+        std::vector<uint32_t> swarms;   // Активные стаи в секторах блока
+    };
+
+    size_t index(int k, int sectorId) const {
+        return (size_t)(y(sectorId) >> k) * levels[k].width + (x(sectorId) >> k);
+    }
+
+    int count = 0;
+    int width = 1;
+    int height = 1;
+    std::vector<Level> levels;
+};
+
+// Видимая часть леса: масштаб (блок 2^zoom x 2^zoom секторов на клетку) и левый верхний блок
+struct ForestView {
+    int zoom = 0;
+    int originX = 0; // В блоках текущего масштаба
+    int originY = 0;
+    int mapCols = 1; // Блоков на экране в последнем кадре
+    int mapRows = 1;
+    bool fitted = true; // Масштаб подбирается так, чтобы весь лес помещался на экране
+};
+
+ForestHeatMap heatMap;
+ForestView view;
+ScreenBuffer screen;
+
+// Ширина клетки карты в позициях терминала
+int cellWidth(int zoom) {
+    return zoom == 0 ? DETAIL_CELL_WIDTH : HEAT_CELL_WIDTH;
 }
 
-// Функция для отображения карты леса и положения стай
-void displayForest() {
-    clearScreen();
-    
-    std::cout << BOLD << COLOR_CYAN << "=== Монитор #" << monitorId << " поиска Винни-Пуха ===" << COLOR_RESET << std::endl;
-    std::cout << "Лес разделен на " << totalSectors << " секторов" << std::endl;
-    
-    // Рассчитываем размеры сетки для визуализации леса
-    int gridSize = std::ceil(std::sqrt(totalSectors));
-    
-    // Отображаем состояние секторов в виде сетки
-    std::cout << "\n┌";
-    for (int i = 0; i < gridSize; i++) {
-        std::cout << "───";
-        if (i < gridSize - 1) std::cout << "┬";
+// Наименьший масштаб, при котором весь лес помещается в область карты
+int fitZoom(int cols, int mapRows) {
+    for (int zoom = 0; zoom < heatMap.levelCount(); zoom++) {
+        if (heatMap.blocksX(zoom) <= cols / cellWidth(zoom) && heatMap.blocksY(zoom) <= mapRows) return zoom;
     }
-    std::cout << "┐\n";
-    
-    for (int row = 0; row < gridSize; row++) {
-        std::cout << "│";
-        for (int col = 0; col < gridSize; col++) {
-            int sectorId = row * gridSize + col;
-            if (sectorId < totalSectors) {
-                // Ищем сектор в списке
-                bool found = false;
-                bool searched = false;
-                bool winnieFound = false;
-                
-                for (const auto& sector : sectors) {
-                    if (sector.id == sectorId) {
-                        found = true;
-                        searched = sector.searched;
-                        winnieFound = sector.winnieFound;
-                        break;
-                    }
-                }
-                
-                // Проверяем, находится ли какая-то стая в этом секторе
-                std::string beeInfo = "";
-                for (const auto& [id, swarm] : beeSwarms) {
-                    if (swarm.currentSector == sectorId && swarm.active) {
-                        beeInfo = std::to_string(swarm.id);
-                        break;
-                    }
-                }
-                
-                if (found) {
-                    if (winnieFound && searched) {
-                        // Винни-Пух найден
-                        std::cout << COLOR_RED << " W ";
-                    } else if (searched) {
-                        // Сектор проверен, но Винни-Пух не найден
-                        std::cout << COLOR_YELLOW << " · ";
-                    } else if (!beeInfo.empty()) {
-                        // В секторе находится стая
-                        std::cout << COLOR_GREEN << " " << beeInfo << " ";
-                    } else {
-                        // Сектор не проверен
-                        std::cout << COLOR_BLUE << " " << sectorId << " ";
-                    }
-                } else {
-                    // Информация о секторе отсутствует
-                    std::cout << COLOR_WHITE << " ? ";
-                }
-                std::cout << COLOR_RESET;
-            } else {
-                std::cout << "   ";
-            }
-            if (col < gridSize - 1) std::cout << "│";
+    return heatMap.levelCount() - 1;
+}
+
+// Меняет масштаб, сохраняя сектор в центре экрана
+void setZoom(int zoom) {
+    zoom = std::max(0, std::min(zoom, heatMap.levelCount() - 1));
+    int centerX = ((view.originX + view.mapCols / 2) << view.zoom);
+    int centerY = ((view.originY + view.mapRows / 2) << view.zoom);
+    int mapCols = std::max(1, screen.cols() / cellWidth(zoom));
+    view.originX = (centerX >> zoom) - mapCols / 2;
+    view.originY = (centerY >> zoom) - view.mapRows / 2;
+    view.zoom = zoom;
+    view.fitted = false;
+}
+
+// Обрабатывает нажатые клавиши. Возвращает true, если вид изменился
+bool handleKeys(const char* keys, int length) {
+    bool changed = false;
+    for (int i = 0; i < length; i++) {
+        char key = keys[i];
+        // Стрелки приходят последовательностями ESC [ A..D
+        if (key == '\033' && i + 2 < length && keys[i + 1] == '[') {
+            key = "kjlh"[std::max(0, std::min(3, keys[i + 2] - 'A'))];
+            i += 2;
         }
-        std::cout << "│\n";
-        
-        if (row < gridSize - 1) {
-            std::cout << "├";
-            for (int i = 0; i < gridSize; i++) {
-                std::cout << "───";
-                if (i < gridSize - 1) std::cout << "┼";
-            }
-            std::cout << "┤\n";
+        int stepX = std::max(1, view.mapCols / 2), stepY = std::max(1, view.mapRows / 2);
+        switch (key) {
+            case '+': case '=': setZoom(view.zoom - 1); break;
+            case '-': case '_': setZoom(view.zoom + 1); break;
+            case 'h': view.originX -= stepX; view.fitted = false; break;
+            case 'l': view.originX += stepX; view.fitted = false; break;
+            case 'k': view.originY -= stepY; view.fitted = false; break;
+            case 'j': view.originY += stepY; view.fitted = false; break;
+            case '0': view.fitted = true; break;
+            case 'q': case 'Q': running = false; cv.notify_all(); break;
+            default: continue;
         }
+        changed = true;
     }
-    
-    std::cout << "└";
-    for (int i = 0; i < gridSize; i++) {
-        std::cout << "───";
-        if (i < gridSize - 1) std::cout << "┴";
+    return changed;
+}
+
+// Клетка карты при масштабе 1:1: номер стаи в секторе, отметка исследования или номер сектора
+void drawSector(int column, int row, int sectorId) {
+    const Sector& sector = sectors[sectorId];
+    std::string text;
+    uint8_t attr;
+    if (sector.searched && sector.winnieFound) {
+        text = "W";
+        attr = COLOR_RED | SCREEN_BOLD;
+    } else if (sector.searched) {
+        text = "·";
+        attr = COLOR_YELLOW;
+    } else if (swarmAtSector.count(sectorId)) {
+        text = std::to_string(swarmAtSector[sectorId] % 1000);
+        attr = COLOR_GREEN | SCREEN_BOLD;
+    } else if (sectorId < 1000) {
+        text = std::to_string(sectorId);
+        attr = COLOR_BLUE;
+    } else {
+        text = "∙";
+        attr = COLOR_BLUE;
     }
-    std::cout << "┘\n";
-    
-    // Отображаем легенду
-    std::cout << "\nЛегенда:";
-    std::cout << COLOR_RED << " W " << COLOR_RESET << "- Винни-Пух найден, ";
-    std::cout << COLOR_YELLOW << " · " << COLOR_RESET << "- Проверенный сектор, ";
-    std::cout << COLOR_GREEN << " N " << COLOR_RESET << "- Стая №N, ";
-    std::cout << COLOR_BLUE << " N " << COLOR_RESET << "- ID сектора\n";
-    
-    // Отображаем статус стай
-    std::cout << "\n" << BOLD << COLOR_CYAN << "Активные стаи пчел:" << COLOR_RESET << std::endl;
-    bool anyActive = false;
-    
-    for (const auto& [id, swarm] : beeSwarms) {
-        if (swarm.active) {
-            anyActive = true;
-            std::string status = swarm.currentSector >= 0 ? 
-                                 "исследует сектор " + std::to_string(swarm.currentSector) : 
-                                 "в улье";
-            std::cout << "Стая #" << id << " - " << status << std::endl;
-        }
+    // Выравнивание по правому краю клетки; последняя позиция - промежуток между клетками
+    screen.text(column + DETAIL_CELL_WIDTH - 1 - ScreenBuffer::textWidth(text), row, text, attr);
+}
+
+// Клетка тепловой карты: доля исследованных секторов блока (░▒▓█), стаи в блоке - зеленым,
+// блок с найденным Винни-Пухом - красным
+void drawBlock(int column, int row, int bx, int by) {
+    uint32_t total = heatMap.sectorsIn(view.zoom, bx, by);
+    if (total == 0) return;
+    uint32_t searched = heatMap.searched(view.zoom, bx, by);
+    static const char32_t shades[] = {U'░', U'▒', U'▓', U'█'};
+    char32_t glyph = searched == 0 ? U'·' : shades[std::min<uint32_t>(3, (searched * 4 - 1) / total)];
+    uint8_t attr = searched == 0 ? COLOR_BLUE : COLOR_YELLOW;
+    if (heatMap.swarms(view.zoom, bx, by) > 0) attr = COLOR_GREEN | SCREEN_BOLD;
+
+    bool winnieHere = winnieFoundSector >= 0 && (heatMap.x(winnieFoundSector) >> view.zoom) == bx &&
+                      (heatMap.y(winnieFoundSector) >> view.zoom) == by;
+    if (winnieHere) {
+        screen.put(column, row, U'W', COLOR_RED | SCREEN_BOLD);
+        screen.put(column + 1, row, glyph, COLOR_RED | SCREEN_BOLD);
+    } else {
+        screen.put(column, row, glyph, attr);
+        screen.put(column + 1, row, glyph, attr);
     }
-    
-    if (!anyActive) {
-        std::cout << COLOR_YELLOW << "Нет активных стай" << COLOR_RESET << std::endl;
+}
+
+// Рисует кадр в задний буфер экрана и выводит только изменившиеся клетки.
+// Рисуются только видимые клетки карты, поэтому кадр стоит одинаково для леса любого размера
+void displayForest() {
+    int cols, rows;
+    ScreenBuffer::terminalSize(cols, rows);
+    screen.resize(cols, rows);
+    screen.clear();
+
+    int mapRows = std::max(1, rows - HEADER_ROWS - FOOTER_ROWS);
+    if (view.fitted) {
+        view.zoom = fitZoom(cols, mapRows);
+        view.originX = view.originY = 0;
     }
-    
-    // Отображаем отключенные стаи
-    bool anyDisconnected = false;
-    for (const auto& [id, swarm] : beeSwarms) {
-        if (swarm.disconnected) {
-            if (!anyDisconnected) {
-                std::cout << "\n" << COLOR_RED << "Отключенные стаи:" << COLOR_RESET << std::endl;
-                anyDisconnected = true;
+    view.mapCols = std::max(1, cols / cellWidth(view.zoom));
+    view.mapRows = mapRows;
+    view.originX = std::max(0, std::min(view.originX, heatMap.blocksX(view.zoom) - view.mapCols));
+    view.originY = std::max(0, std::min(view.originY, heatMap.blocksY(view.zoom) - view.mapRows));
+
+    // Заголовок
+    screen.text(0, 0, "=== Монитор #" + std::to_string(monitorId) + " поиска Винни-Пуха ===", COLOR_CYAN | SCREEN_BOLD);
+    std::string scale = view.zoom == 0 ? "сектор" :
+                        std::to_string(1 << view.zoom) + "x" + std::to_string(1 << view.zoom) + " секторов";
+    int percent = totalSectors > 0 ? (int)(100.0 * searchedSectors / totalSectors) : 0;
+    screen.text(0, 1, "Лес: " + std::to_string(totalSectors) + " секторов (" + std::to_string(heatMap.gridWidth()) + "x" +
+                std::to_string(heatMap.gridHeight()) + "), проверено " + std::to_string(searchedSectors) + " (" +
+                std::to_string(percent) + "%), клетка: " + scale, 0);
+
+    // Карта
+    int shownCols = std::min(view.mapCols, heatMap.blocksX(view.zoom) - view.originX);
+    int shownRows = std::min(view.mapRows, heatMap.blocksY(view.zoom) - view.originY);
+    for (int row = 0; row < shownRows; row++) {
+        for (int col = 0; col < shownCols; col++) {
+            int bx = view.originX + col, by = view.originY + row;
+            if (view.zoom == 0) {
+                int sectorId = by * heatMap.gridWidth() + bx;
+                if (sectorId < totalSectors) drawSector(col * DETAIL_CELL_WIDTH, HEADER_ROWS + row, sectorId);
+            } else {
+                drawBlock(col * HEAT_CELL_WIDTH, HEADER_ROWS + row, bx, by);
             }
-            std::cout << "Стая #" << id << std::endl;
         }
     }
-    
-    // Отображаем общий статус
-    std::cout << "\n" << BOLD << COLOR_CYAN << "Статус поиска:" << COLOR_RESET << " ";
+
+    // Легенда и состояние под картой
+    int line = rows - FOOTER_ROWS;
+    int x = screen.text(0, line, "Легенда: ", 0);
+    if (view.zoom == 0) {
+        x = screen.text(x, line, "W", COLOR_RED | SCREEN_BOLD);
+        x = screen.text(x, line, " Винни-Пух, ", 0);
+        x = screen.text(x, line, "·", COLOR_YELLOW);
+        x = screen.text(x, line, " проверен, ", 0);
+        x = screen.text(x, line, "N", COLOR_GREEN | SCREEN_BOLD);
+        x = screen.text(x, line, " стая №N, ", 0);
+        x = screen.text(x, line, "N", COLOR_BLUE);
+        screen.text(x, line, " номер сектора", 0);
+    } else {
+        x = screen.text(x, line, "·", COLOR_BLUE);
+        x = screen.text(x, line, " не начат, ", 0);
+        x = screen.text(x, line, "░▒▓█", COLOR_YELLOW);
+        x = screen.text(x, line, " доля проверенных, ", 0);
+        x = screen.text(x, line, "█", COLOR_GREEN | SCREEN_BOLD);
+        x = screen.text(x, line, " есть стаи, ", 0);
+        x = screen.text(x, line, "W", COLOR_RED | SCREEN_BOLD);
+        screen.text(x, line, " Винни-Пух", 0);
+    }
+
+    line++;
+    screen.text(0, line++, "Стаи: активных " + std::to_string(activeSwarmIds.size()) + ", отключенных " +
+                std::to_string(disconnectedSwarms) + ", всего " + std::to_string(beeSwarms.size()), COLOR_CYAN | SCREEN_BOLD);
+
+    // Активные стаи - сколько помещается в LISTED_SWARM_ROWS строк
+    int listed = 0;
+    x = 0;
+    int listEnd = line + LISTED_SWARM_ROWS;
+    for (auto it = activeSwarmIds.begin(); it != activeSwarmIds.end() && line < listEnd; ++it) {
+        const BeeSwarm& swarm = beeSwarms[*it];
+        std::string item = "#" + std::to_string(swarm.id) + (swarm.currentSector >= 0 ?
+                           " - сектор " + std::to_string(swarm.currentSector) : std::string(" - в улье")) + "  ";
+        // В последней строке остается место для "и еще N"
+        int length = ScreenBuffer::textWidth(item);
+        if (x + length > cols - (line + 1 == listEnd ? 16 : 0)) {
+            if (line + 1 == listEnd) break;
+            line++;
+            x = 0;
+        }
+        x = screen.text(x, line, item, 0);
+        listed++;
+    }
+    int activeCount = (int)activeSwarmIds.size();
+    if (listed < activeCount) screen.text(x, line, "и еще " + std::to_string(activeCount - listed), COLOR_YELLOW);
+    line = listEnd;
+
     if (winnieFoundByBees) {
-        std::cout << COLOR_GREEN << "Винни-Пух найден и наказан!" << COLOR_RESET << std::endl;
+        screen.text(screen.text(0, line, "Статус поиска: ", COLOR_CYAN | SCREEN_BOLD), line, "Винни-Пух найден и наказан!", COLOR_GREEN);
     } else if (allSectorsSearched) {
-        std::cout << COLOR_YELLOW << "Все секторы проверены, но Винни-Пух не найден." << COLOR_RESET << std::endl;
+        screen.text(screen.text(0, line, "Статус поиска: ", COLOR_CYAN | SCREEN_BOLD), line, "Все секторы проверены, но Винни-Пух не найден.", COLOR_YELLOW);
     } else {
-        std::cout << COLOR_BLUE << "Поиск продолжается..." << COLOR_RESET << std::endl;
+        screen.text(screen.text(0, line, "Статус поиска: ", COLOR_CYAN | SCREEN_BOLD), line, "Поиск продолжается...", COLOR_BLUE);
     }
-    
+    line++;
+
     // Показываем время обновления
-    auto now = std::chrono::system_clock::now();
-    std::time_t now_time = std::chrono::system_clock::to_time_t(now);
-    std::cout << "\nОбновлено: " << std::ctime(&now_time);
-    std::cout << "Нажмите Ctrl+C для выхода\n";
+    std::time_t now = std::time(nullptr);
+    char updated[32];
+    strftime(updated, sizeof(updated), "Обновлено: %H:%M:%S", std::localtime(&now));
+    screen.text(0, line++, updated, 0);
+    screen.text(0, line, "Клавиши: + и - масштаб, стрелки или hjkl - сдвиг, 0 - весь лес, q - выход", 0);
+
+    std::string out;
+    screen.flush(out);
+    for (size_t written = 0; written < out.size(); ) {
+        ssize_t n = write(STDOUT_FILENO, out.data() + written, out.size() - written);
+        if (n < 0 && errno != EINTR) break;
+        if (n > 0) written += n;
+    }
 }
 
-// Функция для парсинга статуса из ответа сервера
-void parseStatusResponse(const std::string& response) {
-    if (response.substr(0, 7) != "STATUS:") {
-        return;
+// Учитывает стаю в счетчиках (delta = 1) или убирает ее оттуда (delta = -1) перед изменением
+void countSwarm(const BeeSwarm& swarm, int delta) {
+    if (swarm.disconnected) disconnectedSwarms += delta;
+    if (!swarm.active) return;
+    if (delta > 0) {
+        activeSwarmIds.insert(swarm.id);
+    } else {
+        activeSwarmIds.erase(swarm.id);
     }
-    
-    std::string data = response.substr(7);
-    std::istringstream ss(data);
-    std::string token;
-    
-    // Очищаем текущие данные
-    sectors.clear();
+    if (swarm.currentSector < 0 || swarm.currentSector >= totalSectors) return;
+    heatMap.addSwarm(swarm.currentSector, delta);
+    if (delta > 0) {
+        swarmAtSector[swarm.currentSector] = swarm.id;
+    } else {
+        auto it = swarmAtSector.find(swarm.currentSector);
+        if (it != swarmAtSector.end() && it->second == swarm.id) swarmAtSector.erase(it);
+    }
+}
+
+// Применяет одну запись состояния из снимка или события:
+// S:<сектор>:<Винни-Пух> - сектор исследован, B:<стая>:<сектор>:<активна>:<отключена> - состояние стаи,
+// G:<Винни-Пух найден>:<все секторы исследованы> - общий статус
+void applyRecord(const char* record) {
+    int a, b, c, d;
+    if (sscanf(record, "S:%d:%d", &a, &b) == 2) {
+        if (a >= 0 && a < (int)sectors.size()) {
+            if (!sectors[a].searched) {
+                searchedSectors++;
+                heatMap.addSearched(a);
+            }
+            sectors[a].searched = true;
+            sectors[a].winnieFound = (b == 1);
+            if (b == 1) winnieFoundSector = a;
+        }
+    } else if (sscanf(record, "B:%d:%d:%d:%d", &a, &b, &c, &d) == 4) {
+        BeeSwarm& swarm = beeSwarms[a];
+        countSwarm(swarm, -1);
+        swarm.id = a;
+        swarm.currentSector = b;
+        swarm.active = (c == 1);
+        swarm.disconnected = (d == 1);
+        countSwarm(swarm, 1);
+    } else if (sscanf(record, "G:%d:%d", &a, &b) == 2) {
+        winnieFoundByBees = (a == 1);
+        allSectorsSearched = (b == 1);
+    }
+}
+
+// Применяет все записи части снимка, разделенные ';'
+void applySnapshotChunk(char* payload) {
+    char* saveptr = nullptr;
+    for (char* record = strtok_r(payload, ";", &saveptr); record != nullptr;
+         record = strtok_r(nullptr, ";", &saveptr)) {
+        applyRecord(record);
+    }
+}
+
+// Сбрасывает состояние перед применением нового снимка
+void resetState() {
+    sectors.assign(totalSectors, Sector());
+    for (int i = 0; i < totalSectors; i++) sectors[i].id = i;
     beeSwarms.clear();
-    
-    // Парсинг секторов
-    while (std::getline(ss, token, ':')) {
-        // Проверяем маркер "BEES:" - конец секции секторов
-        if (token == "BEES") break;
-        
-        Sector sector;
-        sector.id = std::stoi(token);
-        
-        if (std::getline(ss, token, ':')) sector.searched = (token == "1");
-        if (std::getline(ss, token, ':')) sector.winnieFound = (token == "1");
-        
-        sectors.push_back(sector);
+    swarmAtSector.clear();
+    heatMap.reset(totalSectors);
+    searchedSectors = 0;
+    activeSwarmIds.clear();
+    disconnectedSwarms = 0;
+    winnieFoundSector = -1;
+    winnieFoundByBees = false;
+    allSectorsSearched = false;
+}
+
+// Состояние подписки на поток событий
+struct Subscription {
+    bool synced = false;            // Снимок получен полностью, события применяются по порядку
+    uint32_t lastSeq = 0;           // Номер последнего примененного события
+    uint32_t snapshotSeq = 0;       // Номер собираемого снимка
+    std::vector<bool> chunks;       // Полученные части снимка
+    size_t chunksReceived = 0;
+    std::map<uint32_t, std::string> pending; // События, пришедшие во время сборки снимка
+    std::chrono::steady_clock::time_point requestedAt;
+};
+
+// Запрашивает снимок состояния: при первой подписке и после обнаружения пропуска событий
+void requestSnapshot(int sockfd, const struct sockaddr_in& serverAddr, Subscription& sub) {
+    sub.synced = false;
+    sub.chunks.clear();
+    sub.chunksReceived = 0;
+    sub.pending.clear();
+    sub.requestedAt = std::chrono::steady_clock::now();
+    const char* request = "SUBSCRIBE";
+    sendto(sockfd, request, strlen(request), 0, (struct sockaddr*)&serverAddr, sizeof(serverAddr));
+}
+
+// Обрабатывает датаграмму от сервера. Возвращает true, если состояние изменилось
+bool handleServerMessage(char* buffer, int sockfd, const struct sockaddr_in& serverAddr, Subscription& sub) {
+    unsigned seq, index, count;
+    int offset = 0;
+
+    if (sscanf(buffer, "SNAPSHOT:%u:%u:%u:%n", &seq, &index, &count, &offset) == 3 && offset > 0) {
+        if (sub.synced) return false; // Снимок не запрашивался
+        if (sub.chunks.empty() || seq != sub.snapshotSeq) {
+            // Начало нового снимка
+            resetState();
+            sub.snapshotSeq = seq;
+            sub.chunks.assign(count, false);
+            sub.chunksReceived = 0;
+        }
+        if (index >= sub.chunks.size() || sub.chunks[index]) return false;
+
+        applySnapshotChunk(buffer + offset);
+        sub.chunks[index] = true;
+        if (++sub.chunksReceived < sub.chunks.size()) return false;
+
+        // Снимок собран: применяем события, пришедшие во время сборки
+        sub.synced = true;
+        sub.lastSeq = sub.snapshotSeq;
+        for (const auto& [eventSeq, record] : sub.pending) {
+            if (eventSeq <= sub.lastSeq) continue;
+            if (eventSeq != sub.lastSeq + 1) {
+                requestSnapshot(sockfd, serverAddr, sub);
+                return true;
+            }
+            applyRecord(record.c_str());
+            sub.lastSeq = eventSeq;
+        }
+        sub.pending.clear();
+        return true;
     }
-    
-    // Парсинг стай
-    while (std::getline(ss, token, ':')) {
-        // Проверяем маркер "GAME:" - конец секции стай
-        if (token == "GAME") break;
-        
-        int swarmId = std::stoi(token);
-        BeeSwarm swarm;
-        swarm.id = swarmId;
-        
-        if (std::getline(ss, token, ':')) swarm.currentSector = std::stoi(token);
-        if (std::getline(ss, token, ':')) swarm.active = (token == "1");
-        if (std::getline(ss, token, ':')) swarm.disconnected = (token == "1");
-        
-        beeSwarms[swarmId] = swarm;
+
+    if (sscanf(buffer, "EVENT:%u:%n", &seq, &offset) == 1 && offset > 0) {
+        if (!sub.synced) {
+            sub.pending[seq] = buffer + offset;
+            return false;
+        }
+        if (seq <= sub.lastSeq) return false; // Повтор
+        if (seq != sub.lastSeq + 1) {
+            // Пропущено событие - состояние больше не согласовано с сервером
+            requestSnapshot(sockfd, serverAddr, sub);
+            return false;
+        }
+        applyRecord(buffer + offset);
+        sub.lastSeq = seq;
+        return true;
     }
-    
-    // Парсинг общего статуса
-    if (std::getline(ss, token, ':')) winnieFoundByBees = (token == "1");
-    if (std::getline(ss, token, ':')) allSectorsSearched = (token == "1");
+
+    if (sscanf(buffer, "SEQ:%u", &seq) == 1) {
+        // Сервер опубликовал события, которые до нас не дошли
+        if (sub.synced && seq > sub.lastSeq) {
+            requestSnapshot(sockfd, serverAddr, sub);
+        }
+        return false;
+    }
+
+    return false;
+}
+
+// Присоединяется к многоадресной группе событий сервера (как в dz_10/multicast_client.cpp)
+int joinMulticastGroup(const std::string& group, int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("Ошибка создания сокета для многоадресной группы");
+        return -1;
+    }
+
+    // Несколько мониторов на одной машине слушают один и тот же порт группы
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in localAddr;
+    memset(&localAddr, 0, sizeof(localAddr));
+    localAddr.sin_family = AF_INET;
+    localAddr.sin_port = htons(port);
+    localAddr.sin_addr.s_addr = inet_addr(group.c_str());
+    if (bind(fd, (struct sockaddr*)&localAddr, sizeof(localAddr)) < 0) {
+        perror("Ошибка привязки сокета многоадресной группы");
+        close(fd);
+        return -1;
+    }
+
+    struct ip_mreq multicastRequest;
+    multicastRequest.imr_multiaddr.s_addr = inet_addr(group.c_str());
+    multicastRequest.imr_interface.s_addr = INADDR_ANY;
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &multicastRequest, sizeof(multicastRequest)) < 0) {
+        perror("Ошибка присоединения к многоадресной группе");
+        close(fd);
+        return -1;
+    }
+    return fd;
 }
 
-// Функция для периодического обновления данных от сервера
-void statusUpdateThread(int sockfd, struct sockaddr_in serverAddr) {
+// Функция для получения потока событий от сервера: ответы приходят на sockfd,
+// события - на sockfd или, при многоадресной рассылке, на multicastFd
+void statusUpdateThread(int sockfd, int multicastFd, struct sockaddr_in serverAddr) {
+    struct pollfd fds[3];
+    fds[0].fd = sockfd;
+    fds[0].events = POLLIN;
+    fds[1].fd = multicastFd;
+    fds[1].events = POLLIN;
+    int fdCount = multicastFd >= 0 ? 2 : 1;
+    // Клавиши управления картой, если монитор запущен в терминале
+    int keysIndex = -1;
+    if (keyboardActive) {
+        keysIndex = fdCount++;
+        fds[keysIndex].fd = STDIN_FILENO;
+        fds[keysIndex].events = POLLIN;
+    }
+
+    Subscription sub;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        requestSnapshot(sockfd, serverAddr, sub);
+    }
+
+    auto lastKeepalive = std::chrono::steady_clock::now();
+    auto lastRedraw = std::chrono::steady_clock::time_point();
+    bool dirty = true;
+
     while (running) {
-        // Отправляем запрос статуса
-        const char* request = "STATUS";
-        sendto(sockfd, request, strlen(request), 0, 
-              (struct sockaddr*)&serverAddr, sizeof(serverAddr));
-        
-        // Получаем ответ от сервера
-        char buffer[4096] = {0};
-        socklen_t addrLen = sizeof(serverAddr);
-        
-        struct timeval tv;
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
-        setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-        
-        int n = recvfrom(sockfd, buffer, sizeof(buffer) - 1, 0, 
-                        (struct sockaddr*)&serverAddr, &addrLen);
-        
-        if (n > 0) {
+        int ready = poll(fds, fdCount, 1000);
+        if (ready < 0 && errno != EINTR) {
+            perror("Ошибка poll");
+            break;
+        }
+
+        bool redrawNow = false;
+        if (keysIndex >= 0 && ready > 0 && (fds[keysIndex].revents & POLLIN)) {
+            char keys[64];
+            int n = read(STDIN_FILENO, keys, sizeof(keys));
+            if (n > 0 && handleKeys(keys, n)) redrawNow = true;
+        }
+
+        for (int i = 0; i < fdCount && ready > 0; i++) {
+            if (i == keysIndex || !(fds[i].revents & POLLIN)) continue;
+
+            char buffer[RECV_BUFFER_SIZE];
+            int n = recv(fds[i].fd, buffer, sizeof(buffer) - 1, 0);
+            if (n <= 0) continue;
+
             buffer[n] = '\0';
-            std::string response(buffer);
-            
+            if (strcmp(buffer, "SERVER_SHUTDOWN") == 0) {
+                serverShutdown = true; // Сообщение выводится после выхода из альтернативного экрана
+                running = false;
+                break;
+            }
+
             // Синхронизированный доступ к данным
             std::lock_guard<std::mutex> lock(mtx);
-            parseStatusResponse(response);
+            if (handleServerMessage(buffer, sockfd, serverAddr, sub)) dirty = true;
         }
 
-	if (strcmp(buffer, "SERVER_SHUTDOWN") == 0) {
-    	    std::cout << "Монитор: Получен сигнал завершения от сервера" << std::endl;
-    	    running = false;
-    	    break;
-	 }
-        
-        // Отображаем обновленную информацию
-        displayForest();
-        
-        // Пауза между обновлениями
-        std::unique_lock<std::mutex> lock(mtx);
-        cv.wait_for(lock, std::chrono::seconds(3), []{ return !running; });
+        auto now = std::chrono::steady_clock::now();
+
+        // Снимок не собран вовремя - часть датаграмм потеряна
+        if (!sub.synced && now - sub.requestedAt > std::chrono::seconds(RESYNC_TIMEOUT)) {
+            std::lock_guard<std::mutex> lock(mtx);
+            requestSnapshot(sockfd, serverAddr, sub);
+        }
+
+        if (now - lastKeepalive >= std::chrono::seconds(KEEPALIVE_INTERVAL)) {
+            const char* keepalive = "KEEPALIVE";
+            sendto(sockfd, keepalive, strlen(keepalive), 0,
+                  (struct sockaddr*)&serverAddr, sizeof(serverAddr));
+            lastKeepalive = now;
+        }
+
+        // Изменился размер терминала - кадр выводится заново целиком
+        int cols, rows;
+        ScreenBuffer::terminalSize(cols, rows);
+        if (cols != screen.cols() || rows != screen.rows()) redrawNow = true;
+
+        // Перерисовываем экран только при изменениях и не чаще REDRAW_INTERVAL_MS;
+        // клавиши и изменение размера перерисовывают сразу
+        if (!running || !sub.synced) continue;
+        if (redrawNow || (dirty && now - lastRedraw >= std::chrono::milliseconds(REDRAW_INTERVAL_MS))) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!screenActive) {
+                const char* enter = ScreenBuffer::enterSequence();
+                if (write(STDOUT_FILENO, enter, strlen(enter)) < 0) perror("Ошибка вывода на экран");
+                screenActive = true;
+            }
+            displayForest();
+            lastRedraw = now;
+            dirty = false;
+        }
     }
 }
 
@@ -324,6 +693,7 @@ int main(int argc, char* argv[]) {
     // Установка обработчика сигнала для корректного выхода
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
+    signal(SIGWINCH, signalHandler);
 
     // Создание UDP сокета
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -346,7 +716,7 @@ int main(int argc, char* argv[]) {
           (struct sockaddr*)&serverAddr, sizeof(serverAddr));
     
     // Получаем начальную информацию от сервера
-    char buffer[1024] = {0};
+    char buffer[RECV_BUFFER_SIZE] = {0};
     socklen_t addrLen = sizeof(serverAddr);
     
     // Устанавливаем таймаут для первоначального подключения
@@ -367,6 +737,7 @@ int main(int argc, char* argv[]) {
     
     buffer[n] = '\0';
     std::string initResponse(buffer);
+    int multicastFd = -1;
     
     // Обрабатываем начальную информацию
     if (initResponse.substr(0, 5) == "INIT:") {
@@ -375,6 +746,15 @@ int main(int argc, char* argv[]) {
         
         if (std::getline(ss, token, ':')) totalSectors = std::stoi(token);
         if (std::getline(ss, token, ':')) winnieSector = std::stoi(token);
+
+        // Необязательная многоадресная группа для событий: INIT:<секторы>:<сектор>:<группа>:<порт>
+        std::string group;
+        if (std::getline(ss, group, ':') && std::getline(ss, token, ':')) {
+            multicastFd = joinMulticastGroup(group, std::stoi(token));
+            if (multicastFd >= 0) {
+                std::cout << "События принимаются из многоадресной группы " << group << ":" << token << std::endl;
+            }
+        }
         
         std::cout << "Подключено к серверу. Лес разделен на " << totalSectors << " секторов." << std::endl;
     } else {
@@ -383,8 +763,18 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    // Запускаем поток для периодического обновления статуса
-    std::thread updateThread(statusUpdateThread, sockfd, serverAddr);
+    // Клавиши управления картой читаются по одной, без эха; Ctrl+C по-прежнему дает SIGINT
+    struct termios savedTerminal;
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &savedTerminal) == 0) {
+        struct termios raw = savedTerminal;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0) keyboardActive = true;
+    }
+
+    // Запускаем поток приема снимка и событий
+    std::thread updateThread(statusUpdateThread, sockfd, multicastFd, serverAddr);
     
     // Ожидаем завершения работы (по сигналу от пользователя)
     while (running) {
@@ -398,7 +788,16 @@ int main(int argc, char* argv[]) {
     
     // Ждем завершения потока обновления
     if (updateThread.joinable()) updateThread.join();
+
+    // Возвращаем терминал в исходное состояние
+    if (screenActive) {
+        const char* leave = ScreenBuffer::leaveSequence();
+        if (write(STDOUT_FILENO, leave, strlen(leave)) < 0) perror("Ошибка вывода на экран");
+    }
+    if (keyboardActive) tcsetattr(STDIN_FILENO, TCSANOW, &savedTerminal);
+    if (serverShutdown) std::cout << "Монитор: Получен сигнал завершения от сервера" << std::endl;
     
+    if (multicastFd >= 0) close(multicastFd);
     close(sockfd);
     std::cout << "Монитор #" << monitorId << ": Работа завершена." << std::endl;
     return 0;
@@ -0,0 +1,328 @@
+// bee_protocol.h
+#ifndef BEE_PROTOCOL_H
+#define BEE_PROTOCOL_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <arpa/inet.h>
+
+// Двоичный протокол обмена между стаями и сервером.
+// Сообщение фиксированной длины; первый байт BEE_PROTOCOL_MAGIC не может начинать
+// текстовое сообщение, поэтому сервер различает оба формата по первому байту.
+// Стая договаривается о формате сообщением HELLO: если сервер не ответил HELLO_ACK,
+// стая продолжает работу по текстовому протоколу.
+// Версия 2 добавляет аренду нескольких секторов за один обмен: в REQUEST поле flags - желаемое
+// число секторов, а SEARCH и REPORT несут в flags число секторов, перечисленных после заголовка.
+// Версия 3 добавляет групповой HEARTBEAT: процесс, который ведет несколько стай с одного сокета,
+// отправляет одну датаграмму за все стаи - в flags число номеров стай, следующих после заголовка.
+// Версия 4 добавляет номер игры: заголовок продолжается полем gameId (4 байта), а списки секторов
+// и стай идут после него. Один сервер ведет много независимых игр; текстовый протокол и стаи
+// младших версий играют в игру по умолчанию с номером 0.
+// Версия 5 добавляет маркер сеанса: старший бит flags в REQUEST, REPORT и DISCONNECT
+// (BEE_FLAG_SESSION_START) помечает первый надежный запрос сеанса стаи и его повторы.
+#define BEE_PROTOCOL_MAGIC 0xBE
+#define BEE_PROTOCOL_VERSION 5
+#define BEE_BATCH_PROTOCOL_VERSION 2 // Первая версия с арендой нескольких секторов
+#define BEE_HEARTBEAT_BATCH_VERSION 3 // Первая версия с групповым HEARTBEAT
+#define BEE_GAME_PROTOCOL_VERSION 4 // Первая версия с номером игры
+#define BEE_SESSION_PROTOCOL_VERSION 5 // Первая версия с маркером сеанса
+#define BEE_FLAG_SESSION_START 0x80 // Бит flags надежного запроса: запрос открывает новый сеанс стаи
+#define BEE_DEFAULT_GAME 0 // Игра стай, не указавших номер игры
+#define BEE_MAX_BATCH 16 // Максимальное число секторов в одном SEARCH или REPORT
+#define BEE_MAX_HEARTBEAT_BATCH 200 // Максимальное число дополнительных стай в групповом HEARTBEAT
+#define BEE_MAX_MESSAGE_SIZE 96 // Достаточный размер буфера для любого сообщения, кроме группового HEARTBEAT
+#define BEE_MAX_HEARTBEAT_SIZE (20 + BEE_MAX_HEARTBEAT_BATCH * 4) // Размер группового HEARTBEAT
+
+// Типы сообщений
+enum BeeMessageType : uint8_t {
+    MSG_UNKNOWN = 0,
+
+    // Стая -> сервер
+    MSG_HELLO = 1,
+    MSG_REQUEST = 2,
+    MSG_REPORT = 3,
+    MSG_HEARTBEAT = 4,
+    MSG_DISCONNECT = 5,
+
+    // Сервер -> стая
+    MSG_HELLO_ACK = 16,
+    MSG_SEARCH = 17,
+    MSG_CONTINUE = 18,
+    MSG_WINNIE_FOUND = 19,
+    MSG_NO_MORE_SECTORS = 20,
+    MSG_DENIED = 21,
+    MSG_HEARTBEAT_ACK = 22,
+    MSG_DISCONNECT_ACK = 23,
+    MSG_SERVER_SHUTDOWN = 24,
+    MSG_CANCEL = 25 // Сектор sectorId уже исследовала другая стая: его поиск можно прекратить
+};
+
+// Формат сообщения в сети (все многобайтовые поля в сетевом порядке байт)
+#pragma pack(push, 1)
+struct BeeWireMessage {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint8_t flags;
+    uint32_t swarmId;
+    int32_t sectorId;
+    uint32_t sequence;
+    // С версии 4 далее следует номер игры (uint32).
+    // Для SEARCH и REPORT с flags > 0 далее следуют flags номеров секторов (int32),
+    // для HEARTBEAT - flags номеров стай (uint32) в дополнение к swarmId
+};
+#pragma pack(pop)
+
+// Разобранное сообщение любого из двух форматов
+struct BeeMessage {
+    uint8_t type = MSG_UNKNOWN;
+    uint8_t version = BEE_PROTOCOL_VERSION;
+    bool binary = false;    // Формат, в котором сообщение пришло (и в котором на него отвечать)
+    int32_t swarmId = -1;
+    int32_t sectorId = -1;
+    uint32_t sequence = 0;
+    uint32_t gameId = BEE_DEFAULT_GAME; // Номер игры (передается с версии 4)
+    uint8_t batchSize = 0;      // REQUEST: желаемое число секторов (0 - один сектор, как в версии 1)
+    uint8_t sectorCount = 0;    // SEARCH, REPORT: число секторов в sectors (0 - только sectorId)
+    int32_t sectors[BEE_MAX_BATCH];
+    uint8_t heartbeatCount = 0; // HEARTBEAT: число дополнительных стай после заголовка (см. beeHeartbeatSwarm)
+    bool sessionStart = false;  // REQUEST, REPORT, DISCONNECT: первый надежный запрос сеанса (с версии 5)
+};
+
+// Текстовое имя типа сообщения (оно же префикс текстового протокола)
+inline const char* beeMessageName(uint8_t type) {
+    switch (type) {
+        case MSG_HELLO: return "HELLO";
+        case MSG_REQUEST: return "REQUEST";
+        case MSG_REPORT: return "REPORT";
+        case MSG_HEARTBEAT: return "HEARTBEAT";
+        case MSG_DISCONNECT: return "DISCONNECT";
+        case MSG_HELLO_ACK: return "HELLO_ACK";
+        case MSG_SEARCH: return "SEARCH";
+        case MSG_CONTINUE: return "CONTINUE";
+        case MSG_WINNIE_FOUND: return "WINNIE_FOUND";
+        case MSG_NO_MORE_SECTORS: return "NO_MORE_SECTORS";
+        case MSG_DENIED: return "DENIED";
+        case MSG_HEARTBEAT_ACK: return "HEARTBEAT_ACK";
+        case MSG_DISCONNECT_ACK: return "DISCONNECT_ACK";
+        case MSG_SERVER_SHUTDOWN: return "SERVER_SHUTDOWN";
+        case MSG_CANCEL: return "CANCEL";
+        default: return "";
+    }
+}
+
+// Длина двоичного заголовка сообщения версии version
+inline size_t beeHeaderSize(uint8_t version) {
+    return sizeof(BeeWireMessage) + (version >= BEE_GAME_PROTOCOL_VERSION ? sizeof(uint32_t) : 0);
+}
+
+// Маркер сеанса есть только у надежных запросов стаи: в HEARTBEAT flags занят числом стай целиком
+inline bool beeCarriesSessionFlag(uint8_t type, uint8_t version) {
+    return version >= BEE_SESSION_PROTOCOL_VERSION &&
+           (type == MSG_REQUEST || type == MSG_REPORT || type == MSG_DISCONNECT);
+}
+
+// Проверяет, что текст начинается с префикса, и возвращает указатель на остаток
+inline const char* beeMatchPrefix(const char* data, size_t len, const char* prefix) {
+    size_t prefixLen = strlen(prefix);
+    if (len < prefixLen || memcmp(data, prefix, prefixLen) != 0) return nullptr;
+    return data + prefixLen;
+}
+
+// Читает целое число с текущей позиции; data должен заканчиваться нулевым байтом
+inline bool beeParseInt(const char*& p, int32_t& value) {
+    char* end;
+    long v = strtol(p, &end, 10);
+    if (end == p) return false;
+    value = (int32_t)v;
+    p = end;
+    return true;
+}
+
+// Разбор сообщения без выделения памяти. Текстовое сообщение должно заканчиваться нулевым байтом
+inline bool parseBeeMessage(const char* data, size_t len, BeeMessage& out) {
+    out = BeeMessage();
+
+    if (len >= sizeof(BeeWireMessage) && (uint8_t)data[0] == BEE_PROTOCOL_MAGIC) {
+        BeeWireMessage wire;
+        memcpy(&wire, data, sizeof(wire));
+        size_t header = beeHeaderSize(wire.version);
+        if (wire.version == 0 || len < header) return false;
+        out.binary = true;
+        out.version = wire.version;
+        out.type = wire.type;
+        out.swarmId = (int32_t)ntohl(wire.swarmId);
+        out.sectorId = (int32_t)ntohl((uint32_t)wire.sectorId);
+        out.sequence = ntohl(wire.sequence);
+        if (header > sizeof(wire)) {
+            uint32_t gameId;
+            memcpy(&gameId, data + sizeof(wire), sizeof(gameId));
+            out.gameId = ntohl(gameId);
+        }
+
+        if (beeCarriesSessionFlag(out.type, out.version)) {
+            out.sessionStart = (wire.flags & BEE_FLAG_SESSION_START) != 0;
+            wire.flags &= (uint8_t)~BEE_FLAG_SESSION_START;
+        }
+
+        if (out.type == MSG_REQUEST) {
+            out.batchSize = wire.flags;
+        } else if ((out.type == MSG_SEARCH || out.type == MSG_REPORT) && wire.flags > 0) {
+            if (wire.flags > BEE_MAX_BATCH || len < header + wire.flags * sizeof(int32_t)) return false;
+            out.sectorCount = wire.flags;
+            for (int i = 0; i < out.sectorCount; i++) {
+                uint32_t sector;
+                memcpy(&sector, data + header + i * sizeof(int32_t), sizeof(sector));
+                out.sectors[i] = (int32_t)ntohl(sector);
+            }
+        } else if (out.type == MSG_HEARTBEAT && wire.flags > 0) {
+            // Номера стай не копируются: их читает beeHeartbeatSwarm прямо из датаграммы
+            if (wire.flags > BEE_MAX_HEARTBEAT_BATCH || len < header + wire.flags * sizeof(uint32_t)) return false;
+            out.heartbeatCount = wire.flags;
+        }
+        return out.type != MSG_UNKNOWN;
+    }
+
+    // Текстовый протокол: сообщения с параметрами
+    const char* p;
+    if ((p = beeMatchPrefix(data, len, "REQUEST:")) != nullptr) {
+        out.type = MSG_REQUEST;
+        return beeParseInt(p, out.swarmId);
+    }
+    if ((p = beeMatchPrefix(data, len, "REPORT:")) != nullptr) {
+        out.type = MSG_REPORT;
+        return beeParseInt(p, out.swarmId) && *p++ == ':' && beeParseInt(p, out.sectorId);
+    }
+    if ((p = beeMatchPrefix(data, len, "HEARTBEAT:")) != nullptr) {
+        out.type = MSG_HEARTBEAT;
+        return beeParseInt(p, out.swarmId);
+    }
+    if ((p = beeMatchPrefix(data, len, "SEARCH:")) != nullptr) {
+        out.type = MSG_SEARCH;
+        return beeParseInt(p, out.sectorId);
+    }
+
+    // Сообщения без параметров
+    static const uint8_t plainTypes[] = {
+        MSG_DISCONNECT_ACK, MSG_DISCONNECT, MSG_CONTINUE, MSG_WINNIE_FOUND, MSG_NO_MORE_SECTORS,
+        MSG_DENIED, MSG_HEARTBEAT_ACK, MSG_SERVER_SHUTDOWN
+    };
+    for (uint8_t type : plainTypes) {
+        const char* name = beeMessageName(type);
+        if (len == strlen(name) && memcmp(data, name, len) == 0) {
+            out.type = type;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Записывает неотрицательное или отрицательное число в буфер, возвращает новый конец
+inline char* beeAppendInt(char* p, int32_t value) {
+    char digits[12];
+    int n = 0;
+    uint32_t v = value < 0 ? (uint32_t)(-(int64_t)value) : (uint32_t)value;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    if (value < 0) *p++ = '-';
+    while (n > 0) *p++ = digits[--n];
+    return p;
+}
+
+// Номер index-й дополнительной стаи группового HEARTBEAT msg, разобранного из data (index < heartbeatCount)
+inline int32_t beeHeartbeatSwarm(const char* data, const BeeMessage& msg, int index) {
+    uint32_t id;
+    memcpy(&id, data + beeHeaderSize(msg.version) + index * sizeof(uint32_t), sizeof(id));
+    return (int32_t)ntohl(id);
+}
+
+// Кодирует групповой HEARTBEAT стай игры gameId в формате версии version: первая стая - в заголовке,
+// остальные count - 1 после него. Буфер должен вмещать BEE_MAX_HEARTBEAT_SIZE байт. Возвращает длину сообщения
+inline size_t encodeBeeHeartbeats(const int32_t* swarmIds, int count, char* buf,
+                                  uint8_t version = BEE_PROTOCOL_VERSION, uint32_t gameId = BEE_DEFAULT_GAME) {
+    BeeWireMessage wire;
+    wire.magic = BEE_PROTOCOL_MAGIC;
+    wire.version = version;
+    wire.type = MSG_HEARTBEAT;
+    wire.flags = (uint8_t)(count - 1);
+    wire.swarmId = htonl((uint32_t)swarmIds[0]);
+    wire.sectorId = (int32_t)htonl((uint32_t)-1);
+    wire.sequence = 0;
+    memcpy(buf, &wire, sizeof(wire));
+    size_t len = beeHeaderSize(version);
+    if (len > sizeof(wire)) {
+        uint32_t game = htonl(gameId);
+        memcpy(buf + sizeof(wire), &game, sizeof(game));
+    }
+
+    for (int i = 1; i < count; i++) {
+        uint32_t id = htonl((uint32_t)swarmIds[i]);
+        memcpy(buf + len, &id, sizeof(id));
+        len += sizeof(id);
+    }
+    return len;
+}
+
+// Кодирует сообщение в формате msg.binary. Буфер должен вмещать BEE_MAX_MESSAGE_SIZE байт.
+// Список секторов передается только в двоичном формате. Возвращает длину сообщения
+inline size_t encodeBeeMessage(const BeeMessage& msg, char* buf) {
+    if (msg.binary) {
+        BeeWireMessage wire;
+        wire.magic = BEE_PROTOCOL_MAGIC;
+        wire.version = msg.version;
+        wire.type = msg.type;
+        wire.flags = msg.type == MSG_REQUEST ? msg.batchSize : msg.sectorCount;
+        if (msg.sessionStart && beeCarriesSessionFlag(msg.type, msg.version)) wire.flags |= BEE_FLAG_SESSION_START;
+        wire.swarmId = htonl((uint32_t)msg.swarmId);
+        wire.sectorId = (int32_t)htonl((uint32_t)msg.sectorId);
+        wire.sequence = htonl(msg.sequence);
+        memcpy(buf, &wire, sizeof(wire));
+        size_t len = beeHeaderSize(msg.version);
+        if (len > sizeof(wire)) {
+            uint32_t gameId = htonl(msg.gameId);
+            memcpy(buf + sizeof(wire), &gameId, sizeof(gameId));
+        }
+
+        if (msg.type != MSG_REQUEST) {
+            for (int i = 0; i < msg.sectorCount; i++) {
+                uint32_t sector = htonl((uint32_t)msg.sectors[i]);
+                memcpy(buf + len, &sector, sizeof(sector));
+                len += sizeof(sector);
+            }
+        }
+        return len;
+    }
+
+    const char* name = beeMessageName(msg.type);
+    size_t nameLen = strlen(name);
+    memcpy(buf, name, nameLen);
+    char* p = buf + nameLen;
+
+    switch (msg.type) {
+        case MSG_REQUEST:
+        case MSG_HEARTBEAT:
+            *p++ = ':';
+            p = beeAppendInt(p, msg.swarmId);
+            break;
+        case MSG_REPORT:
+            *p++ = ':';
+            p = beeAppendInt(p, msg.swarmId);
+            *p++ = ':';
+            p = beeAppendInt(p, msg.sectorId);
+            *p++ = ':';
+            break;
+        case MSG_SEARCH:
+            *p++ = ':';
+            p = beeAppendInt(p, msg.sectorId);
+            break;
+        default:
+            break;
+    }
+    *p = '\0';
+    return p - buf;
+}
+
+#endif // BEE_PROTOCOL_H
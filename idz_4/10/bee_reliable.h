@@ -0,0 +1,143 @@
+// bee_reliable.h
+#ifndef BEE_RELIABLE_H
+#define BEE_RELIABLE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include "bee_protocol.h"
+
+// Надежная доставка запросов стаи поверх UDP (только двоичный протокол).
+// Надежные запросы - REQUEST, REPORT и DISCONNECT - получают порядковые номера подряд в каждом
+// сеансе стаи; HELLO и HEARTBEAT отправляются с номером 0 и не повторяются. С версии 5 первый
+// номер сеанса случаен, а первый запрос сеанса и его повторы несут флаг BEE_FLAG_SESSION_START.
+// Стая ждет ответа с тем же номером и повторяет запрос с тем же номером по таймауту RTO,
+// который вычисляется по измеренному времени оборота (RFC 6298) и удваивается при каждом повторе.
+// Ответ с номером N подтверждает все запросы стаи до N включительно, поэтому у стаи не больше
+// одного неподтвержденного запроса. Сервер помнит номер и тип последнего ответа каждой стаи:
+// повтор уже обработанного запроса получает тот же ответ без повторной обработки, а
+// запоздавшие копии более старых запросов отбрасываются. Новый сеанс сервер начинает только
+// по флагу: запоздавшая копия первого запроса текущего сеанса несет запомненный первый номер
+// сеанса и отбрасывается, а не сбрасывает подавление повторов.
+#define BEE_INITIAL_RTO_MS 300 // Таймаут повтора до первого измерения времени оборота (мс)
+#define BEE_MIN_RTO_MS 20 // Минимальный таймаут повтора (мс)
+#define BEE_MAX_RTO_MS 3000 // Максимальный таймаут повтора (мс)
+#define BEE_MAX_RETRANSMITS 8 // Количество повторов, после которого сервер считается недоступным
+
+// Монотонное время в микросекундах для измерения времени оборота
+inline int64_t monotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Номер первого надежного запроса нового сеанса стаи для согласованной версии протокола.
+// С версии 5 он случаен, чтобы сервер отличал новый сеанс от копии первого запроса прежнего
+inline uint32_t beeSessionFirstSequence(uint8_t version) {
+    if (version < BEE_SESSION_PROTOCOL_VERSION) return 1;
+    thread_local std::mt19937 gen{std::random_device()()};
+    uint32_t first;
+    do {
+        first = gen();
+    } while (first == 0);
+    return first;
+}
+
+// Следующий номер надежного запроса: номер 0 занят сообщениями без подтверждения
+inline uint32_t beeNextSequence(uint32_t sequence) {
+    return sequence + 1 == 0 ? 1 : sequence + 1;
+}
+
+// Оценка времени оборота и таймаута повтора по RFC 6298.
+// Время оборота измеряется только по запросам без повторов (алгоритм Карна)
+class RttEstimator {
+public:
+    void sample(int64_t rttUs) {
+        if (!measured) {
+            srttUs = rttUs;
+            rttvarUs = rttUs / 2;
+            measured = true;
+        } else {
+            rttvarUs = (3 * rttvarUs + std::abs(srttUs - rttUs)) / 4;
+            srttUs = (7 * srttUs + rttUs) / 8;
+        }
+        rtoMs = std::clamp<int64_t>((srttUs + 4 * rttvarUs) / 1000, BEE_MIN_RTO_MS, BEE_MAX_RTO_MS);
+    }
+
+    // Таймаут ожидания ответа на попытку attempt (0 - первая отправка)
+    int64_t timeoutMs(int attempt) const {
+        return std::min<int64_t>(rtoMs << std::min(attempt, 16), BEE_MAX_RTO_MS);
+    }
+
+    int64_t smoothedUs() const { return srttUs; }
+
+private:
+    bool measured = false;
+    int64_t srttUs = 0;
+    int64_t rttvarUs = 0;
+    int64_t rtoMs = BEE_INITIAL_RTO_MS;
+};
+
+// Результат проверки порядкового номера запроса
+enum BeeSequenceCheck {
+    BEE_SEQUENCE_NEW,       // Новый запрос: обработать и запомнить ответ
+    BEE_SEQUENCE_DUPLICATE, // Повтор последнего запроса: отправить запомненный ответ
+    BEE_SEQUENCE_STALE      // Копия более старого запроса: отбросить
+};
+
+// Последний ответ стае на надежный запрос (хранится на сервере в записи стаи)
+struct BeeReplyCache {
+    uint32_t sequence = 0;
+    uint32_t sessionFirst = 0; // Номер первого запроса текущего сеанса (0 - сеанс без маркера)
+    uint8_t type = MSG_UNKNOWN;
+    int32_t sectorId = -1;
+
+    // Номер 0 (текстовый протокол, HELLO, HEARTBEAT) не проверяется. Новый сеанс начинает только
+    // запрос с маркером сеанса; стаи версий до 5 маркера не знают и начинают сеанс с номера 1
+    BeeSequenceCheck check(const BeeMessage& request) const {
+        if (request.sequence == 0 || sequence == 0) return BEE_SEQUENCE_NEW;
+        if (request.sequence == sequence) return BEE_SEQUENCE_DUPLICATE;
+        if (request.sessionStart) return request.sequence == sessionFirst ? BEE_SEQUENCE_STALE : BEE_SEQUENCE_NEW;
+        if (request.version < BEE_SESSION_PROTOCOL_VERSION && request.sequence == 1) return BEE_SEQUENCE_NEW;
+        return (int32_t)(request.sequence - sequence) > 0 ? BEE_SEQUENCE_NEW : BEE_SEQUENCE_STALE;
+    }
+
+    void remember(const BeeMessage& request, uint8_t replyType, int32_t replySector = -1) {
+        if (request.sessionStart) sessionFirst = request.sequence;
+        sequence = request.sequence;
+        type = replyType;
+        sectorId = replySector;
+    }
+};
+
+// Искусственная потеря датаграмм для проверки надежной доставки (параметр --loss PERCENT)
+class LossInjector {
+public:
+    void setPercent(double percent) {
+        threshold = (uint64_t)(std::clamp(percent, 0.0, 100.0) / 100.0 * 4294967296.0);
+    }
+
+    // true - датаграмму нужно "потерять"
+    bool drop() {
+        if (threshold == 0) return false;
+        // xorshift64 с состоянием на поток: без блокировок и общих данных между потоками
+        thread_local uint64_t state = 0x9E3779B97F4A7C15ULL ^ (uint64_t)monotonicUs() ^ ((uint64_t)(uintptr_t)&state << 16);
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        if ((state & 0xFFFFFFFFULL) >= threshold) return false;
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    unsigned long droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    uint64_t threshold = 0;
+    std::atomic<unsigned long> dropped{0};
+};
+
+#endif // BEE_RELIABLE_H
@@ -0,0 +1,157 @@
+// bee_screen.h
+#ifndef BEE_SCREEN_H
+#define BEE_SCREEN_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#define SCREEN_BOLD 0x80 // Бит жирного шрифта в атрибуте клетки; младшие биты - цвет ANSI (30-37, 0 - по умолчанию)
+#define SCREEN_DEFAULT_COLS 80 // Размер экрана, если вывод идет не в терминал
+#define SCREEN_DEFAULT_ROWS 24
+
+// Экран терминала с двойной буферизацией. Кадр рисуется в задний буфер, а flush сравнивает
+// его с уже выведенным (передним буфером) и выводит только изменившиеся клетки, переставляя
+// курсор ANSI-последовательностями. Неизменный кадр не выводит ни байта, поэтому нет мерцания
+// полной очистки экрана, а объем вывода пропорционален числу изменений
+class ScreenBuffer {
+public:
+    struct Cell {
+        char32_t glyph = ' ';
+        uint8_t attr = 0;
+
+        bool operator==(const Cell& other) const { return glyph == other.glyph && attr == other.attr; }
+        bool operator!=(const Cell& other) const { return !(*this == other); }
+    };
+
+    // Текущий размер терминала
+    static void terminalSize(int& cols, int& rows) {
+        struct winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0) {
+            cols = ws.ws_col;
+            rows = ws.ws_row;
+        } else {
+            cols = SCREEN_DEFAULT_COLS;
+            rows = SCREEN_DEFAULT_ROWS;
+        }
+    }
+
+    // Альтернативный экран терминала со скрытым курсором: после выхода прежнее содержимое восстанавливается
+    static const char* enterSequence() { return "\033[?1049h\033[?25l"; }
+    static const char* leaveSequence() { return "\033[0m\033[?25h\033[?1049l"; }
+
+    // Задает размер экрана. Возвращает true, если размер изменился: тогда следующий flush
+    // очищает терминал и выводит кадр целиком
+    bool resize(int newCols, int newRows) {
+        if (newCols == width && newRows == height) return false;
+        width = newCols;
+        height = newRows;
+        back.assign((size_t)width * height, Cell());
+        front.assign((size_t)width * height, Cell());
+        fullRedraw = true;
+        return true;
+    }
+
+    int cols() const { return width; }
+    int rows() const { return height; }
+
+    // Очищает задний буфер перед рисованием кадра
+    void clear() { std::fill(back.begin(), back.end(), Cell()); }
+
+    void put(int x, int y, char32_t glyph, uint8_t attr) {
+        if (x < 0 || y < 0 || x >= width || y >= height) return;
+        back[(size_t)y * width + x] = {glyph, attr};
+    }
+
+    // Выводит строку UTF-8 с позиции (x, y) без переноса. Возвращает столбец после последнего символа
+    int text(int x, int y, const std::string& utf8, uint8_t attr) {
+        for (size_t i = 0; i < utf8.size(); ) {
+            unsigned char c = utf8[i];
+            int length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : 4;
+            char32_t glyph = length == 1 ? c : c & (0x3F >> (length - 1));
+            for (int k = 1; k < length && i + k < utf8.size(); k++) glyph = (glyph << 6) | (utf8[i + k] & 0x3F);
+            put(x++, y, glyph, attr);
+            i += length;
+        }
+        return x;
+    }
+
+    // Ширина строки UTF-8 в позициях терминала (по символу на позицию)
+    static int textWidth(const std::string& utf8) {
+        int width = 0;
+        for (unsigned char c : utf8) width += (c & 0xC0) != 0x80;
+        return width;
+    }
+
+    // Дописывает в out вывод изменившихся клеток и делает задний буфер выведенным.
+    // Возвращает количество выведенных клеток
+    size_t flush(std::string& out) {
+        int currentAttr = -1;
+        if (fullRedraw) {
+            out += "\033[0m\033[2J";
+            std::fill(front.begin(), front.end(), Cell()); // Очищенный терминал - пробелы без атрибутов
+            currentAttr = 0;
+            fullRedraw = false;
+        }
+
+        size_t changed = 0;
+        int cursorX = -1, cursorY = -1;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                size_t i = (size_t)y * width + x;
+                if (back[i] == front[i]) continue;
+                if (x != cursorX || y != cursorY) {
+                    out += "\033[" + std::to_string(y + 1) + ";" + std::to_string(x + 1) + "H";
+                }
+                if (back[i].attr != currentAttr) {
+                    appendAttr(out, back[i].attr);
+                    currentAttr = back[i].attr;
+                }
+                appendUtf8(out, back[i].glyph);
+                front[i] = back[i];
+                cursorX = x + 1;
+                cursorY = y;
+                changed++;
+            }
+        }
+        if (currentAttr > 0) out += "\033[0m";
+        return changed;
+    }
+
+private:
+    static void appendAttr(std::string& out, uint8_t attr) {
+        out += "\033[0";
+        if (attr & SCREEN_BOLD) out += ";1";
+        if (attr & ~SCREEN_BOLD) out += ";" + std::to_string(attr & ~SCREEN_BOLD);
+        out += "m";
+    }
+
+    static void appendUtf8(std::string& out, char32_t glyph) {
+        if (glyph < 0x80) {
+            out += (char)glyph;
+        } else if (glyph < 0x800) {
+            out += (char)(0xC0 | (glyph >> 6));
+            out += (char)(0x80 | (glyph & 0x3F));
+        } else if (glyph < 0x10000) {
+            out += (char)(0xE0 | (glyph >> 12));
+            out += (char)(0x80 | ((glyph >> 6) & 0x3F));
+            out += (char)(0x80 | (glyph & 0x3F));
+        } else {
+            out += (char)(0xF0 | (glyph >> 18));
+            out += (char)(0x80 | ((glyph >> 12) & 0x3F));
+            out += (char)(0x80 | ((glyph >> 6) & 0x3F));
+            out += (char)(0x80 | (glyph & 0x3F));
+        }
+    }
+
+    int width = 0;
+    int height = 0;
+    std::vector<Cell> back;  // Рисуемый кадр
+    std::vector<Cell> front; // Кадр, уже выведенный в терминал
+    bool fullRedraw = true;
+};
+
+#endif // BEE_SCREEN_H
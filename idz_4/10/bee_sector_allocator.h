@@ -0,0 +1,158 @@
+// bee_sector_allocator.h
+#ifndef BEE_SECTOR_ALLOCATOR_H
+#define BEE_SECTOR_ALLOCATOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Lock-free распределитель свободных секторов, общий для всех рабочих потоков сервера.
+// Каждому сектору соответствует бит в массиве 64-битных слов (1 - сектор свободен).
+// Захват сектора - CAS над одним словом, освобождение - fetch_or, поэтому потоки
+// не блокируют друг друга при выдаче секторов.
+// Над словами построена иерархия сводок: бит уровня k установлен, если в соответствующем
+// слове уровня k - 1 могут быть свободные секторы; уровни добавляются, пока верхний не станет
+// одним словом. Поиск поднимается по сводкам до первого установленного бита и спускается по
+// младшим битам (find-first-set), поэтому выдача сектора стоит O(log64 N) чтений слов -
+// не больше 4 уровней для MAX_SECTORS = 2^24 - независимо от числа исчерпанных слов.
+// Устаревший бит сводки снимается один раз, при первом поиске, наткнувшемся на пустое слово
+class SectorAllocator {
+public:
+    // Инициализация: все секторы свободны. Вызывается до запуска рабочих потоков
+    void init(int count) {
+        sectorCount = count;
+        levels.clear();
+        sizes.clear();
+        int bitCount = count;
+        do {
+            int size = (bitCount + 63) / 64;
+            levels.emplace_back(new std::atomic<uint64_t>[size]);
+            sizes.push_back(size);
+            fillBits(levels.back().get(), size, bitCount);
+            bitCount = size;
+        } while (bitCount > 1);
+        wordCount = sizes[0];
+    }
+
+    // Захватывает свободный сектор, начиная поиск со слова hint.
+    // Возвращает номер сектора или -1, если свободных секторов нет
+    int acquire(unsigned hint = 0) {
+        if (wordCount == 0) return -1;
+        int start = (int)(hint % wordCount);
+
+        // Сначала слова от hint до конца, затем с начала
+        for (int pass = 0; pass < 2; pass++) {
+            for (int w = findWord(pass == 0 ? start : 0); w >= 0; w = findWord(w + 1)) {
+                int sectorId = acquireInWord(w);
+                if (sectorId >= 0) return sectorId;
+            }
+        }
+        return -1;
+    }
+
+    // Возвращает сектор в пул свободных: бит сектора и биты всех уровней сводки над ним
+    void release(int id) {
+        if (id < 0 || id >= sectorCount) return;
+        int index = id;
+        for (size_t level = 0; level < levels.size(); level++) {
+            levels[level][index / 64].fetch_or(1ULL << (index % 64), std::memory_order_acq_rel);
+            index /= 64;
+        }
+    }
+
+    // Исключает сектор из пула (исследованные и арендованные секторы при восстановлении состояния).
+    // Биты сводки не трогаются: исчерпанное слово сбросит их при следующем поиске
+    void reserve(int id) {
+        if (id < 0 || id >= sectorCount) return;
+        levels[0][id / 64].fetch_and(~(1ULL << (id % 64)), std::memory_order_acq_rel);
+    }
+
+    int capacity() const { return sectorCount; }
+    int wordsCount() const { return wordCount; }
+
+private:
+    // Устанавливает младшие count битов массива
+    static void fillBits(std::atomic<uint64_t>* bits, int size, int count) {
+        for (int w = 0; w < size; w++) {
+            int bitsInWord = std::min(64, count - w * 64);
+            bits[w].store(bitsInWord == 64 ? ~0ULL : ((1ULL << bitsInWord) - 1), std::memory_order_relaxed);
+        }
+    }
+
+    // Первое слово секторов с номером не меньше from, помеченное в сводке, или -1
+    int findWord(int from) {
+        int top = (int)levels.size() - 1;
+        while (from < wordCount) {
+            if (top == 0) return from; // Секторов не больше 64 - сводки нет
+
+            // Подъем: на каждом уровне ищется бит не меньше pos в слове pos / 64;
+            // если его нет, выше ищется следующее слово
+            int level = 1;
+            int pos = from;
+            while (true) {
+                if (level > top || pos / 64 >= sizes[level]) return -1;
+                uint64_t bits = levels[level][pos / 64].load(std::memory_order_acquire) & (~0ULL << (pos % 64));
+                if (bits != 0) {
+                    pos = pos / 64 * 64 + __builtin_ctzll(bits);
+                    break;
+                }
+                pos = pos / 64 + 1;
+                level++;
+            }
+
+            // Спуск по младшим битам: pos - номер слова уровня level - 1
+            while (level > 1) {
+                uint64_t bits = levels[level - 1][pos].load(std::memory_order_acquire);
+                if (bits == 0) break;
+                pos = pos * 64 + __builtin_ctzll(bits);
+                level--;
+            }
+            if (level == 1) return pos;
+
+            // Бит сводки устарел: снимаем его и продолжаем со следующего слова того же уровня
+            clearSummary(level, pos);
+            int64_t next = (int64_t)(pos + 1) << (6 * (level - 1));
+            from = (int)std::min<int64_t>(next, wordCount);
+        }
+        return -1;
+    }
+
+    // Снимает бит index уровня level, если помеченное им слово уровня level - 1 пусто.
+    // Параллельный release мог вернуть сектор между проверкой и сбросом, поэтому после
+    // сброса слово проверяется повторно; опустевшее слово сводки снимается уровнем выше
+    void clearSummary(int level, int index) {
+        for (; level < (int)levels.size(); level++) {
+            uint64_t mask = 1ULL << (index % 64);
+            uint64_t before = levels[level][index / 64].fetch_and(~mask, std::memory_order_acq_rel);
+            if (levels[level - 1][index].load(std::memory_order_acquire) != 0) {
+                levels[level][index / 64].fetch_or(mask, std::memory_order_acq_rel);
+                return;
+            }
+            if ((before & ~mask) != 0) return;
+            index /= 64;
+        }
+    }
+
+    // Захватывает младший свободный бит слова w; если слово пусто, снимает его бит в сводке
+    int acquireInWord(int w) {
+        uint64_t current = levels[0][w].load(std::memory_order_acquire);
+        while (current != 0) {
+            int bit = __builtin_ctzll(current);
+            if (levels[0][w].compare_exchange_weak(current, current & ~(1ULL << bit),
+                                                   std::memory_order_acq_rel)) {
+                return w * 64 + bit;
+            }
+        }
+        clearSummary(1, w);
+        return -1;
+    }
+
+    std::vector<std::unique_ptr<std::atomic<uint64_t>[]>> levels; // levels[0] - биты секторов, дальше - сводки
+    std::vector<int> sizes; // Число слов на каждом уровне
+    int wordCount = 0;
+    int sectorCount = 0;
+};
+
+#endif // BEE_SECTOR_ALLOCATOR_H
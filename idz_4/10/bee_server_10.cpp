@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cstring>
+#include <climits>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -8,459 +9,2599 @@
 #include <algorithm>
 #include <random>
 #include <map>
-#include <set>
 #include <string>
+#include <sstream>
 #include <fcntl.h>
 #include <signal.h>
 #include <mutex>
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <memory>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <poll.h>
+#include <linux/sock_diag.h>
+#include "bee_assignment.h"
+#include "bee_protocol.h"
+#include "bee_timer_wheel.h"
+#include "bee_snapshot.h"
+#include "bee_swarm_table.h"
+#include "bee_log.h"
+#include "bee_metrics.h"
+#include "bee_reliable.h"
+#include "bee_wal.h"
 
-#define MAX_SECTORS 10 // Максимальное количество участков леса
+#define DEFAULT_SECTORS 10 // Количество участков леса по умолчанию
+#define MAX_SECTORS (1 << 24) // Максимально допустимое количество участков леса
 #define MONITOR_PORT_OFFSET 1000 // Смещение порта для монитора
 #define CONTROL_PORT_OFFSET 2000 // Смещение порта для управляющего интерфейса
-#define HEARTBEAT_INTERVAL 5 // Интервал проверки активности клиентов (сек)
+#define LIVENESS_TICK_MS 100 // Длительность тика колеса таймеров активности (мс)
+#define SHUTDOWN_DRAIN_MS 200 // Наибольшее ожидание места в очереди сокета для последних ответов при завершении (мс)
+#define TIMER_WHEEL_SLOTS 256 // Количество ячеек колеса; оборот колеса длиннее CLIENT_TIMEOUT
 #define CLIENT_TIMEOUT 15 // Таймаут для определения отключения клиента (сек)
+#define SECTOR_LEASE_TIMEOUT 10 // Срок аренды одного сектора (сек); аренда N секторов длится N сроков
+#define MAX_EPOLL_EVENTS 16 // Максимальное число событий за один вызов epoll_wait
+#define DEFAULT_BATCH_SIZE 32 // Размер пакета для recvmmsg/sendmmsg по умолчанию
+#define MAX_BATCH_SIZE 256 // Максимально допустимый размер пакета
+#define RECV_BUFFER_SIZE 1024 // Размер буфера для одной входящей датаграммы
+#define MAX_REPLY_SIZE BEE_MAX_MESSAGE_SIZE // Максимальный размер короткого ответа пчеле или монитору
+#define MAX_WORKERS 64 // Максимальное количество рабочих потоков
+#define MAX_EVENT_SIZE 96 // Максимальный размер датаграммы события для мониторов
+#define SNAPSHOT_CHUNK_SIZE 1200 // Размер данных в одной датаграмме снимка состояния
+#define MULTICAST_TTL 1 // Время жизни многоадресных датаграмм (только локальная сеть)
+#define MAX_GAMES 65536 // Максимальное количество одновременных игр, включая игру по умолчанию
+#define GAME_CHUNK_SIZE 256 // Количество игр в одном блоке таблицы игр
+#define MAX_LISTED_GAMES 1000 // Максимальное количество номеров игр в ответе LIST_GAMES
+#define DEFAULT_SPECULATION_FACTOR 3 // Сектор выдается повторно, если ищется дольше 3 средних времен поиска
+#define MAX_STRAGGLERS 256 // Максимальное количество кандидатов на повторную выдачу в одной игре
+#define SEARCH_TIME_SMOOTHING 8 // Вес нового замера в скользящем среднем времени поиска - 1/8
+#define METRICS_PAGE_SIZE 1200 // Размер данных в одной странице выгрузки METRICS_TEXT
+#define LIST_PAGE_SWARMS 50 // Стай на странице LIST_BEES по умолчанию (ответ не больше 1200 байт)
+#define LIST_MAX_PAGE_SWARMS 1500 // Наибольший LIMIT страницы LIST_BEES: ответ остается меньше 64 КБ
+#define LIST_SCAN_LIMIT 65536 // Стай, просматриваемых для одной страницы LIST_BEES при редком фильтре
 
 // Структура для хранения информации о секторе
 struct Sector {
     int id;
-    bool searched = false;
-    bool assigned = false;  // Сектор назначен для поиска
-    bool winnieFound = false;
+    std::atomic<bool> searched{false};
+    std::atomic<uint8_t> holders{0}; // Стаи, которым сектор выдан для поиска (две - спекулятивная копия)
+    std::atomic<bool> winnieFound{false};
+    std::atomic<bool> speculated{false}; // Сектор есть в Game::speculations
+};
+
+// Давно арендованный сектор - кандидат на повторную выдачу простаивающей стае
+struct Straggler {
+    int sectorId;
+    uint64_t holder; // swarmKey стаи, которая ищет сектор
+    int64_t ageMs;   // Время с выдачи аренды или последнего отчета стаи
+};
+
+// Держатели спекулятивно выданного сектора: кто первым пришлет отчет, тот и исследовал сектор
+struct SpeculativeCopy {
+    uint64_t original;
+    uint64_t copy;
+};
+
+// Игра: свой лес со своим распределителем секторов и своим Винни-Пухом.
+// Стаи всех игр хранятся в общих шардах таблицы стай по ключу (игра, стая)
+struct Game {
+    uint32_t id = BEE_DEFAULT_GAME;
+    int sectorCount = 0;
+    std::vector<Sector> sectors; // Доступ к сектору по номеру за O(1)
+    SectorAssigner sectorAssigner; // Выдача секторов по политике --policy
+    std::atomic<int> searchedSectorsCount{0};
+    int winnieSector = -1;
+    std::atomic<bool> winnieFoundByBees{false};
+    std::atomic<bool> allSectorsSearched{false};
+    std::atomic<int> swarmCount{0}; // Количество стай игры
+    std::atomic<bool> closed{false}; // Игра удаляется: новые стаи не принимаются
+
+    // Сравнение политик назначения: перелет считается в тысячных долях расстояния между соседними секторами
+    std::atomic<unsigned long> assignedSectors{0};
+    std::atomic<uint64_t> flightDistance{0};
+    std::atomic<unsigned long> searchCost{0}; // Сумма оценок стоимости поиска выданных секторов
+    std::atomic<int64_t> firstAssignMs{0}; // Первая выдача сектора (монотонное время, мс)
+    std::atomic<int64_t> finishMs{0}; // Находка Винни-Пуха или исследование всех секторов
+
+    // Спекулятивная выдача в конце игры: когда свободные секторы закончились, сектор, который ищется
+    // намного дольше среднего, выдается еще и простаивающей стае. Первый отчет побеждает, копия отменяется
+    std::atomic<bool> endgame{false}; // Пул свободных секторов хотя бы раз оказался пуст
+    std::atomic<int64_t> averageSearchUs{0}; // Скользящее среднее времени поиска одного сектора
+    std::mutex speculationMutex; // Захватывается под мьютексом шарда, но не наоборот
+    std::vector<Straggler> stragglers; // Кандидаты, самые старые в конце; обновляются на тике таймера
+    std::map<int, SpeculativeCopy> speculations; // Выданные повторно и еще не исследованные секторы
+    std::atomic<unsigned long> speculativeAssigned{0};
+    std::atomic<unsigned long> speculativeWins{0}; // Копия исследовала сектор раньше первой стаи
+    std::atomic<unsigned long> speculativeLosses{0}; // Первая стая успела раньше, копия не пригодилась
+};
+
+// Блок таблицы игр: GAME_CHUNK_SIZE игр с подряд идущими номерами
+typedef std::vector<std::shared_ptr<Game>> GameChunk;
+
+// Неизменяемая таблица игр по номеру: стая находит свою игру без мьютексов. Блоки разделяются
+// между версиями таблицы, поэтому создание или удаление игры копирует только один блок.
+// Игра освобождается вместе с последней версией таблицы, которая на нее ссылается
+struct GameTable {
+    std::vector<std::shared_ptr<const GameChunk>> chunks;
+    int gameCount = 0;
 };
 
 // Структура для хранения информации о стае пчел
 struct BeeSwarm {
     int id;
-    int currentSector = -1;
+    int currentSector = -1; // Первый из арендованных секторов (для мониторов)
     bool active = false;
     bool searchInProgress = false;  // Флаг, указывающий что стая выполняет поиск
     bool disconnected = false;
+    uint32_t ip = 0; // IPv4 адрес в порядке байт хоста
+    uint16_t port = 0; // 0 - адрес еще не известен
+    time_t lastSeen; // Время последнего контакта
+    bool binary = false; // Стая использует двоичный протокол
+    int32_t lease[BEE_MAX_BATCH]; // Арендованные и еще не исследованные секторы
+    int leaseCount = 0;
+    BeeReplyCache lastReply; // Ответ на последний надежный запрос стаи (для повторов)
+    uint32_t gameId = BEE_DEFAULT_GAME; // Игра, в которой участвует стая
+    int position = -1; // Последний выданный стае сектор, от него считается перелет (-1 - улей)
+    int64_t leaseProgressMs = 0; // Выдача аренды или последний отчет: от него отсчитывается время поиска
+    uint64_t walSequence = 0; // Номер последней записи стаи в журнале
+    bool recovered = false; // Аренда восстановлена из журнала, номер последнего запроса неизвестен
+};
+
+// Структура для хранения информации о мониторе
+struct Monitor {
     std::string ip;
     int port;
     time_t lastSeen; // Время последнего контакта
+    bool subscribed = false; // Монитор подписан на поток событий
+};
+
+// Шард таблицы стай. Стая попадает в шард по своему номеру,
+// у каждого шарда собственный мьютекс
+struct SwarmShard {
+    std::mutex mutex;
+    FlatTable<BeeSwarm> swarms; // Стаи шарда по номеру (swarmKey)
+    TimerWheel liveness; // Таймеры активности стай шарда
+    TimerWheel leases; // Сроки аренды секторов стаями шарда
+    std::atomic<uint64_t> version{0}; // Номер изменения видимого состояния стай, растет под мьютексом
+};
+
+// Состояние стаи в снимке для запросов только на чтение
+struct SwarmView {
+    int id;
+    int currentSector;
+    bool active;
+    bool disconnected;
+    time_t lastSeen; // Время последнего контакта с точностью до секунды
+};
+
+// Неизменяемый снимок таблицы стай для STATUS и LIST_BEES. Списки стай шардов
+// разделяются между версиями снимка: заново копируются только изменившиеся шарды
+struct HiveSnapshot {
+    uint64_t version = 0;
+    std::vector<std::shared_ptr<const std::vector<SwarmView>>> shards;
+    std::vector<uint64_t> shardVersions; // SwarmShard::version, с которой скопирован шард
+    size_t totalSwarms = 0;
+    size_t activeSwarms = 0;
+    size_t disconnectedSwarms = 0;
+};
+
+// Флаг работы сервера: сбрасывает главный поток по сигналу из signalFd, остальные потоки только читают
+std::atomic<bool> running{true};
+int monitorSockfd = -1;
+int controlSockfd = -1;
+int timerFd = -1;
+int signalFd = -1; // signalfd для SIGINT/SIGTERM: сигналы приходят в цикл главного потока как события epoll
+int wakeFd = -1; // eventfd для пробуждения рабочих потоков при завершении
+Counter missedTicks; // Тики обслуживания, пропущенные из-за занятости главного потока
+
+// Мьютекс для синхронизации доступа к списку мониторов
+std::mutex monitorsMutex;
+
+SwarmShard swarmShards[MAX_WORKERS];
+WriteAheadLog journal; // Журнал изменений состояния игры (параметр --state DIR)
+
+// Ключ стаи (swarmKey) по ее адресу (peerKey) для текстового DISCONNECT, в котором нет номера стаи.
+// addressMutex захватывается под мьютексом шарда, но не наоборот
+std::mutex addressMutex;
+FlatTable<uint64_t> swarmsByAddress;
+
+// Игры сервера. Таблицу меняет только главный поток (управление и таймер), слот читателя - номер
+// рабочего потока. Игра по умолчанию (номер 0, параметр --sectors) существует все время работы сервера
+SnapshotDomain<GameTable, MAX_WORKERS> gameTables;
+Game* defaultGame = nullptr;
+std::atomic<int> createdGames(0); // Игры, созданные через управляющий порт
+uint32_t nextGameId = 1; // С этого номера ищется свободный номер для новой игры (только главный поток)
+
+// Снимки таблицы стай публикует главный поток на тике таймера; читатели получают их без мьютексов
+// шардов, поэтому частые запросы состояния не задерживают REQUEST/REPORT.
+// Слот читателя - номер рабочего потока
+SnapshotDomain<HiveSnapshot, MAX_WORKERS> hiveSnapshots;
+std::map<uint64_t, Monitor> monitors; // Мониторы по адресу (monitorKey)
+TimerWheel monitorLiveness; // Таймеры активности мониторов, защищены monitorsMutex
+
+// Поток событий для подписанных мониторов. Рабочие потоки только нумеруют событие и кладут его
+// в свою очередь (Worker::events); рассылает события главный поток (flushEvents) под eventMutex,
+// поэтому обработка запросов не ждет ни этот мьютекс, ни sendto мониторам
+std::mutex eventMutex;
+std::atomic<uint32_t> eventSequence{0}; // Номер последнего опубликованного (пронумерованного) события
+uint32_t sentEventSequence = 0; // Номер последнего разосланного события, защищен eventMutex
+std::vector<struct sockaddr_in> subscribers;
+std::atomic<int> subscriberCount{0}; // Размер subscribers для проверки без мьютекса
+
+// Необязательная многоадресная группа для событий мониторам (параметр --multicast)
+int multicastSockfd = -1;
+struct sockaddr_in multicastAddr;
+
+// Пакетный ввод-вывод датаграмм
+int batchSize = DEFAULT_BATCH_SIZE;
+
+// Количество рабочих потоков (и шардов таблицы стай)
+int workerCount = 1;
+
+// Политика выдачи секторов и приоритетные области (параметры --policy и --priority), общие для всех игр
+AssignmentPolicy assignmentPolicy = POLICY_LOWEST;
+std::vector<PriorityRegion> priorityRegions;
+
+// Во сколько раз поиск сектора должен превысить среднее время, чтобы сектор выдали повторно (0 - без повторной выдачи)
+int speculationFactor = DEFAULT_SPECULATION_FACTOR;
+
+// Искусственная потеря датаграмм стай (входящих и исходящих) для проверки надежной доставки
+LossInjector beeLoss;
+
+// Буфер входящих датаграмм, заполняемый одним вызовом recvmmsg
+struct RecvBatch {
+    struct mmsghdr msgs[MAX_BATCH_SIZE];
+    struct iovec iovs[MAX_BATCH_SIZE];
+    struct sockaddr_in addrs[MAX_BATCH_SIZE];
+    char data[MAX_BATCH_SIZE][RECV_BUFFER_SIZE];
+};
+
+// Буфер исходящих ответов, отправляемых одним вызовом sendmmsg
+struct ReplyBatch {
+    int fd = -1;
+    int count = 0;
+    struct mmsghdr msgs[MAX_BATCH_SIZE];
+    struct iovec iovs[MAX_BATCH_SIZE];
+    struct sockaddr_in addrs[MAX_BATCH_SIZE];
+    char data[MAX_BATCH_SIZE][MAX_REPLY_SIZE];
+};
+
+// Счетчики для оценки среднего достигнутого размера пакета
+struct BatchStats {
+    Counter recvCalls;
+    Counter recvDatagrams;
+    Counter sendCalls;
+    Counter sendDatagrams;
+};
+
+// Пронумерованное событие, ожидающее рассылки мониторам
+struct QueuedEvent {
+    uint32_t seq;
+    char record[MAX_EVENT_SIZE];
+};
+
+// Очередь событий рабочего потока. Мьютекс делят только сам поток и главный поток при рассылке
+struct EventQueue {
+    std::mutex mutex;
+    std::vector<QueuedEvent> events;
+};
+
+// Рабочий поток: собственный сокет на порту пчел (SO_REUSEPORT), свой epoll и свои буферы.
+// Нулевой поток - главный, он дополнительно обслуживает мониторы, управление и таймер
+struct Worker {
+    int index = 0;
+    int sockfd = -1;
+    int epollFd = -1;
+    RecvBatch recvBatch;
+    ReplyBatch beeReplies;
+    ReplyBatch monitorReplies;
+    BatchStats stats;
+    WorkerMetrics metrics;
+    EventQueue events;
+    std::thread thread;
+};
+
+std::vector<std::unique_ptr<Worker>> workers;
+thread_local Worker* currentWorker = nullptr; // Рабочий поток, выполняющий код (nullptr вне runWorker)
+
+// Ключ стаи в таблице шарда и в колесах таймеров: номер игры и номер стаи
+uint64_t swarmKey(uint32_t gameId, int swarmId) {
+    return ((uint64_t)gameId << 32) | (uint32_t)swarmId;
+}
+
+uint64_t swarmKey(const BeeSwarm& swarm) {
+    return swarmKey(swarm.gameId, swarm.id);
+}
+
+// Шард таблицы стай, которому принадлежит стая с ключом key
+SwarmShard& shardFor(uint64_t key) {
+    return swarmShards[key % workerCount];
+}
+
+// Захватывает мьютекс шарда для потока worker. Свободный мьютекс берется без замера времени,
+// ожидание занятого учитывается в метриках потока
+std::unique_lock<std::mutex> lockShard(Worker& worker, SwarmShard& shard) {
+    worker.metrics.lockAcquired.add(1);
+    if (!shard.mutex.try_lock()) {
+        int64_t start = monotonicNs();
+        shard.mutex.lock();
+        worker.metrics.lockWait.record(monotonicNs() - start);
+    }
+    return std::unique_lock<std::mutex>(shard.mutex, std::adopt_lock);
+}
+
+// Игра по номеру или nullptr
+Game* findGame(const GameTable& table, uint32_t gameId) {
+    if (gameId >= MAX_GAMES) return nullptr;
+    const auto& chunk = table.chunks[gameId / GAME_CHUNK_SIZE];
+    return chunk ? (*chunk)[gameId % GAME_CHUNK_SIZE].get() : nullptr;
+}
+
+// Игра по номеру для главного потока: он единственный меняет таблицу игр и читает ее без секции чтения
+Game* gameById(uint32_t gameId) {
+    return findGame(*gameTables.latest(), gameId);
+}
+
+// Создает игру из count свободных секторов; Винни-Пух прячется в случайном секторе, если winnieSector < 0
+std::shared_ptr<Game> makeGame(uint32_t gameId, int count, int winnieSector = -1) {
+    std::shared_ptr<Game> game = std::make_shared<Game>();
+    game->id = gameId;
+    game->sectorCount = count;
+    game->sectors = std::vector<Sector>(count);
+    for (int i = 0; i < count; i++) {
+        game->sectors[i].id = i;
+    }
+    game->sectorAssigner.init(count, assignmentPolicy, priorityRegions);
+
+    if (winnieSector < 0) {
+        static std::mt19937 gen(std::random_device{}());
+        std::uniform_int_distribution<> distrib(0, count - 1);
+        winnieSector = distrib(gen);
+    }
+    game->winnieSector = winnieSector;
+    return game;
+}
+
+// Публикует версию таблицы игр, в которой номер gameId занят игрой game (nullptr - игра удалена).
+// Вызывается только главным потоком
+void publishGameSlot(uint32_t gameId, std::shared_ptr<Game> game) {
+    const GameTable* current = gameTables.latest();
+    std::unique_ptr<GameTable> next(current != nullptr ? new GameTable(*current) : new GameTable());
+    next->chunks.resize(MAX_GAMES / GAME_CHUNK_SIZE);
+
+    auto& chunk = next->chunks[gameId / GAME_CHUNK_SIZE];
+    auto copy = chunk ? std::make_shared<GameChunk>(*chunk) : std::make_shared<GameChunk>(GAME_CHUNK_SIZE);
+    std::shared_ptr<Game>& slot = (*copy)[gameId % GAME_CHUNK_SIZE];
+    next->gameCount += (game ? 1 : 0) - (slot ? 1 : 0);
+    slot = std::move(game);
+    chunk = std::move(copy);
+    gameTables.publish(next.release());
+}
+
+// Ключ адреса клиента: IPv4 адрес и порт в порядке байт хоста
+uint64_t peerKey(uint32_t ip, uint16_t port) {
+    return ((uint64_t)ip << 16) | port;
+}
+
+uint64_t peerKey(const struct sockaddr_in& addr) {
+    return peerKey(ntohl(addr.sin_addr.s_addr), ntohs(addr.sin_port));
+}
+
+// Средний размер пакета для вывода статистики
+double averageBatch(unsigned long datagrams, unsigned long calls) {
+    return calls > 0 ? (double)datagrams / calls : 0.0;
+}
+
+// Отправляет все накопленные ответы одним (или несколькими при частичной отправке) вызовом sendmmsg
+void flushReplies(Worker& worker, ReplyBatch& batch) {
+    worker.metrics.sendBatch.record(batch.count);
+    int sent = 0;
+    int64_t drainDeadline = 0;
+    while (sent < batch.count) {
+        int n = sendmmsg(batch.fd, batch.msgs + sent, batch.count - sent, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // При завершении последние ответы не отбрасываются: ждем места в очереди сокета,
+            // но не дольше SHUTDOWN_DRAIN_MS. Во время работы стаи повторят запрос сами
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && !running) {
+                if (drainDeadline == 0) drainDeadline = monotonicMs() + SHUTDOWN_DRAIN_MS;
+                struct pollfd writable = {batch.fd, POLLOUT, 0};
+                int64_t left = drainDeadline - monotonicMs();
+                if (left > 0 && poll(&writable, 1, (int)left) > 0) continue;
+            }
+            perror("Ошибка sendmmsg");
+            break;
+        }
+        worker.stats.sendCalls.add(1);
+        worker.stats.sendDatagrams.add(n);
+        sent += n;
+    }
+    batch.count = 0;
+}
+
+// Ставит ответ в очередь на отправку; при заполнении пакета он сбрасывается сразу
+void queueReply(Worker& worker, ReplyBatch& batch, const struct sockaddr_in& addr, const char* msg, size_t len) {
+    if (batch.count >= batchSize) {
+        flushReplies(worker, batch);
+    }
+    if (len > MAX_REPLY_SIZE) len = MAX_REPLY_SIZE;
+
+    int i = batch.count++;
+    memcpy(batch.data[i], msg, len);
+    batch.addrs[i] = addr;
+    batch.iovs[i].iov_base = batch.data[i];
+    batch.iovs[i].iov_len = len;
+    memset(&batch.msgs[i], 0, sizeof(batch.msgs[i]));
+    batch.msgs[i].msg_hdr.msg_name = &batch.addrs[i];
+    batch.msgs[i].msg_hdr.msg_namelen = sizeof(batch.addrs[i]);
+    batch.msgs[i].msg_hdr.msg_iov = &batch.iovs[i];
+    batch.msgs[i].msg_hdr.msg_iovlen = 1;
+}
+
+// Будит все рабочие потоки, чтобы они перепроверили условие завершения
+void wakeWorkers() {
+    uint64_t one = 1;
+    if (wakeFd >= 0 && write(wakeFd, &one, sizeof(one)) < 0) {
+        perror("Ошибка пробуждения рабочих потоков");
+    }
+}
+
+// Условие продолжения работы сервера
+// Сервер работает, пока не закончена игра по умолчанию или есть созданные через управление игры
+bool serverActive() {
+    return running && (!defaultGame->allSectorsSearched || !defaultGame->winnieFoundByBees || createdGames > 0);
+}
+
+// Ключ монитора в таблице и в колесе таймеров: IPv4 адрес и порт
+uint64_t monitorKey(const struct sockaddr_in& addr) {
+    return peerKey(addr);
+}
+
+// Публикует событие с очередным порядковым номером: кладет его в очередь текущего рабочего потока.
+// record - запись состояния одного объекта в формате снимка (S:..., B:..., G:...).
+// Номер выдается в момент изменения (для стаи - под мьютексом шарда), поэтому события одного объекта
+// нумеруются в порядке изменений. Без подписчиков и многоадресной группы событие не создается:
+// новый монитор все равно начнет со снимка, прочитанного после увеличения subscriberCount
+void publishEvent(const char* record) {
+    if (subscriberCount.load() == 0 && multicastSockfd < 0) return;
+    if (workers.empty()) return;
+
+    Worker& worker = currentWorker != nullptr ? *currentWorker : *workers[0];
+    std::lock_guard<std::mutex> lock(worker.events.mutex);
+    QueuedEvent& event = worker.events.events.emplace_back();
+    event.seq = eventSequence.fetch_add(1) + 1;
+    snprintf(event.record, sizeof(event.record), "%s", record);
+}
+
+// Рассылает накопленные события мониторам в порядке номеров. Вызывается только главным потоком.
+// Событие, получившее номер, но еще не попавшее в очередь, задерживает рассылку следующих за ним
+// до следующего вызова, чтобы монитор не принял разрыв в номерах за потерю
+void flushEvents() {
+    static std::vector<QueuedEvent> pending; // Вынутые из очередей, но еще не разосланные события
+    size_t before = pending.size();
+    for (auto& w : workers) {
+        std::lock_guard<std::mutex> lock(w->events.mutex);
+        pending.insert(pending.end(), w->events.events.begin(), w->events.events.end());
+        w->events.events.clear();
+    }
+    if (pending.empty()) return;
+    if (pending.size() != before) {
+        std::sort(pending.begin(), pending.end(),
+                  [](const QueuedEvent& a, const QueuedEvent& b) { return (int32_t)(a.seq - b.seq) < 0; });
+    }
+
+    std::lock_guard<std::mutex> lock(eventMutex);
+    size_t sent = 0;
+    for (; sent < pending.size() && pending[sent].seq == sentEventSequence + 1; sent++) {
+        char event[MAX_EVENT_SIZE + 16];
+        int len = snprintf(event, sizeof(event), "EVENT:%u:%s", pending[sent].seq, pending[sent].record);
+        sentEventSequence = pending[sent].seq;
+
+        // С многоадресной группой событие отправляется один раз независимо от числа мониторов
+        if (multicastSockfd >= 0) {
+            sendto(multicastSockfd, event, len, 0, (struct sockaddr*)&multicastAddr, sizeof(multicastAddr));
+        } else if (monitorSockfd >= 0) {
+            for (const auto& addr : subscribers) {
+                sendto(monitorSockfd, event, len, 0, (struct sockaddr*)&addr, sizeof(addr));
+            }
+        }
+    }
+    pending.erase(pending.begin(), pending.begin() + sent);
+}
+
+// Записи состояния, общие для снимка и событий. Мониторы показывают игру по умолчанию
+int formatSectorRecord(char* buf, size_t size, int sectorId) {
+    return snprintf(buf, size, "S:%d:%d", sectorId, defaultGame->sectors[sectorId].winnieFound ? 1 : 0);
+}
+
+int formatSwarmRecord(char* buf, size_t size, const BeeSwarm& swarm) {
+    return snprintf(buf, size, "B:%d:%d:%d:%d", swarm.id, swarm.currentSector,
+                    swarm.active ? 1 : 0, swarm.disconnected ? 1 : 0);
+}
+
+int formatGameRecord(char* buf, size_t size) {
+    return snprintf(buf, size, "G:%d:%d", defaultGame->winnieFoundByBees ? 1 : 0, defaultGame->allSectorsSearched ? 1 : 0);
+}
+
+// Событие "сектор исследован"
+void publishSector(int sectorId) {
+    char record[MAX_EVENT_SIZE];
+    formatSectorRecord(record, sizeof(record), sectorId);
+    publishEvent(record);
+}
+
+// Событие изменения состояния стаи. Вызывается под мьютексом шарда, чтобы события
+// одной стаи шли в порядке изменений; заодно отмечает шард для следующего снимка
+void publishSwarm(const BeeSwarm& swarm) {
+    shardFor(swarmKey(swarm)).version.fetch_add(1, std::memory_order_relaxed);
+    if (swarm.gameId != BEE_DEFAULT_GAME) return;
+
+    char record[MAX_EVENT_SIZE];
+    formatSwarmRecord(record, sizeof(record), swarm);
+    publishEvent(record);
+}
+
+// Событие изменения общего статуса игры
+void publishGame() {
+    char record[MAX_EVENT_SIZE];
+    formatGameRecord(record, sizeof(record));
+    publishEvent(record);
+}
+
+// Удаляет монитор из подписчиков потока событий
+void unsubscribeMonitor(uint64_t key) {
+    std::lock_guard<std::mutex> lock(eventMutex);
+    for (auto it = subscribers.begin(); it != subscribers.end(); ++it) {
+        if (monitorKey(*it) == key) {
+            subscribers.erase(it);
+            subscriberCount.store((int)subscribers.size());
+            break;
+        }
+    }
+}
+
+// Подписывает монитор на события и отправляет ему снимок состояния, разбитый на датаграммы
+// SNAPSHOT:<номер>:<часть>:<всего частей>:<записи через ';'>
+void sendSnapshot(const struct sockaddr_in& addr) {
+    // Номер снимка берется до чтения состояния: изменения с меньшими номерами уже видны в таблицах,
+    // а события с большими номерами монитор получит как подписчик и применит поверх снимка
+    uint32_t seq;
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        seq = eventSequence.load();
+
+        // Подписчики многоадресной группы получают события из группы
+        uint64_t key = monitorKey(addr);
+        bool subscribed = false;
+        for (const auto& subscriber : subscribers) {
+            if (monitorKey(subscriber) == key) subscribed = true;
+        }
+        if (!subscribed && multicastSockfd < 0) {
+            subscribers.push_back(addr);
+            subscriberCount.store((int)subscribers.size());
+        }
+    }
+
+    std::vector<std::string> chunks(1);
+    char record[MAX_EVENT_SIZE];
+    auto append = [&chunks, &record](int len) {
+        if (chunks.back().size() + len + 1 > SNAPSHOT_CHUNK_SIZE) chunks.emplace_back();
+        chunks.back().append(record, len);
+        chunks.back() += ';';
+    };
+
+    // В снимок попадают только исследованные секторы: остальные монитор считает неисследованными
+    append(formatGameRecord(record, sizeof(record)));
+    for (int i = 0; i < defaultGame->sectorCount; i++) {
+        if (defaultGame->sectors[i].searched) append(formatSectorRecord(record, sizeof(record), i));
+    }
+    for (int s = 0; s < workerCount; s++) {
+        std::lock_guard<std::mutex> lock(swarmShards[s].mutex);
+        for (const auto& [key, swarm] : swarmShards[s].swarms) {
+            if (swarm.gameId == BEE_DEFAULT_GAME) append(formatSwarmRecord(record, sizeof(record), swarm));
+        }
+    }
+
+    std::string datagram;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        char header[64];
+        int len = snprintf(header, sizeof(header), "SNAPSHOT:%u:%zu:%zu:", seq, i, chunks.size());
+        datagram.assign(header, len);
+        datagram += chunks[i];
+        sendto(monitorSockfd, datagram.data(), datagram.size(), 0, (struct sockaddr*)&addr, sizeof(addr));
+    }
+}
+
+// Захватывает свободный сектор игры для стаи, находящейся в секторе from, или возвращает -1
+int acquireSector(Game& game, unsigned hint, int from) {
+    while (true) {
+        int sectorId = game.sectorAssigner.acquire(hint, from);
+        if (sectorId < 0) return -1;
+
+        // Сектор мог быть исследован уже после возврата в пул - выбрасываем его
+        if (game.sectors[sectorId].searched) continue;
+
+        game.sectors[sectorId].holders = 1;
+        return sectorId;
+    }
+}
+
+// Возвращает назначенный, но не исследованный сектор в пул свободных
+void releaseSector(Game& game, int sectorId) {
+    if (sectorId < 0 || sectorId >= game.sectorCount) return;
+    Sector& sector = game.sectors[sectorId];
+    uint8_t holders = sector.holders.load();
+    while (holders > 0 && !sector.holders.compare_exchange_weak(holders, holders - 1)) {
+    }
+    // Сектор возвращается в пул, только когда его отпустил последний держатель
+    if (holders == 1 && !sector.searched) {
+        game.sectorAssigner.release(sectorId);
+    }
+}
+
+// Учитывает перелет стаи к выданному сектору и оценку стоимости его поиска
+void recordAssignment(Game& game, int from, int sectorId) {
+    const ForestGrid& grid = game.sectorAssigner.grid();
+    if (game.firstAssignMs.load(std::memory_order_relaxed) == 0) {
+        int64_t expected = 0;
+        game.firstAssignMs.compare_exchange_strong(expected, monotonicMs());
+    }
+    game.assignedSectors.fetch_add(1, std::memory_order_relaxed);
+    game.flightDistance.fetch_add((uint64_t)(grid.distance(from, sectorId) * 1000), std::memory_order_relaxed);
+    game.searchCost.fetch_add(grid.cost(sectorId), std::memory_order_relaxed);
+}
+
+// Запоминает время окончания игры при первой находке Винни-Пуха или исследовании всех секторов
+void recordGameFinish(Game& game) {
+    int64_t expected = 0;
+    game.finishMs.compare_exchange_strong(expected, monotonicMs());
+}
+
+// Длительность игры от первой выдачи сектора до окончания (или до текущего момента), мс
+int64_t gameDurationMs(const Game& game) {
+    int64_t start = game.firstAssignMs.load();
+    if (start == 0) return 0;
+    int64_t finish = game.finishMs.load();
+    return (finish != 0 ? finish : monotonicMs()) - start;
+}
+
+// Отмечает сектор как исследованный. Журнал и мониторы ведут только игру по умолчанию.
+// Возвращает true для первого отчета о секторе
+bool markSectorSearched(Game& game, int sectorId, bool winnieInSector) {
+    if (sectorId < 0 || sectorId >= game.sectorCount) return false;
+    Sector& sector = game.sectors[sectorId];
+    if (winnieInSector) {
+        sector.winnieFound = true;
+    }
+    if (sector.searched.exchange(true)) return false;
+    game.searchedSectorsCount++;
+    if (game.id == BEE_DEFAULT_GAME) {
+        journal.append(WAL_SEARCHED, -1, sectorId, 0, winnieInSector ? WAL_FLAG_WINNIE : 0);
+        publishSector(sectorId);
+    }
+    return true;
+}
+
+// Учитывает время поиска одного сектора в скользящем среднем игры. Гонка потоков лишь теряет замер
+void recordSearchTime(Game& game, int64_t searchUs) {
+    int64_t average = game.averageSearchUs.load(std::memory_order_relaxed);
+    average = average == 0 ? searchUs : average + (searchUs - average) / SEARCH_TIME_SMOOTHING;
+    game.averageSearchUs.store(std::max<int64_t>(1, average), std::memory_order_relaxed);
+}
+
+// Выдает простаивающей стае requester копию давно арендованного сектора или возвращает -1.
+// Вызывается под мьютексом шарда стаи requester
+int takeStraggler(Game& game, uint64_t requester) {
+    std::lock_guard<std::mutex> lock(game.speculationMutex);
+    while (!game.stragglers.empty()) {
+        Straggler straggler = game.stragglers.back();
+        game.stragglers.pop_back();
+        if (straggler.holder == requester) continue;
+
+        // Сектор могли исследовать, вернуть в пул или уже выдать повторно после обновления списка
+        Sector& sector = game.sectors[straggler.sectorId];
+        uint8_t expected = 1;
+        if (sector.searched || !sector.holders.compare_exchange_strong(expected, 2)) continue;
+        sector.speculated = true;
+        game.speculations[straggler.sectorId] = {straggler.holder, requester};
+        game.speculativeAssigned++;
+        return straggler.sectorId;
+    }
+    return -1;
+}
+
+// Завершает гонку копий сектора, о котором стая winner отчиталась первой. Возвращает true и ключ
+// стаи, чей поиск нужно отменить, в *loser. Вызывается под мьютексом шарда стаи winner
+bool settleSpeculation(Game& game, int sectorId, uint64_t winner, uint64_t* loser) {
+    std::lock_guard<std::mutex> lock(game.speculationMutex);
+    auto it = game.speculations.find(sectorId);
+    if (it == game.speculations.end()) return false;
+    SpeculativeCopy copy = it->second;
+    game.speculations.erase(it);
+    game.sectors[sectorId].speculated = false;
+
+    if (winner == copy.copy) {
+        game.speculativeWins++;
+        *loser = copy.original;
+        return true;
+    }
+    if (winner == copy.original) {
+        game.speculativeLosses++;
+        *loser = copy.copy;
+        return true;
+    }
+    return false;
+}
+
+// Записывает изменение стаи в журнал. Вызывается под мьютексом шарда, поэтому
+// номера записей одной стаи идут в порядке ее изменений
+void journalSwarm(BeeSwarm& swarm, uint8_t type, int32_t value = 0) {
+    if (!journal.enabled() || swarm.gameId != BEE_DEFAULT_GAME) return;
+    swarm.walSequence = journal.append(type, swarm.id, value, swarm.port, swarm.binary ? WAL_FLAG_BINARY : 0);
+}
+
+// Обновляет срок аренды и видимое состояние поиска после изменения списка арендованных секторов.
+// Вызывается под мьютексом шарда
+void updateLease(SwarmShard& shard, BeeSwarm& swarm) {
+    swarm.searchInProgress = swarm.leaseCount > 0;
+    swarm.currentSector = swarm.leaseCount > 0 ? swarm.lease[0] : -1;
+    if (swarm.leaseCount > 0) {
+        shard.leases.schedule(swarmKey(swarm), monotonicMs() + (int64_t)swarm.leaseCount * SECTOR_LEASE_TIMEOUT * 1000);
+    } else {
+        shard.leases.cancel(swarmKey(swarm));
+    }
+}
+
+// Возвращает в пул все арендованные стаей и не исследованные секторы. Вызывается под мьютексом шарда
+void releaseLease(Game& game, SwarmShard& shard, BeeSwarm& swarm) {
+    if (swarm.leaseCount > 0) journalSwarm(swarm, WAL_LEASE_CLEAR);
+    for (int i = 0; i < swarm.leaseCount; i++) {
+        releaseSector(game, swarm.lease[i]);
+    }
+    swarm.leaseCount = 0;
+    updateLease(shard, swarm);
+}
+
+// Исключает исследованный сектор из аренды стаи. Вызывается под мьютексом шарда.
+// Возвращает false, если сектора в аренде не было
+bool removeFromLease(BeeSwarm& swarm, int sectorId) {
+    for (int i = 0; i < swarm.leaseCount; i++) {
+        if (swarm.lease[i] == sectorId) {
+            std::copy(swarm.lease + i + 1, swarm.lease + swarm.leaseCount, swarm.lease + i);
+            swarm.leaseCount--;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Ставит в очередь уведомление стае в формате, которым она пользуется
+void queueSwarmNotice(Worker& worker, const BeeSwarm& swarm, uint8_t type, int32_t sectorId = -1) {
+    struct sockaddr_in clientAddr;
+    memset(&clientAddr, 0, sizeof(clientAddr));
+    clientAddr.sin_family = AF_INET;
+    clientAddr.sin_addr.s_addr = htonl(swarm.ip);
+    clientAddr.sin_port = htons(swarm.port);
+
+    BeeMessage notice;
+    notice.type = type;
+    notice.binary = swarm.binary;
+    notice.swarmId = swarm.id;
+    notice.gameId = swarm.gameId;
+    notice.sectorId = sectorId;
+    if (beeLoss.drop()) return;
+
+    char data[BEE_MAX_MESSAGE_SIZE];
+    size_t len = encodeBeeMessage(notice, data);
+    queueReply(worker, worker.beeReplies, clientAddr, data, len);
+}
+
+// Функция для отправки сообщения о завершении всем клиентам
+void notifyClientsServerShutdown(Worker& worker) {
+    if (worker.sockfd < 0 || monitorSockfd < 0) return;
+
+    // Отправляем сообщение всем пчёлам
+    for (int s = 0; s < workerCount; s++) {
+        std::lock_guard<std::mutex> lock(swarmShards[s].mutex);
+        for (const auto& [key, swarm] : swarmShards[s].swarms) {
+            if (!swarm.disconnected && swarm.active) {
+                queueSwarmNotice(worker, swarm, MSG_SERVER_SHUTDOWN);
+                logEvent(LOG_DEBUG, "Сервер: Отправлен сигнал завершения стае #%d", swarm.id);
+            }
+        }
+    }
+
+    // Отправляем сообщение всем мониторам: подписчикам группы - одной датаграммой в группу
+    {
+        std::lock_guard<std::mutex> monLock(monitorsMutex);
+        if (multicastSockfd >= 0) {
+            char shutdownMsg[] = "SERVER_SHUTDOWN";
+            sendto(multicastSockfd, shutdownMsg, strlen(shutdownMsg), 0, (struct sockaddr*)&multicastAddr, sizeof(multicastAddr));
+            logEvent(LOG_INFO, "Сервер: Отправлен сигнал завершения в многоадресную группу");
+        }
+        for (const auto& [key, monitor] : monitors) {
+            if (monitor.subscribed && multicastSockfd >= 0) continue;
+
+            struct sockaddr_in monitorAddr;
+            memset(&monitorAddr, 0, sizeof(monitorAddr));
+            monitorAddr.sin_family = AF_INET;
+            monitorAddr.sin_addr.s_addr = inet_addr(monitor.ip.c_str());
+            monitorAddr.sin_port = htons(monitor.port);
+
+            char shutdownMsg[] = "SERVER_SHUTDOWN";
+            queueReply(worker, worker.monitorReplies, monitorAddr, shutdownMsg, strlen(shutdownMsg));
+            logEvent(LOG_INFO, "Сервер: Отправлен сигнал завершения монитору с %a:%d", (uint32_t)(key >> 16), monitor.port);
+        }
+    }
+
+    // Ответы уходят в очереди сокетов до выхода: ждать клиентов после этого не нужно
+    flushReplies(worker, worker.beeReplies);
+    flushReplies(worker, worker.monitorReplies);
+}
+
+// Функция для отправки сообщения о нахождении Винни-Пуха всем стаям игры
+void notifyAllSwarmsWinnieFound(Worker& worker, Game& game) {
+    if (worker.sockfd < 0) return;
+
+    for (int s = 0; s < workerCount; s++) {
+        std::lock_guard<std::mutex> lock(swarmShards[s].mutex);
+        for (auto& [key, swarm] : swarmShards[s].swarms) {
+            // Отправляем сообщение о находке, если стая не является той, которая нашла Винни-Пуха
+            if (swarm.gameId == game.id && !swarm.disconnected && swarm.active && swarm.searchInProgress) {
+                queueSwarmNotice(worker, swarm, MSG_WINNIE_FOUND);
+                logEvent(LOG_DEBUG, "Сервер: Отправлено уведомление о находке Винни-Пуха стае #%d", swarm.id);
+
+                // Освобождаем арендованные, но не исследованные секторы
+                releaseLease(game, swarmShards[s], swarm);
+                publishSwarm(swarm);
+            }
+        }
+    }
+}
+
+// Отменяет поиск проигравшей копии сектора: сектор убирается из аренды стаи key,
+// а стая получает CANCEL и может сразу запросить следующий сектор
+void cancelSpeculativeCopy(Worker& worker, uint64_t key, int sectorId) {
+    SwarmShard& shard = shardFor(key);
+    std::unique_lock<std::mutex> lock = lockShard(worker, shard);
+    BeeSwarm* swarm = shard.swarms.find(key);
+    if (swarm == nullptr || swarm->disconnected || !removeFromLease(*swarm, sectorId)) return;
+    updateLease(shard, *swarm);
+    publishSwarm(*swarm);
+    if (swarm->binary) queueSwarmNotice(worker, *swarm, MSG_CANCEL, sectorId);
+    logEvent(LOG_DEBUG, "Сервер: Стае #%d отменен поиск в секторе %d, его уже исследовала другая стая", swarm->id, sectorId);
+}
+
+// Функция для проверки активности клиентов: срабатывают только истекшие таймеры колеса
+void checkClientsActivity() {
+    int64_t now = monotonicMs();
+
+    // Проверяем активность пчёл
+    for (int s = 0; s < workerCount; s++) {
+        SwarmShard& shard = swarmShards[s];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        shard.liveness.advance(now, [&shard](uint64_t key) {
+            BeeSwarm* found = shard.swarms.find(key);
+            if (found == nullptr) return;
+            BeeSwarm& swarm = *found;
+            Game* game = gameById(swarm.gameId);
+            if (game == nullptr || swarm.disconnected || !swarm.active) return;
+
+            logEvent(LOG_WARN, "Сервер: Стая #%d не отвечает и будет помечена как отключенная", swarm.id);
+            swarm.disconnected = true;
+            swarm.active = false;
+
+            // Освобождаем секторы, если стая находилась в поиске
+            releaseLease(*game, shard, swarm);
+            journalSwarm(swarm, WAL_SWARM_LEAVE);
+            publishSwarm(swarm);
+        });
+
+        // Неисследованные секторы с истекшей арендой возвращаются в пул
+        shard.leases.advance(now, [&shard](uint64_t key) {
+            BeeSwarm* swarm = shard.swarms.find(key);
+            Game* game = swarm != nullptr ? gameById(swarm->gameId) : nullptr;
+            if (game == nullptr || swarm->leaseCount == 0) return;
+
+            logEvent(LOG_WARN, "Сервер: Аренда стаи #%d истекла, в пул возвращено секторов: %d", swarm->id, swarm->leaseCount);
+            releaseLease(*game, shard, *swarm);
+            publishSwarm(*swarm);
+        });
+    }
+
+    // Проверяем активность мониторов
+    {
+        std::lock_guard<std::mutex> lock(monitorsMutex);
+        monitorLiveness.advance(now, [](uint64_t key) {
+            auto it = monitors.find(key);
+            if (it == monitors.end()) return;
+            logEvent(LOG_WARN, "Сервер: Монитор с %a:%d не отвечает и будет удален", (uint32_t)(key >> 16), (int)(key & 0xFFFF));
+            monitors.erase(it);
+            unsubscribeMonitor(key);
+        });
+    }
+}
+
+// Ключ стаи из аргумента команды управления: <стая> или <стая>:<игра>
+uint64_t parseSwarmArgument(const std::string& argument) {
+    int swarmId = std::stoi(argument);
+    size_t colon = argument.find(':');
+    uint32_t gameId = colon == std::string::npos ? BEE_DEFAULT_GAME : (uint32_t)strtoul(argument.c_str() + colon + 1, nullptr, 10);
+    return swarmKey(gameId, swarmId);
+}
+
+// Свободный номер для новой игры или BEE_DEFAULT_GAME, если игр уже MAX_GAMES. Только главный поток
+uint32_t allocateGameId() {
+    const GameTable& table = *gameTables.latest();
+    for (int attempt = 0; attempt < MAX_GAMES; attempt++) {
+        uint32_t gameId = nextGameId;
+        nextGameId = nextGameId + 1 < MAX_GAMES ? nextGameId + 1 : 1;
+        if (findGame(table, gameId) == nullptr) return gameId;
+    }
+    return BEE_DEFAULT_GAME;
+}
+
+// Удаляет игру и все ее стаи; возвращает количество удаленных стай. Только главный поток.
+// Рабочий поток, который еще видит игру в старой версии таблицы, проверяет closed под мьютексом
+// шарда и не добавит стаю после того, как шард уже очищен
+int destroyGame(Game& game) {
+    game.closed = true;
+    int removed = 0;
+    std::vector<uint64_t> keys;
+    for (int s = 0; s < workerCount; s++) {
+        SwarmShard& shard = swarmShards[s];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        keys.clear();
+        for (const auto& [key, swarm] : shard.swarms) {
+            if (swarm.gameId == game.id) keys.push_back(key);
+        }
+        for (uint64_t key : keys) {
+            BeeSwarm& swarm = *shard.swarms.find(key);
+            if (swarm.port != 0) {
+                std::lock_guard<std::mutex> addressLock(addressMutex);
+                uint64_t* owner = swarmsByAddress.find(peerKey(swarm.ip, swarm.port));
+                if (owner != nullptr && *owner == key) swarmsByAddress.erase(peerKey(swarm.ip, swarm.port));
+            }
+            shard.liveness.cancel(key);
+            shard.leases.cancel(key);
+            shard.swarms.erase(key);
+        }
+        if (!keys.empty()) shard.version.fetch_add(1, std::memory_order_relaxed);
+        removed += keys.size();
+    }
+
+    publishGameSlot(game.id, nullptr); // Объект игры может быть освобожден уже здесь
+    createdGames--;
+    return removed;
+}
+
+// Сумма метрик всех рабочих потоков на момент запроса
+struct MetricsTotals {
+    HistogramTotals handling[METRIC_MESSAGE_TYPES];
+    HistogramTotals messages; // Все типы сообщений вместе
+    HistogramTotals lockWait;
+    HistogramTotals recvBatch;
+    HistogramTotals sendBatch;
+    HistogramTotals epollEvents;
+    unsigned long malformed = 0;
+    unsigned long lockAcquired = 0;
+};
+
+// Очередь приема сокета (SO_MEMINFO): память, занятая датаграммами, и датаграммы, отброшенные при переполнении
+struct SocketQueue {
+    unsigned long bytes = 0;
+    unsigned long drops = 0;
+};
+
+// Выгрузка METRICS_TEXT, разбитая на страницы по целым строкам. Хранится до следующего запроса
+// выгрузки, чтобы все страницы относились к одному моменту. Используется только главным потоком
+struct MetricsExport {
+    uint32_t generation = 0;
+    std::vector<std::string> pages;
+};
+
+MetricsExport metricsExport;
+
+// Складывает метрики рабочих потоков. Потоки продолжают писать во время чтения,
+// поэтому сумма - мгновенный снимок с точностью до нескольких последних замеров
+std::unique_ptr<MetricsTotals> collectMetrics() {
+    std::unique_ptr<MetricsTotals> totals(new MetricsTotals());
+    for (const auto& w : workers) {
+        const WorkerMetrics& metrics = w->metrics;
+        for (int type = 0; type < METRIC_MESSAGE_TYPES; type++) totals->handling[type].add(metrics.handling[type]);
+        totals->lockWait.add(metrics.lockWait);
+        totals->recvBatch.add(metrics.recvBatch);
+        totals->sendBatch.add(metrics.sendBatch);
+        totals->epollEvents.add(metrics.epollEvents);
+        totals->malformed += metrics.malformed.get();
+        totals->lockAcquired += metrics.lockAcquired.get();
+    }
+    for (int type = 0; type < METRIC_MESSAGE_TYPES; type++) totals->messages.add(totals->handling[type]);
+    return totals;
+}
+
+SocketQueue socketQueue(int fd) {
+    SocketQueue queue;
+    uint32_t meminfo[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(meminfo);
+    if (getsockopt(fd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0) {
+        queue.bytes = meminfo[SK_MEMINFO_RMEM_ALLOC];
+        queue.drops = meminfo[SK_MEMINFO_DROPS];
+    }
+    return queue;
+}
+
+// Ответ на METRICS: сводка одной строкой, задержки в микросекундах
+std::string metricsSummary() {
+    std::unique_ptr<MetricsTotals> totals = collectMetrics();
+    SocketQueue queued;
+    for (const auto& w : workers) {
+        SocketQueue queue = socketQueue(w->sockfd);
+        queued.bytes += queue.bytes;
+        queued.drops += queue.drops;
+    }
+
+    char summary[512];
+    snprintf(summary, sizeof(summary), "METRICS:%lu:%lu:%.1f:%.1f:%.1f:%lu:%lu:%.1f:%.2f:%lu:%lu:%lu",
+             totals->messages.count, totals->malformed,
+             totals->messages.percentile(0.5) / 1000.0, totals->messages.percentile(0.99) / 1000.0,
+             totals->messages.percentile(0.999) / 1000.0,
+             totals->lockAcquired, totals->lockWait.count, totals->lockWait.percentile(0.99) / 1000.0,
+             averageBatch(totals->recvBatch.sum, totals->recvBatch.count),
+             queued.bytes, queued.drops, journal.pendingCount());
+    return summary;
+}
+
+// Добавляет гистограмму в текстовом формате Prometheus. Границы le - 2^k - 1 для k от fromBits
+// до toBits: это границы интервалов гистограммы, поэтому накопленные количества точные.
+// scale переводит значения в единицы метрики (наносекунды в секунды)
+void appendHistogram(std::string& out, const char* name, const std::string& labels,
+                     const HistogramTotals& histogram, int fromBits, int toBits, double scale) {
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    std::string braces = labels.empty() ? "" : "{" + labels + "}";
+    char line[256];
+    for (int bits = fromBits; bits <= toBits; bits++) {
+        uint64_t limit = ((uint64_t)1 << bits) - 1;
+        snprintf(line, sizeof(line), "%s_bucket{%sle=\"%.10g\"} %lu\n", name, prefix.c_str(), limit * scale, histogram.countUpTo(limit));
+        out += line;
+    }
+    snprintf(line, sizeof(line), "%s_bucket{%sle=\"+Inf\"} %lu\n%s_sum%s %.9g\n%s_count%s %lu\n",
+             name, prefix.c_str(), histogram.count, name, braces.c_str(), histogram.sum * scale,
+             name, braces.c_str(), histogram.count);
+    out += line;
+}
+
+void appendMetric(std::string& out, const char* name, const char* type, const char* help) {
+    out += std::string("# HELP ") + name + " " + help + "\n# TYPE " + name + " " + type + "\n";
+}
+
+void appendValue(std::string& out, const char* name, const std::string& labels, unsigned long value) {
+    out += std::string(name) + (labels.empty() ? "" : "{" + labels + "}") + " " + std::to_string(value) + "\n";
+}
+
+// Полная выгрузка метрик в текстовом формате Prometheus
+std::string metricsText(Worker& worker) {
+    std::unique_ptr<MetricsTotals> totals = collectMetrics();
+    std::string out;
+
+    appendMetric(out, "bee_messages_total", "counter", "Сообщения пчел по типам");
+    for (int type = 0; type < METRIC_MESSAGE_TYPES; type++) {
+        if (totals->handling[type].count == 0) continue;
+        appendValue(out, "bee_messages_total", std::string("type=\"") + beeMessageName(type) + "\"", totals->handling[type].count);
+    }
+    appendMetric(out, "bee_malformed_datagrams_total", "counter", "Датаграммы пчел, которые не удалось разобрать");
+    appendValue(out, "bee_malformed_datagrams_total", "", totals->malformed);
+
+    appendMetric(out, "bee_message_handling_seconds", "histogram", "Время обработки сообщения пчелы");
+    for (int type = 0; type < METRIC_MESSAGE_TYPES; type++) {
+        if (totals->handling[type].count == 0) continue;
+        appendHistogram(out, "bee_message_handling_seconds", std::string("type=\"") + beeMessageName(type) + "\"",
+                        totals->handling[type], 10, 32, 1e-9);
+    }
+
+    appendMetric(out, "bee_shard_lock_acquisitions_total", "counter", "Захваты мьютексов шардов рабочими потоками");
+    appendValue(out, "bee_shard_lock_acquisitions_total", "", totals->lockAcquired);
+    appendMetric(out, "bee_shard_lock_wait_seconds", "histogram", "Ожидание занятого мьютекса шарда");
+    appendHistogram(out, "bee_shard_lock_wait_seconds", "", totals->lockWait, 10, 32, 1e-9);
+
+    appendMetric(out, "bee_recv_batch_datagrams", "histogram", "Датаграммы, вычитанные одним вызовом recvmmsg");
+    appendHistogram(out, "bee_recv_batch_datagrams", "", totals->recvBatch, 1, 9, 1);
+    appendMetric(out, "bee_send_batch_datagrams", "histogram", "Ответы, отправленные одним вызовом sendmmsg");
+    appendHistogram(out, "bee_send_batch_datagrams", "", totals->sendBatch, 1, 9, 1);
+    appendMetric(out, "bee_epoll_events", "histogram", "События за одно пробуждение epoll_wait");
+    appendHistogram(out, "bee_epoll_events", "", totals->epollEvents, 1, 5, 1);
+
+    appendMetric(out, "bee_socket_receive_queue_bytes", "gauge", "Память, занятая датаграммами в очереди сокета пчел");
+    std::vector<SocketQueue> queues;
+    for (const auto& w : workers) queues.push_back(socketQueue(w->sockfd));
+    for (size_t i = 0; i < queues.size(); i++) {
+        appendValue(out, "bee_socket_receive_queue_bytes", "worker=\"" + std::to_string(i) + "\"", queues[i].bytes);
+    }
+    appendMetric(out, "bee_socket_drops_total", "counter", "Датаграммы, отброшенные при переполнении очереди сокета пчел");
+    for (size_t i = 0; i < queues.size(); i++) {
+        appendValue(out, "bee_socket_drops_total", "worker=\"" + std::to_string(i) + "\"", queues[i].drops);
+    }
+
+    appendMetric(out, "bee_housekeeping_missed_ticks_total", "counter", "Тики обслуживания, пропущенные из-за занятости главного потока");
+    appendValue(out, "bee_housekeeping_missed_ticks_total", "", missedTicks.get());
+    appendMetric(out, "bee_wal_pending_records", "gauge", "Записи журнала, еще не забранные фоновым потоком");
+    appendValue(out, "bee_wal_pending_records", "", journal.pendingCount());
+    appendMetric(out, "bee_wal_dropped_records_total", "counter", "Записи журнала, потерянные при переполнении кольца");
+    appendValue(out, "bee_wal_dropped_records_total", "", journal.droppedCount());
+
+    SnapshotDomain<HiveSnapshot, MAX_WORKERS>::ReadGuard snapshot(hiveSnapshots, worker.index);
+    appendMetric(out, "bee_swarms", "gauge", "Стаи игры по умолчанию");
+    appendValue(out, "bee_swarms", "state=\"total\"", snapshot->totalSwarms);
+    appendValue(out, "bee_swarms", "state=\"active\"", snapshot->activeSwarms);
+    appendValue(out, "bee_swarms", "state=\"disconnected\"", snapshot->disconnectedSwarms);
+    appendMetric(out, "bee_games", "gauge", "Игры сервера, включая игру по умолчанию");
+    appendValue(out, "bee_games", "", createdGames.load() + 1);
+    return out;
+}
+
+// Делит выгрузку на страницы не больше METRICS_PAGE_SIZE, не разрывая строки
+std::vector<std::string> splitMetricsPages(const std::string& text) {
+    std::vector<std::string> pages(1);
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        end = end == std::string::npos ? text.size() : end + 1;
+        if (!pages.back().empty() && pages.back().size() + (end - begin) > METRICS_PAGE_SIZE) pages.emplace_back();
+        pages.back().append(text, begin, end - begin);
+        begin = end;
+    }
+    return pages;
+}
+
+// Условия выборки LIST_BEES
+struct SwarmFilter {
+    bool hasCursor = false;
+    int cursor = 0; // Выдаются стаи с номером больше курсора
+    bool activeOnly = false;
+    bool disconnectedOnly = false;
+    int sectorFrom = INT_MIN; // Текущий сектор стаи в диапазоне (-1 - стая в улье)
+    int sectorTo = INT_MAX;
+    bool bySeen = false;
+    long seenFrom = 0; // Секунды с последнего контакта в диапазоне
+    long seenTo = LONG_MAX;
+    int limit = LIST_PAGE_SWARMS;
 };
 
-// Структура для хранения информации о мониторе
-struct Monitor {
-    std::string ip;
-    int port;
-    time_t lastSeen; // Время последнего контакта
-    
-    // Перегрузка оператора для использования в set
-    bool operator<(const Monitor& other) const {
-        if (ip != other.ip) return ip < other.ip;
-        return port < other.port;
+// Разбирает диапазон <от>-<до>, любая граница может отсутствовать. Минус в начале - знак
+// нижней границы, поэтому стаи в улье (сектор -1) выбираются диапазоном "-1--1"
+bool parseRange(const std::string& text, long& from, long& to) {
+    size_t split = text.find('-', 1); // Первый символ может быть знаком нижней границы
+    if (split == std::string::npos) split = text.find('-'); // "-5" - только верхняя граница
+    if (split == std::string::npos) return false;
+    std::string low = text.substr(0, split), high = text.substr(split + 1);
+    char* end = nullptr;
+    if (!low.empty()) {
+        from = strtol(low.c_str(), &end, 10);
+        if (*end != '\0') return false;
+    }
+    if (!high.empty()) {
+        to = strtol(high.c_str(), &end, 10);
+        if (*end != '\0') return false;
+    }
+    return from <= to;
+}
+
+// Разбирает аргументы LIST_BEES: [<курсор>][:ACTIVE][:DISCONNECTED][:SECTOR=<от>-<до>][:SEEN=<от>-<до>][:LIMIT=<стай>]
+bool parseSwarmFilter(const std::string& args, SwarmFilter& filter) {
+    std::istringstream stream(args);
+    std::string token;
+    bool first = true;
+    while (std::getline(stream, token, ':')) {
+        char* end = nullptr;
+        if (first && !token.empty() && (isdigit((unsigned char)token[0]) || token[0] == '-')) {
+            long cursor = strtol(token.c_str(), &end, 10);
+            if (*end != '\0' || cursor < INT_MIN || cursor > INT_MAX) return false;
+            filter.hasCursor = true;
+            filter.cursor = (int)cursor;
+        } else if (token == "ACTIVE") {
+            filter.activeOnly = true;
+        } else if (token == "DISCONNECTED") {
+            filter.disconnectedOnly = true;
+        } else if (token.compare(0, 7, "SECTOR=") == 0) {
+            long from = INT_MIN, to = INT_MAX;
+            if (!parseRange(token.substr(7), from, to)) return false;
+            filter.sectorFrom = (int)std::max<long>(from, INT_MIN);
+            filter.sectorTo = (int)std::min<long>(to, INT_MAX);
+        } else if (token.compare(0, 5, "SEEN=") == 0) {
+            if (!parseRange(token.substr(5), filter.seenFrom, filter.seenTo)) return false;
+            filter.bySeen = true;
+        } else if (token.compare(0, 6, "LIMIT=") == 0) {
+            long limit = strtol(token.c_str() + 6, &end, 10);
+            if (*end != '\0' || limit < 1) return false;
+            filter.limit = (int)std::min<long>(limit, LIST_MAX_PAGE_SWARMS);
+        } else if (!token.empty()) {
+            return false;
+        }
+        first = false;
+    }
+    return true;
+}
+
+// Страница LIST_BEES: стаи игры по умолчанию с номером больше курсора по возрастанию номера.
+// Отсортированные списки шардов из снимка сливаются на лету, полный список не строится.
+// За страницу просматривается не больше LIST_SCAN_LIMIT стай, поэтому и при редко выполняемом
+// фильтре ответ ограничен по времени; курсор в ответе продолжает просмотр с места остановки.
+// Снимок не обновляется на каждый сигнал активности, поэтому время последнего контакта
+// читается из таблицы шарда - только для стай, прошедших остальные условия
+std::string listBeesPage(Worker& worker, const SwarmFilter& filter) {
+    SnapshotDomain<HiveSnapshot, MAX_WORKERS>::ReadGuard snapshot(hiveSnapshots, worker.index);
+    const auto& shards = snapshot->shards;
+    std::vector<size_t> positions(shards.size());
+    for (size_t s = 0; s < shards.size(); s++) {
+        const std::vector<SwarmView>& views = *shards[s];
+        positions[s] = !filter.hasCursor ? 0 :
+            std::upper_bound(views.begin(), views.end(), filter.cursor,
+                             [](int id, const SwarmView& view) { return id < view.id; }) - views.begin();
+    }
+
+    std::string entries;
+    int listed = 0, scanned = 0;
+    int lastScanned = filter.cursor;
+    bool more = false;
+    time_t now = time(nullptr);
+    while (true) {
+        // Следующая по номеру стая среди голов списков шардов
+        int best = -1;
+        for (size_t s = 0; s < shards.size(); s++) {
+            if (positions[s] < shards[s]->size() &&
+                (best < 0 || (*shards[s])[positions[s]].id < (*shards[best])[positions[best]].id)) {
+                best = s;
+            }
+        }
+        if (best < 0) break;
+        if (listed >= filter.limit || scanned >= LIST_SCAN_LIMIT) {
+            more = true;
+            break;
+        }
+        const SwarmView& view = (*shards[best])[positions[best]++];
+        scanned++;
+        lastScanned = view.id;
+
+        if (filter.activeOnly && !view.active) continue;
+        if (filter.disconnectedOnly && !view.disconnected) continue;
+        if (view.currentSector < filter.sectorFrom || view.currentSector > filter.sectorTo) continue;
+
+        // Время контакта берется из снимка, как и остальные поля: страница не захватывает мьютексы шардов
+        long seen = std::max<long>(0, now - view.lastSeen);
+        if (filter.bySeen && (seen < filter.seenFrom || seen > filter.seenTo)) continue;
+
+        entries += std::to_string(view.id) + ":" + (view.active ? "1:" : "0:") + (view.disconnected ? "1:" : "0:") +
+                   std::to_string(view.currentSector) + ":" + std::to_string(seen) + ":";
+        listed++;
+    }
+    return "BEES:" + (more ? std::to_string(lastScanned) : std::string("END")) + ":" + entries;
+}
+
+// Обработка команды, пришедшей на управляющий порт
+void handleControlCommand(Worker& worker, const char* buffer, size_t length, const struct sockaddr_in& clientAddr, socklen_t clientAddrLen) {
+    std::string command(buffer, length);
+    std::string response;
+
+    if (command == "LIST_BEES" || command.find("LIST_BEES:") == 0) {
+        // Команда для получения страницы списка стай: BEES:<курсор следующей страницы или END>:<стаи>
+        SwarmFilter filter;
+        if (parseSwarmFilter(command.size() > 10 ? command.substr(10) : "", filter)) {
+            response = listBeesPage(worker, filter);
+        } else {
+            response = "ERROR:Неверные условия LIST_BEES. Формат: LIST_BEES[:<курсор>][:ACTIVE][:DISCONNECTED]"
+                       "[:SECTOR=<от>-<до>][:SEEN=<от>-<до>][:LIMIT=<стай>]";
+        }
+
+    } else if (command.find("DISCONNECT_BEE:") == 0) {
+        // Команда для отключения стаи
+        uint64_t key = parseSwarmArgument(command.substr(15));
+        int swarmId = (int)(uint32_t)key;
+
+        SwarmShard& shard = shardFor(key);
+        std::unique_lock<std::mutex> lock = lockShard(worker, shard);
+        BeeSwarm* found = shard.swarms.find(key);
+        if (found != nullptr && found->active) {
+            BeeSwarm& swarm = *found;
+            swarm.disconnected = true;
+            swarm.active = false;
+            shard.liveness.cancel(key);
+
+            // Освобождаем секторы, если стая находилась в поиске
+            releaseLease(*gameById(swarm.gameId), shard, swarm);
+            journalSwarm(swarm, WAL_SWARM_LEAVE);
+            publishSwarm(swarm);
+
+            response = "OK:Стая #" + std::to_string(swarmId) + " отключена";
+            logEvent(LOG_INFO, "Управление: OK:Стая #%d отключена", swarmId);
+        } else {
+            response = "ERROR:Стая #" + std::to_string(swarmId) + " не найдена или уже отключена";
+        }
+
+    } else if (command.find("RECONNECT_BEE:") == 0) {
+        // Команда для повторного подключения стаи
+        uint64_t key = parseSwarmArgument(command.substr(14));
+        int swarmId = (int)(uint32_t)key;
+
+        SwarmShard& shard = shardFor(key);
+        std::unique_lock<std::mutex> lock = lockShard(worker, shard);
+        BeeSwarm* found = shard.swarms.find(key);
+        if (found != nullptr && found->disconnected) {
+            found->disconnected = false;
+            found->active = false;  // Стая должна сама активироваться при подключении
+            publishSwarm(*found);
+
+            response = "OK:Стая #" + std::to_string(swarmId) + " готова к переподключению";
+            logEvent(LOG_INFO, "Управление: OK:Стая #%d готова к переподключению", swarmId);
+        } else {
+            response = "ERROR:Стая #" + std::to_string(swarmId) + " не найдена или не была отключена";
+        }
+
+    } else if (command == "STATUS") {
+        // Команда для получения общего статуса
+        response = "STATUS:";
+
+        // Информация о секторах игры по умолчанию
+        response += "SECTORS:" + std::to_string(defaultGame->sectorCount) + ":" +
+                   std::to_string(defaultGame->searchedSectorsCount.load()) + ":";
+
+        // Информация о стаях
+        {
+            SnapshotDomain<HiveSnapshot, MAX_WORKERS>::ReadGuard snapshot(hiveSnapshots, worker.index);
+            response += "BEES:" + std::to_string(snapshot->totalSwarms) + ":" +
+                       std::to_string(snapshot->activeSwarms) + ":" +
+                       std::to_string(snapshot->disconnectedSwarms) + ":";
+        }
+
+        // Информация об игре
+        response += "GAME:";
+        response += defaultGame->winnieFoundByBees ? "1:" : "0:";
+        response += defaultGame->allSectorsSearched ? "1" : "0";
+
+    } else if (command.find("CREATE_GAME:") == 0) {
+        // Команда для создания новой игры с заданным количеством секторов
+        int count = atoi(command.c_str() + 12);
+        uint32_t gameId = count >= 1 && count <= MAX_SECTORS ? allocateGameId() : BEE_DEFAULT_GAME;
+        if (count < 1 || count > MAX_SECTORS) {
+            response = "ERROR:Количество секторов должно быть от 1 до " + std::to_string(MAX_SECTORS);
+        } else if (gameId == BEE_DEFAULT_GAME) {
+            response = "ERROR:Достигнуто максимальное количество игр";
+        } else {
+            publishGameSlot(gameId, makeGame(gameId, count));
+            createdGames++;
+            response = "GAME_CREATED:" + std::to_string(gameId) + ":" + std::to_string(count);
+            logEvent(LOG_INFO, "Управление: Создана игра #%d, секторов: %d", (int)gameId, count);
+        }
+
+    } else if (command.find("DESTROY_GAME:") == 0) {
+        // Команда для удаления игры вместе с ее стаями
+        uint32_t gameId = (uint32_t)strtoul(command.c_str() + 13, nullptr, 10);
+        Game* game = gameById(gameId);
+        if (game == nullptr || gameId == BEE_DEFAULT_GAME) {
+            response = "ERROR:Игра #" + std::to_string(gameId) + " не найдена или не может быть удалена";
+        } else {
+            int removed = destroyGame(*game);
+            response = "OK:Игра #" + std::to_string(gameId) + " удалена";
+            logEvent(LOG_INFO, "Управление: Удалена игра #%d, стай: %d", (int)gameId, removed);
+            if (!serverActive()) wakeWorkers();
+        }
+
+    } else if (command.find("GAME_STATUS:") == 0) {
+        // Команда для получения статуса одной игры
+        uint32_t gameId = (uint32_t)strtoul(command.c_str() + 12, nullptr, 10);
+        Game* game = gameById(gameId);
+        if (game == nullptr) {
+            response = "ERROR:Игра #" + std::to_string(gameId) + " не найдена";
+        } else {
+            response = "GAME_STATUS:" + std::to_string(gameId) + ":" + std::to_string(game->sectorCount) + ":" +
+                       std::to_string(game->searchedSectorsCount.load()) + ":" + std::to_string(game->swarmCount.load()) + ":" +
+                       (game->winnieFoundByBees ? "1:" : "0:") + (game->allSectorsSearched ? "1" : "0");
+        }
+
+    } else if (command.find("ASSIGN_STATS:") == 0) {
+        // Команда для сравнения политик назначения: выдано секторов, суммарный перелет, оценка поиска и длительность игры
+        uint32_t gameId = (uint32_t)strtoul(command.c_str() + 13, nullptr, 10);
+        Game* game = gameById(gameId);
+        if (game == nullptr) {
+            response = "ERROR:Игра #" + std::to_string(gameId) + " не найдена";
+        } else {
+            char stats[256];
+            snprintf(stats, sizeof(stats), "ASSIGN_STATS:%u:%s:%lu:%.1f:%lu:%lld", gameId,
+                     policyName(game->sectorAssigner.assignmentPolicy()), game->assignedSectors.load(),
+                     game->flightDistance.load() / 1000.0, game->searchCost.load(), (long long)gameDurationMs(*game));
+            response = stats;
+        }
+
+    } else if (command.find("SPECULATION_STATS:") == 0) {
+        // Команда для оценки повторной выдачи секторов: выдано копий, сколько опередили первую стаю и сколько не пригодились
+        uint32_t gameId = (uint32_t)strtoul(command.c_str() + 18, nullptr, 10);
+        Game* game = gameById(gameId);
+        if (game == nullptr) {
+            response = "ERROR:Игра #" + std::to_string(gameId) + " не найдена";
+        } else {
+            response = "SPECULATION_STATS:" + std::to_string(gameId) + ":" + std::to_string(game->speculativeAssigned.load()) + ":" +
+                       std::to_string(game->speculativeWins.load()) + ":" + std::to_string(game->speculativeLosses.load()) + ":" +
+                       std::to_string(game->averageSearchUs.load() / 1000);
+        }
+
+    } else if (command == "LIST_GAMES") {
+        // Команда для получения списка игр: общее количество и номера первых MAX_LISTED_GAMES игр
+        const GameTable& table = *gameTables.latest();
+        response = "GAMES:" + std::to_string(table.gameCount) + ":";
+        int listed = 0;
+        for (const auto& chunk : table.chunks) {
+            if (!chunk) continue;
+            for (const auto& game : *chunk) {
+                if (game && listed++ < MAX_LISTED_GAMES) response += std::to_string(game->id) + ":";
+            }
+        }
+
+    } else if (command == "BATCH_STATS") {
+        // Команда для получения статистики пакетного ввода-вывода (суммарно по всем рабочим потокам)
+        unsigned long recvCalls = 0, recvDatagrams = 0, sendCalls = 0, sendDatagrams = 0;
+        for (const auto& w : workers) {
+            recvCalls += w->stats.recvCalls.get();
+            recvDatagrams += w->stats.recvDatagrams.get();
+            sendCalls += w->stats.sendCalls.get();
+            sendDatagrams += w->stats.sendDatagrams.get();
+        }
+
+        char stats[256];
+        snprintf(stats, sizeof(stats), "BATCH_STATS:%d:%lu:%lu:%.2f:%lu:%lu:%.2f", batchSize,
+                 recvCalls, recvDatagrams, averageBatch(recvDatagrams, recvCalls),
+                 sendCalls, sendDatagrams, averageBatch(sendDatagrams, sendCalls));
+        response = stats;
+
+    } else if (command == "METRICS") {
+        // Команда для получения сводки метрик: сообщения, задержки обработки, ожидание мьютексов, очереди
+        response = metricsSummary();
+
+    } else if (command.find("METRICS_TEXT") == 0) {
+        // Выгрузка метрик в формате Prometheus по страницам: METRICS_TEXT делает новую выгрузку
+        // и возвращает первую страницу, METRICS_TEXT:<выгрузка>:<страница> - следующие
+        uint32_t generation = 0;
+        size_t page = 0;
+        if (command == "METRICS_TEXT") {
+            metricsExport.generation++;
+            metricsExport.pages = splitMetricsPages(metricsText(worker));
+            generation = metricsExport.generation;
+        } else if (sscanf(command.c_str(), "METRICS_TEXT:%u:%zu", &generation, &page) != 2) {
+            generation = 0;
+        }
+
+        if (generation != 0 && generation == metricsExport.generation && page < metricsExport.pages.size()) {
+            response = "METRICS_TEXT:" + std::to_string(generation) + ":" + std::to_string(page) + ":" +
+                       std::to_string(metricsExport.pages.size()) + "\n" + metricsExport.pages[page];
+        } else {
+            response = "ERROR:Выгрузка метрик устарела или страницы нет, повторите METRICS_TEXT";
+        }
+
+    } else if (command == "HELP") {
+        // Команда для получения списка доступных команд
+        response = "COMMANDS:LIST_BEES[:<курсор>][:ACTIVE][:DISCONNECTED][:SECTOR=<от>-<до>][:SEEN=<от>-<до>][:LIMIT=<стай>] - страница списка стай;DISCONNECT_BEE:<id>[:<игра>] - отключить стаю;RECONNECT_BEE:<id>[:<игра>] - повторно подключить стаю;STATUS - получить общий статус;"
+                   "CREATE_GAME:<секторы> - создать игру;DESTROY_GAME:<игра> - удалить игру;GAME_STATUS:<игра> - статус игры;LIST_GAMES - список игр;"
+                   "ASSIGN_STATS:<игра> - перелет и длительность игры;SPECULATION_STATS:<игра> - повторная выдача секторов;"
+                   "BATCH_STATS - статистика пакетного ввода-вывода;METRICS - сводка метрик;"
+                   "METRICS_TEXT[:<выгрузка>:<страница>] - метрики в формате Prometheus;HELP - список команд";
+    } else {
+        response = "ERROR:Неизвестная команда. Используйте HELP для получения списка команд.";
+    }
+
+    // Отправляем ответ
+    sendto(controlSockfd, response.c_str(), response.length(), 0,
+           (struct sockaddr*)&clientAddr, clientAddrLen);
+}
+
+// Публикует новый снимок таблицы стай, если с прошлого снимка что-то изменилось.
+// Мьютекс шарда захватывается только на время копирования изменившегося шарда.
+// Вызывается только главным потоком
+void refreshHiveSnapshot() {
+    const HiveSnapshot* current = hiveSnapshots.latest();
+    std::unique_ptr<HiveSnapshot> next;
+
+    for (int s = 0; s < workerCount; s++) {
+        SwarmShard& shard = swarmShards[s];
+        uint64_t version = shard.version.load(std::memory_order_relaxed);
+        if (current != nullptr && current->shardVersions[s] == version) continue;
+
+        if (!next) {
+            next.reset(current != nullptr ? new HiveSnapshot(*current) : new HiveSnapshot());
+            next->shards.resize(workerCount);
+            next->shardVersions.resize(workerCount);
+        }
+
+        auto views = std::make_shared<std::vector<SwarmView>>();
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            views->reserve(shard.swarms.size());
+            for (const auto& [key, swarm] : shard.swarms) {
+                if (swarm.gameId != BEE_DEFAULT_GAME) continue;
+                views->push_back({swarm.id, swarm.currentSector, swarm.active, swarm.disconnected, swarm.lastSeen});
+            }
+        }
+        // Таблица шарда не упорядочена, а LIST_BEES выдает стаи по возрастанию номера
+        std::sort(views->begin(), views->end(), [](const SwarmView& a, const SwarmView& b) { return a.id < b.id; });
+        next->shards[s] = std::move(views);
+        next->shardVersions[s] = version;
+    }
+    if (!next) return;
+
+    next->totalSwarms = next->activeSwarms = next->disconnectedSwarms = 0;
+    for (const auto& shard : next->shards) {
+        next->totalSwarms += shard->size();
+        for (const SwarmView& swarm : *shard) {
+            if (swarm.active) next->activeSwarms++;
+            if (swarm.disconnected) next->disconnectedSwarms++;
+        }
+    }
+    next->version = current != nullptr ? current->version + 1 : 1;
+    hiveSnapshots.publish(next.release());
+}
+
+// Обновляет списки кандидатов на повторную выдачу в играх, где свободные секторы закончились.
+// Кандидат - сектор аренды, который ищется дольше speculationFactor средних времен поиска
+// (i-й сектор аренды - дольше i + 1 средних) и еще не выдан второй стае
+void collectStragglers() {
+    if (speculationFactor <= 0) return;
+    std::map<Game*, std::vector<Straggler>> found;
+    const GameTable& table = *gameTables.latest();
+    for (const auto& chunk : table.chunks) {
+        if (!chunk) continue;
+        for (const auto& game : *chunk) {
+            if (game && game->endgame && !game->winnieFoundByBees && !game->allSectorsSearched) found[game.get()];
+        }
+    }
+    if (found.empty()) return;
+
+    int64_t now = monotonicMs();
+    for (int s = 0; s < workerCount; s++) {
+        std::lock_guard<std::mutex> lock(swarmShards[s].mutex);
+        for (const auto& [key, swarm] : swarmShards[s].swarms) {
+            if (swarm.leaseCount == 0 || swarm.disconnected) continue;
+            Game* game = findGame(table, swarm.gameId);
+            auto it = found.find(game);
+            if (it == found.end() || game->averageSearchUs == 0) continue;
+
+            int64_t ageMs = now - swarm.leaseProgressMs;
+            for (int i = 0; i < swarm.leaseCount; i++) {
+                int64_t thresholdMs = game->averageSearchUs * speculationFactor * (i + 1) / 1000;
+                const Sector& sector = game->sectors[swarm.lease[i]];
+                if (ageMs > thresholdMs && !sector.searched && sector.holders == 1) {
+                    it->second.push_back({swarm.lease[i], key, ageMs});
+                }
+            }
+        }
+    }
+
+    for (auto& [game, stragglers] : found) {
+        // Самые старые - в конце списка и выдаются первыми
+        std::sort(stragglers.begin(), stragglers.end(), [](const Straggler& a, const Straggler& b) { return a.ageMs < b.ageMs; });
+        if (stragglers.size() > MAX_STRAGGLERS) stragglers.erase(stragglers.begin(), stragglers.end() - MAX_STRAGGLERS);
+        std::lock_guard<std::mutex> lock(game->speculationMutex);
+        game->stragglers.swap(stragglers);
+    }
+}
+
+// Периодическая проверка состояния (вызывается по срабатыванию таймера)
+void housekeeping() {
+    // Проверка активности клиентов
+    checkClientsActivity();
+
+    // Обновление снимка для запросов состояния
+    refreshHiveSnapshot();
+
+    // Кандидаты на повторную выдачу в конце игр
+    collectStragglers();
+
+    // Проверка, все ли секторы исследованы, во всех играх
+    for (const auto& chunk : gameTables.latest()->chunks) {
+        if (!chunk) continue;
+        for (const auto& game : *chunk) {
+            if (!game || game->searchedSectorsCount != game->sectorCount) continue;
+
+            // Тик колеса короткий, поэтому сообщение выводится только при первом обнаружении
+            if (game->allSectorsSearched.exchange(true) || game->winnieFoundByBees) continue;
+            recordGameFinish(*game);
+            if (game->id == BEE_DEFAULT_GAME) {
+                publishGame();
+                logEvent(LOG_INFO, "Мониторинг: Все секторы исследованы, но Винни-Пух не найден.");
+            } else {
+                logEvent(LOG_INFO, "Мониторинг: В игре #%d все секторы исследованы, но Винни-Пух не найден.", (int)game->id);
+            }
+        }
+    }
+}
+
+// Отмечает контакт со стаей и переносит ее таймер активности. Вызывается под мьютексом шарда
+void touchSwarm(SwarmShard& shard, BeeSwarm& swarm) {
+    // Снимок хранит время контакта с точностью до секунды, поэтому шард отмечается для следующего
+    // снимка только при смене секунды, а не при каждом сообщении
+    time_t now = time(nullptr);
+    if (swarm.lastSeen != now) {
+        swarm.lastSeen = now;
+        shard.version.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.liveness.schedule(swarmKey(swarm), monotonicMs() + CLIENT_TIMEOUT * 1000);
+}
+
+// Ставит в очередь ответ стае в том же формате, в котором пришел запрос
+// Список секторов (sectors) передается только стаям, запросившим аренду нескольких секторов
+void queueBeeReply(Worker& worker, const struct sockaddr_in& addr, const BeeMessage& request, uint8_t type, int32_t sectorId = -1,
+                   const int32_t* sectors = nullptr, int count = 0) {
+    BeeMessage reply;
+    reply.type = type;
+    reply.binary = request.binary;
+    reply.swarmId = request.swarmId;
+    reply.sectorId = sectorId;
+    reply.sequence = request.sequence;
+    reply.version = std::min<uint8_t>(request.version, BEE_PROTOCOL_VERSION);
+    reply.gameId = request.gameId;
+    if (request.binary && request.batchSize > 0) {
+        reply.sectorCount = (uint8_t)count;
+        std::copy(sectors, sectors + count, reply.sectors);
+    }
+    if (beeLoss.drop()) return;
+
+    char data[BEE_MAX_MESSAGE_SIZE];
+    size_t len = encodeBeeMessage(reply, data);
+    queueReply(worker, worker.beeReplies, addr, data, len);
+}
+
+// Запоминает адрес стаи и переносит ее запись в индексе по адресу. Вызывается под мьютексом шарда
+void setSwarmAddress(BeeSwarm& swarm, const struct sockaddr_in& addr) {
+    uint32_t ip = ntohl(addr.sin_addr.s_addr);
+    uint16_t port = ntohs(addr.sin_port);
+    if (swarm.port != 0 && swarm.ip == ip && swarm.port == port) return;
+
+    std::lock_guard<std::mutex> lock(addressMutex);
+    if (swarm.port != 0) {
+        // Старый адрес мог уже достаться другой стае - удаляем только свою запись
+        uint64_t* owner = swarmsByAddress.find(peerKey(swarm.ip, swarm.port));
+        if (owner != nullptr && *owner == swarmKey(swarm)) swarmsByAddress.erase(peerKey(swarm.ip, swarm.port));
+    }
+    bool inserted;
+    swarmsByAddress.insert(peerKey(ip, port), inserted) = swarmKey(swarm);
+    swarm.ip = ip;
+    swarm.port = port;
+}
+
+// Отключает стаю по ее запросу и освобождает назначенный ей сектор. Вызывается под мьютексом шарда
+void disconnectSwarm(Game& game, SwarmShard& shard, BeeSwarm& swarm) {
+    logEvent(LOG_INFO, "Сервер: Стая #%d запросила отключение", swarm.id);
+    swarm.disconnected = true;
+    swarm.active = false;
+    shard.liveness.cancel(swarmKey(swarm));
+
+    // Если стая выполняла поиск, освобождаем секторы
+    releaseLease(game, shard, swarm);
+    journalSwarm(swarm, WAL_SWARM_LEAVE);
+    publishSwarm(swarm);
+}
+
+// Копирует состояние игры по умолчанию для снимка журнала (игры, созданные через управление,
+// не сохраняются). Вызывается потоком журнала во время игры
+void captureGameState(WalState& state) {
+    const Game& game = *defaultGame;
+    state.sectorCount = game.sectorCount;
+    state.winnieSector = game.winnieSector;
+    // Флаг находки берется из сектора Винни-Пуха: REPORT отмечает сектор исследованным раньше,
+    // чем выставляет winnieFoundByBees, и снимок между ними иначе потерял бы находку
+    state.winnieFound = game.winnieSector >= 0 &&
+                        game.sectors[game.winnieSector].searched.load(std::memory_order_relaxed);
+    state.searched.assign((game.sectorCount + 63) / 64, 0);
+    for (int i = 0; i < game.sectorCount; i++) {
+        if (game.sectors[i].searched.load(std::memory_order_relaxed)) state.setSearched(i);
+    }
+
+    state.swarms.clear();
+    for (int s = 0; s < workerCount; s++) {
+        std::lock_guard<std::mutex> lock(swarmShards[s].mutex);
+        for (auto& [key, swarm] : swarmShards[s].swarms) {
+            if (swarm.gameId != BEE_DEFAULT_GAME) continue;
+            WalSwarm saved;
+            saved.id = swarm.id;
+            saved.active = swarm.active;
+            saved.disconnected = swarm.disconnected;
+            saved.binary = swarm.binary;
+            saved.ip = swarm.ip;
+            saved.port = swarm.port;
+            saved.walSequence = swarm.walSequence;
+            saved.leaseCount = swarm.leaseCount;
+            std::copy(swarm.lease, swarm.lease + swarm.leaseCount, saved.lease);
+            state.swarms.push_back(saved);
+        }
+    }
+}
+
+// Восстанавливает секторы и стаи игры по умолчанию из сохраненного состояния.
+// Вызывается до запуска рабочих потоков
+void restoreGameState(const WalState& state) {
+    Game& game = *defaultGame;
+    for (int i = 0; i < game.sectorCount; i++) {
+        if (!state.isSearched(i)) continue;
+        game.sectors[i].searched = true;
+        game.sectorAssigner.reserve(i);
+        game.searchedSectorsCount++;
+    }
+
+    // Игра, в которой Винни-Пух уже найден, после перезапуска остается завершенной
+    if (state.winnieSector >= 0 && state.winnieSector < game.sectorCount &&
+        (state.winnieFound || state.isSearched(state.winnieSector))) {
+        game.winnieFoundByBees = true;
+        game.sectors[state.winnieSector].winnieFound = true;
+        recordGameFinish(game);
+    }
+
+    for (const WalSwarm& saved : state.swarms) {
+        uint64_t key = swarmKey(game.id, saved.id);
+        SwarmShard& shard = shardFor(key);
+        bool inserted;
+        BeeSwarm& swarm = shard.swarms.insert(key, inserted);
+        if (inserted) game.swarmCount++;
+        swarm.id = saved.id;
+        swarm.gameId = game.id;
+        swarm.active = saved.active;
+        swarm.disconnected = saved.disconnected;
+        swarm.binary = saved.binary;
+        swarm.walSequence = saved.walSequence;
+        if (saved.port != 0) {
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(saved.ip);
+            addr.sin_port = htons(saved.port);
+            setSwarmAddress(swarm, addr);
+        }
+
+        // Исследованные после выдачи секторы в аренду не возвращаются
+        for (int i = 0; i < saved.leaseCount; i++) {
+            int sectorId = saved.lease[i];
+            if (sectorId < 0 || sectorId >= game.sectorCount || game.sectors[sectorId].searched || game.sectors[sectorId].holders > 0) continue;
+            game.sectors[sectorId].holders = 1;
+            game.sectorAssigner.reserve(sectorId);
+            swarm.lease[swarm.leaseCount++] = sectorId;
+        }
+        swarm.recovered = swarm.leaseCount > 0;
+        if (swarm.active) touchSwarm(shard, swarm);
+        updateLease(shard, swarm);
+    }
+}
+
+// Обработка сообщения от стаи пчел (текстового или двоичного)
+void handleBeeMessage(Worker& worker, const char* buffer, size_t length, const struct sockaddr_in& clientAddr, socklen_t) {
+    BeeMessage request;
+    if (beeLoss.drop()) return;
+    if (!parseBeeMessage(buffer, length, request)) {
+        worker.metrics.malformed.add(1);
+        return;
+    }
+    ScopedTimer timer(worker.metrics.handling[request.type % METRIC_MESSAGE_TYPES]);
+
+    // Игра стаи ищется в таблице игр без мьютексов; версия таблицы, а с ней и игра,
+    // не освобождается до конца обработки сообщения
+    SnapshotDomain<GameTable, MAX_WORKERS>::ReadGuard games(gameTables, worker.index);
+    Game* game = findGame(*games.get(), request.gameId);
+    if (game == nullptr && request.type != MSG_HELLO) {
+        // Игры нет или она удалена: стая получает отказ, а отключение просто подтверждается
+        if (request.type == MSG_REQUEST) queueBeeReply(worker, clientAddr, request, MSG_DENIED);
+        if (request.type == MSG_DISCONNECT) queueBeeReply(worker, clientAddr, request, MSG_DISCONNECT_ACK);
+        return;
+    }
+
+    switch (request.type) {
+    case MSG_HELLO: {
+        // Согласование двоичного протокола: отвечаем версией, которую поддерживают обе стороны
+        BeeMessage reply;
+        reply.type = MSG_HELLO_ACK;
+        reply.binary = true;
+        reply.version = std::min<uint8_t>(request.version, BEE_PROTOCOL_VERSION);
+        reply.swarmId = request.swarmId;
+        reply.sequence = request.sequence;
+
+        char data[BEE_MAX_MESSAGE_SIZE];
+        size_t len = encodeBeeMessage(reply, data);
+        queueReply(worker, worker.beeReplies, clientAddr, data, len);
+        break;
+    }
+
+    case MSG_HEARTBEAT: {
+        // Обрабатываем сигнал активности. Групповой HEARTBEAT перечисляет стаи одного процесса:
+        // они упорядочиваются по шардам, и мьютекс каждого шарда берется один раз на всю группу
+        int32_t ids[BEE_MAX_HEARTBEAT_BATCH + 1];
+        int count = 0;
+        ids[count++] = request.swarmId;
+        for (int i = 0; i < request.heartbeatCount; i++) {
+            ids[count++] = beeHeartbeatSwarm(buffer, request, i);
+        }
+        uint32_t gameId = game->id;
+        if (count > 1 && workerCount > 1) {
+            std::sort(ids, ids + count, [gameId](int32_t a, int32_t b) {
+                return swarmKey(gameId, a) % workerCount < swarmKey(gameId, b) % workerCount;
+            });
+        }
+
+        int known = 0;
+        for (int begin = 0; begin < count; ) {
+            SwarmShard& shard = shardFor(swarmKey(gameId, ids[begin]));
+            int end = begin + 1;
+            while (end < count && &shardFor(swarmKey(gameId, ids[end])) == &shard) end++;
+
+            std::unique_lock<std::mutex> lock = lockShard(worker, shard);
+            for (int i = begin; i < end; i++) {
+                BeeSwarm* swarm = shard.swarms.find(swarmKey(gameId, ids[i]));
+                if (swarm == nullptr || swarm->disconnected) {
+                    ids[i] = -1;
+                    continue;
+                }
+                touchSwarm(shard, *swarm);
+                known++;
+            }
+            begin = end;
+        }
+        if (known == 0) break;
+
+        if (game->winnieFoundByBees) {
+            // После находки Винни-Пуха вместо подтверждения каждая стая получает WINNIE_FOUND:
+            // так стая узнает о конце игры, даже если уведомление потерялось
+            BeeMessage notice = request;
+            for (int i = 0; i < count; i++) {
+                if (ids[i] < 0) continue;
+                notice.swarmId = ids[i];
+                queueBeeReply(worker, clientAddr, notice, MSG_WINNIE_FOUND);
+            }
+        } else {
+            // Одно подтверждение на всю группу
+            queueBeeReply(worker, clientAddr, request, MSG_HEARTBEAT_ACK);
+        }
+        break;
+    }
+
+    case MSG_REQUEST: {
+        // Если Винни-Пух уже найден, отправляем сообщение о завершении поиска
+        if (game->winnieFoundByBees) {
+            queueBeeReply(worker, clientAddr, request, MSG_WINNIE_FOUND);
+            return;
+        }
+
+        // Обрабатываем запрос на поиск. Стая может арендовать сразу несколько секторов (batchSize),
+        // текстовый протокол и стаи версии 1 получают по одному сектору
+        int swarmId = request.swarmId;
+        uint64_t key = swarmKey(game->id, swarmId);
+        SwarmShard& shard = shardFor(key);
+        bool allowRequest = false;
+        bool duplicate = false;
+        uint8_t replyType = MSG_DENIED;
+        int wanted = request.binary && request.batchSize > 0 ? std::min<int>(request.batchSize, BEE_MAX_BATCH) : 1;
+        int32_t granted[BEE_MAX_BATCH];
+        int grantedCount = 0;
+
+        // Проверяем и обновляем информацию о стае и назначаем секторы за один поиск в таблице:
+        // распределитель секторов не блокирует, поэтому секторы выдаются под мьютексом шарда
+        {
+            std::unique_lock<std::mutex> lock = lockShard(worker, shard);
+            if (game->closed) return; // Игра удаляется, ее стаи уже убраны из шарда
+            bool inserted;
+            BeeSwarm& swarm = shard.swarms.insert(key, inserted);
+
+            // Повтор обработанного запроса получает прежний ответ (SEARCH - с текущей арендой,
+            // если она еще не истекла), копии более старых запросов отбрасываются
+            BeeSequenceCheck check = inserted ? BEE_SEQUENCE_NEW : swarm.lastReply.check(request);
+            if (check == BEE_SEQUENCE_STALE) return;
+
+            // Номера запросов стаи не сохраняются в журнале: первый запрос стаи с восстановленной
+            // арендой считается повтором запроса, на который эта аренда была выдана
+            if (swarm.recovered) {
+                swarm.recovered = false;
+                if (swarm.leaseCount > 0) {
+                    swarm.lastReply.remember(request, MSG_SEARCH, swarm.lease[0]);
+                    check = BEE_SEQUENCE_DUPLICATE;
+                }
+            }
+            if (check == BEE_SEQUENCE_DUPLICATE && !swarm.disconnected && (swarm.lastReply.type != MSG_SEARCH || swarm.leaseCount > 0)) {
+                touchSwarm(shard, swarm);
+                duplicate = true;
+                replyType = swarm.lastReply.type;
+                if (replyType == MSG_SEARCH) {
+                    grantedCount = std::min(swarm.leaseCount, wanted);
+                    std::copy(swarm.lease, swarm.lease + grantedCount, granted);
+                }
+            } else if (inserted) {
+                // Новая стая
+                swarm.id = swarmId;
+                swarm.gameId = game->id;
+                game->swarmCount++;
+                swarm.active = true;
+                swarm.binary = request.binary;
+                setSwarmAddress(swarm, clientAddr);
+                touchSwarm(shard, swarm);
+                journalSwarm(swarm, WAL_SWARM_JOIN, (int32_t)swarm.ip);
+                logEvent(LOG_INFO, "Сервер: Стая #%d подключена", swarmId);
+                allowRequest = true;
+            } else if (!swarm.disconnected) {
+                // Существующая активная стая
+                touchSwarm(shard, swarm);
+                setSwarmAddress(swarm, clientAddr);
+                swarm.binary = request.binary;
+
+                // Разрешаем запрос только если стая не выполняет поиск
+                if (!swarm.searchInProgress) {
+                    swarm.active = true;
+                    allowRequest = true;
+                }
+            } else if (!swarm.active) {
+                // Отключенная стая пытается переподключиться
+                swarm.disconnected = false;
+                swarm.active = true;
+                touchSwarm(shard, swarm);
+                setSwarmAddress(swarm, clientAddr);
+                swarm.binary = request.binary;
+                releaseLease(*game, shard, swarm);
+                journalSwarm(swarm, WAL_SWARM_JOIN, (int32_t)swarm.ip);
+                logEvent(LOG_INFO, "Сервер: Стая #%d переподключена", swarmId);
+                allowRequest = true;
+            }
+
+            if (allowRequest) {
+                // Поиск неисследованных и неназначенных секторов; потоки начинают с разных слов битовой карты
+                // Секторы аренды выбираются друг за другом от последнего сектора стаи
+                unsigned hint = worker.index * game->sectorAssigner.wordsCount() / workerCount;
+                while (grantedCount < wanted) {
+                    int sectorId = acquireSector(*game, hint, swarm.position);
+                    if (sectorId == -1) {
+                        game->endgame = true;
+                        break;
+                    }
+                    recordAssignment(*game, swarm.position, sectorId);
+                    swarm.position = sectorId;
+                    granted[grantedCount++] = sectorId;
+                    journalSwarm(swarm, WAL_LEASE, sectorId);
+                }
+
+                // Свободных секторов нет: стая получает копию сектора, который ищется слишком долго
+                if (grantedCount == 0 && speculationFactor > 0) {
+                    int sectorId = takeStraggler(*game, key);
+                    if (sectorId >= 0) {
+                        recordAssignment(*game, swarm.position, sectorId);
+                        swarm.position = sectorId;
+                        granted[grantedCount++] = sectorId;
+                        journalSwarm(swarm, WAL_LEASE, sectorId);
+                        logEvent(LOG_DEBUG, "Сервер: Стая #%d получила копию долго исследуемого сектора %d", swarmId, sectorId);
+                    }
+                }
+                swarm.leaseProgressMs = monotonicMs();
+                std::copy(granted, granted + grantedCount, swarm.lease);
+                swarm.leaseCount = grantedCount;
+                updateLease(shard, swarm);
+                publishSwarm(swarm);
+                replyType = grantedCount > 0 ? MSG_SEARCH : MSG_NO_MORE_SECTORS;
+            }
+            if (!duplicate) swarm.lastReply.remember(request, replyType, grantedCount > 0 ? granted[0] : -1);
+        }
+
+        if (duplicate) {
+            queueBeeReply(worker, clientAddr, request, replyType, grantedCount > 0 ? granted[0] : -1, granted, grantedCount);
+            return;
+        }
+
+        if (!allowRequest) {
+            // Отказываем в запросе
+            queueBeeReply(worker, clientAddr, request, MSG_DENIED);
+            return;
+        }
+
+        if (grantedCount == 0) {
+            // Нет доступных секторов
+            logEvent(LOG_DEBUG, "Сервер: Все доступные секторы назначены");
+            queueBeeReply(worker, clientAddr, request, MSG_NO_MORE_SECTORS);
+
+            // Проверяем, все ли секторы исследованы
+            if (game->searchedSectorsCount == game->sectorCount) {
+                if (!game->allSectorsSearched.exchange(true)) {
+                    recordGameFinish(*game);
+                    if (game->id == BEE_DEFAULT_GAME) publishGame();
+                }
+                if (!serverActive()) wakeWorkers();
+            }
+        } else {
+            // Отправляем номера секторов для исследования
+            queueBeeReply(worker, clientAddr, request, MSG_SEARCH, granted[0], granted, grantedCount);
+            for (int i = 0; i < grantedCount; i++) {
+                logEvent(LOG_DEBUG, "Сервер: Стая #%d направлена в сектор %d", swarmId, granted[i]);
+            }
+        }
+        break;
+    }
+
+    case MSG_REPORT: {
+        // Обрабатываем отчет о поиске: один сектор в sectorId или список арендованных секторов
+        int swarmId = request.swarmId;
+        const int32_t* reported = request.sectorCount > 0 ? request.sectors : &request.sectorId;
+        int reportedCount = request.sectorCount > 0 ? request.sectorCount : 1;
+        int winnieReportedIn = -1;
+        uint8_t duplicateReply = MSG_UNKNOWN;
+        uint64_t losers[BEE_MAX_BATCH]; // Стаи, чьи копии отчитавшихся секторов больше не нужны
+        int32_t lostSectors[BEE_MAX_BATCH];
+        int loserCount = 0;
+
+        {
+            uint64_t key = swarmKey(game->id, swarmId);
+            SwarmShard& shard = shardFor(key);
+            std::unique_lock<std::mutex> lock = lockShard(worker, shard);
+            BeeSwarm* swarm = shard.swarms.find(key);
+            if (swarm == nullptr || swarm->disconnected) {
+                // Если стая не зарегистрирована или отключена, игнорируем отчет
+                return;
+            }
+
+            // Повторный отчет не обрабатывается заново: стая получает прежний ответ
+            BeeSequenceCheck check = swarm->lastReply.check(request);
+            if (check == BEE_SEQUENCE_STALE) return;
+            touchSwarm(shard, *swarm);
+            swarm->recovered = false;
+            if (check == BEE_SEQUENCE_DUPLICATE) {
+                duplicateReply = swarm->lastReply.type;
+                reportedCount = 0;
+            }
+
+            // Время поиска одного сектора для выбора долго исследуемых секторов
+            int64_t now = monotonicMs();
+            if (reportedCount > 0 && swarm->leaseProgressMs > 0) {
+                recordSearchTime(*game, (now - swarm->leaseProgressMs) * 1000 / reportedCount);
+            }
+            swarm->leaseProgressMs = now;
+
+            // Секторы отмечаются исследованными до возврата остатка аренды, чтобы они не попали в пул
+            for (int i = 0; i < reportedCount; i++) {
+                bool isWinnieInSector = (reported[i] == game->winnieSector);
+                if (isWinnieInSector) winnieReportedIn = reported[i];
+                bool first = markSectorSearched(*game, reported[i], isWinnieInSector);
+                removeFromLease(*swarm, reported[i]);
+                if (first && game->sectors[reported[i]].speculated &&
+                    settleSpeculation(*game, reported[i], key, &losers[loserCount])) {
+                    lostSectors[loserCount++] = reported[i];
+                }
+            }
+
+            // Отчет об одном секторе по протоколу версии 1 завершает поиск стаи
+            if (duplicateReply == MSG_UNKNOWN) {
+                if (request.sectorCount == 0) {
+                    releaseLease(*game, shard, *swarm);
+                } else {
+                    updateLease(shard, *swarm);
+                }
+                publishSwarm(*swarm);
+                swarm->lastReply.remember(request, winnieReportedIn >= 0 ? MSG_WINNIE_FOUND : MSG_CONTINUE);
+            }
+        }
+
+        if (duplicateReply != MSG_UNKNOWN) {
+            queueBeeReply(worker, clientAddr, request, duplicateReply);
+            return;
+        }
+
+        // Копии уже исследованных секторов отменяются вне мьютекса шарда отчитавшейся стаи
+        for (int i = 0; i < loserCount; i++) {
+            cancelSpeculativeCopy(worker, losers[i], lostSectors[i]);
+        }
+
+        for (int i = 0; i < reportedCount; i++) {
+            if (reported[i] != winnieReportedIn) {
+                logEvent(LOG_DEBUG, "Сервер: Стая пчел #%d сообщает, что сектор %d проверен, Винни-Пух не обнаружен", swarmId, reported[i]);
+            }
+        }
+
+        if (winnieReportedIn >= 0) {
+            logEvent(LOG_INFO, "Сервер: Стая пчел #%d сообщает, что Винни-Пух найден в секторе %d и наказан!", swarmId, winnieReportedIn);
+            if (!game->winnieFoundByBees.exchange(true)) {
+                recordGameFinish(*game);
+                if (game->id == BEE_DEFAULT_GAME) publishGame();
+            }
+
+            // Отправляем подтверждение о находке стае, которая нашла Винни-Пуха
+            queueBeeReply(worker, clientAddr, request, MSG_WINNIE_FOUND);
+
+            // Уведомляем все другие стаи игры о находке
+            notifyAllSwarmsWinnieFound(worker, *game);
+            if (!serverActive()) wakeWorkers();
+        } else {
+            // Отправляем подтверждение и инструкцию продолжить поиск
+            queueBeeReply(worker, clientAddr, request, MSG_CONTINUE);
+        }
+        break;
     }
-};
 
-// Глобальные переменные для обработки сигналов
-volatile bool running = true;
-int sockfd = -1;
-int monitorSockfd = -1;
+    case MSG_DISCONNECT: {
+        // Обрабатываем запрос на отключение
+        // Двоичное сообщение содержит номер стаи, текстовое - нет: стая находится по IP и порту
+        uint64_t key = swarmKey(game->id, request.swarmId);
+        bool known = request.binary;
+        if (!request.binary) {
+            std::lock_guard<std::mutex> lock(addressMutex);
+            uint64_t* owner = swarmsByAddress.find(peerKey(clientAddr));
+            if (owner != nullptr && (*owner >> 32) == game->id) {
+                key = *owner;
+                known = true;
+            }
+        }
 
-// Мьютексы для синхронизации доступа к общим данным
-std::mutex sectorsMutex;
-std::mutex swarmsMutex;
-std::mutex monitorsMutex;
+        if (known) {
+            SwarmShard& shard = shardFor(key);
+            std::unique_lock<std::mutex> lock = lockShard(worker, shard);
+            BeeSwarm* swarm = shard.swarms.find(key);
+            // Между поисками в индексе и в таблице стая могла сменить адрес
+            if (swarm != nullptr && (request.binary || peerKey(swarm->ip, swarm->port) == peerKey(clientAddr))) {
+                // Повторный DISCONNECT только подтверждается еще раз
+                BeeSequenceCheck check = swarm->lastReply.check(request);
+                if (check == BEE_SEQUENCE_STALE) return;
+                if (check == BEE_SEQUENCE_NEW) {
+                    disconnectSwarm(*game, shard, *swarm);
+                    swarm->lastReply.remember(request, MSG_DISCONNECT_ACK);
+                }
+            }
+        }
 
-std::vector<Sector> sectors;
-std::map<int, BeeSwarm> beeSwarms;
-std::set<Monitor> monitors;
+        // Отправляем подтверждение отключения
+        queueBeeReply(worker, clientAddr, request, MSG_DISCONNECT_ACK);
+        break;
+    }
 
-int winnieSector = -1;
-bool winnieFoundByBees = false;
-bool allSectorsSearched = false;
+    default:
+        break;
+    }
+}
 
-// Обработчик сигналов для корректного завершения
-void signalHandler(int signum) {
-    if (signum == SIGINT || signum == SIGTERM) {
-        std::cout << "\nПолучен сигнал завершения. Завершение работы сервера и клиентов..." << std::endl;
-        running = false;
+// Отмечает контакт с зарегистрированным монитором и переносит его таймер активности
+void touchMonitor(uint64_t key) {
+    std::lock_guard<std::mutex> lock(monitorsMutex);
+    auto it = monitors.find(key);
+    if (it != monitors.end()) {
+        it->second.lastSeen = time(nullptr);
+        monitorLiveness.schedule(key, monotonicMs() + CLIENT_TIMEOUT * 1000);
     }
 }
 
-// Функция для отправки сообщения о завершении всем клиентам
-void notifyClientsServerShutdown() {
-    if (sockfd < 0 || monitorSockfd < 0) return;
-    
-    // Отправляем сообщение всем пчёлам
-    {
-        std::lock_guard<std::mutex> lock(swarmsMutex);
-        for (const auto& [id, swarm] : beeSwarms) {
-            if (!swarm.disconnected && swarm.active) {
-                struct sockaddr_in clientAddr;
-                memset(&clientAddr, 0, sizeof(clientAddr));
-                clientAddr.sin_family = AF_INET;
-                clientAddr.sin_addr.s_addr = inet_addr(swarm.ip.c_str());
-                clientAddr.sin_port = htons(swarm.port);
-                
-                char shutdownMsg[] = "SERVER_SHUTDOWN";
-                sendto(sockfd, shutdownMsg, strlen(shutdownMsg), 0, (struct sockaddr*)&clientAddr, sizeof(clientAddr));
-                std::cout << "Сервер: Отправлен сигнал завершения стае #" << id << std::endl;
-            }
+// Обработка сообщения от монитора
+void handleMonitorMessage(Worker& worker, const char* buffer, size_t, const struct sockaddr_in& monitorAddr, socklen_t monitorAddrLen) {
+    std::string message(buffer);
+    char ipBuffer[INET_ADDRSTRLEN];
+    std::string monitorIP = inet_ntop(AF_INET, &monitorAddr.sin_addr, ipBuffer, sizeof(ipBuffer));
+    int monitorPort = ntohs(monitorAddr.sin_port);
+
+    uint64_t key = monitorKey(monitorAddr);
+
+    if (message == "CONNECT_MONITOR") {
+        // Регистрируем новый монитор
+        {
+            std::lock_guard<std::mutex> lock(monitorsMutex);
+            monitors[key] = {monitorIP, monitorPort, time(nullptr)};
+            monitorLiveness.schedule(key, monotonicMs() + CLIENT_TIMEOUT * 1000);
         }
-    }
-    
-    // Отправляем сообщение всем мониторам
-    {
-        std::lock_guard<std::mutex> monLock(monitorsMutex);
-        for (const auto& monitor : monitors) {
-            struct sockaddr_in monitorAddr;
-            memset(&monitorAddr, 0, sizeof(monitorAddr));
-            monitorAddr.sin_family = AF_INET;
-            monitorAddr.sin_addr.s_addr = inet_addr(monitor.ip.c_str());
-            monitorAddr.sin_port = htons(monitor.port);
-            
-            char shutdownMsg[] = "SERVER_SHUTDOWN";
-            sendto(monitorSockfd, shutdownMsg, strlen(shutdownMsg), 0, (struct sockaddr*)&monitorAddr, sizeof(monitorAddr));
-            std::cout << "Сервер: Отправлен сигнал завершения монитору с " << monitor.ip << ":" << monitor.port << std::endl;
-        }
-    }
-    
-    // Даем клиентам немного времени для обработки сообщения
-    std::cout << "Сервер: Ожидание завершения работы клиентов..." << std::endl;
-    sleep(2);
-}
-
-// Функция для отправки сообщения о нахождении Винни-Пуха всем стаям
-void notifyAllSwarmsWinnieFound() {
-    if (sockfd < 0) return;
-    
-    std::lock_guard<std::mutex> lock(swarmsMutex);
-    for (auto& [id, swarm] : beeSwarms) {
-        if (!swarm.disconnected && swarm.active) {
-            struct sockaddr_in clientAddr;
-            memset(&clientAddr, 0, sizeof(clientAddr));
-            clientAddr.sin_family = AF_INET;
-            clientAddr.sin_addr.s_addr = inet_addr(swarm.ip.c_str());
-            clientAddr.sin_port = htons(swarm.port);
-            
-            // Отправляем сообщение о находке, если стая не является той, которая нашла Винни-Пуха
-            if (swarm.searchInProgress) {
-                char foundMsg[] = "WINNIE_FOUND";
-                sendto(sockfd, foundMsg, strlen(foundMsg), 0, (struct sockaddr*)&clientAddr, sizeof(clientAddr));
-                std::cout << "Сервер: Отправлено уведомление о находке Винни-Пуха стае #" << id << std::endl;
+
+        logEvent(LOG_INFO, "Сервер: Монитор подключен с %a:%d", ntohl(monitorAddr.sin_addr.s_addr), monitorPort);
+
+        // Отправляем начальную информацию
+        // При включенной многоадресной рассылке монитор узнает адрес группы из INIT
+        char response[1024];
+        if (multicastSockfd >= 0) {
+            char groupBuffer[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &multicastAddr.sin_addr, groupBuffer, sizeof(groupBuffer));
+            sprintf(response, "INIT:%d:%d:%s:%d", defaultGame->sectorCount, defaultGame->winnieSector, groupBuffer, ntohs(multicastAddr.sin_port));
+        } else {
+            sprintf(response, "INIT:%d:%d", defaultGame->sectorCount, defaultGame->winnieSector);
+        }
+        sendto(monitorSockfd, response, strlen(response), 0, (struct sockaddr*)&monitorAddr, monitorAddrLen);
+
+    } else if (message == "SUBSCRIBE") {
+        // Подписка на поток событий или повторная синхронизация после потери события
+        {
+            std::lock_guard<std::mutex> lock(monitorsMutex);
+            auto it = monitors.find(key);
+            if (it != monitors.end()) it->second.subscribed = true;
+        }
+        touchMonitor(key);
+        sendSnapshot(monitorAddr);
+
+    } else if (message == "KEEPALIVE") {
+        // Сигнал активности подписчика; номер последнего разосланного события позволяет заметить
+        // потерю последних событий, за которыми не последовало новых
+        touchMonitor(key);
+        char response[32];
+        uint32_t seq;
+        {
+            std::lock_guard<std::mutex> lock(eventMutex);
+            seq = sentEventSequence;
+        }
+        int len = snprintf(response, sizeof(response), "SEQ:%u", seq);
+        sendto(monitorSockfd, response, len, 0, (struct sockaddr*)&monitorAddr, monitorAddrLen);
+
+    } else if (message == "STATUS") {
+        // Обновляем время последнего контакта с монитором
+        touchMonitor(key);
+
+        // Формируем статусное сообщение для монитора
+        std::string status = "STATUS:";
+
+        // Добавляем информацию о секторах
+        for (const auto& sector : defaultGame->sectors) {
+            status += std::to_string(sector.id) + ":" +
+                    (sector.searched ? "1:" : "0:") +
+                    (sector.winnieFound ? "1:" : "0:");
+        }
+
+        status += "BEES:";
+
+        // Добавляем информацию о стаях
+        SnapshotDomain<HiveSnapshot, MAX_WORKERS>::ReadGuard snapshot(hiveSnapshots, worker.index);
+        for (const auto& shard : snapshot->shards) {
+            for (const SwarmView& swarm : *shard) {
+                status += std::to_string(swarm.id) + ":" +
+                        std::to_string(swarm.currentSector) + ":" +
+                        (swarm.active ? "1:" : "0:") +
+                        (swarm.disconnected ? "1:" : "0:");
             }
-            
-            // Снимаем флаг поиска для всех стай
-            swarm.searchInProgress = false;
         }
-    }
-    
-    // Освобождаем все назначенные, но не исследованные сектора
-    {
-        std::lock_guard<std::mutex> sectorsLock(sectorsMutex);
-        for (auto& sector : sectors) {
-            if (sector.assigned && !sector.searched) {
-                sector.assigned = false;
+
+        // Добавляем общий статус игры
+        status += "GAME:";
+        status += defaultGame->winnieFoundByBees ? "1:" : "0:";
+        status += defaultGame->allSectorsSearched ? "1" : "0";
+
+        sendto(monitorSockfd, status.c_str(), status.length(), 0,
+              (struct sockaddr*)&monitorAddr, monitorAddrLen);
+
+    } else if (message == "DISCONNECT_MONITOR") {
+        // Удаляем монитор из списка
+        {
+            std::lock_guard<std::mutex> lock(monitorsMutex);
+            if (monitors.erase(key) > 0) {
+                monitorLiveness.cancel(key);
+                unsubscribeMonitor(key);
+                logEvent(LOG_INFO, "Сервер: Монитор отключен с %a:%d", ntohl(monitorAddr.sin_addr.s_addr), monitorPort);
             }
         }
     }
 }
 
-// Функция для проверки активности клиентов
-void checkClientsActivity() {
-    time_t currentTime = time(nullptr);
-    
-    // Проверяем активность пчёл
-    {
-        std::lock_guard<std::mutex> lock(swarmsMutex);
-        std::vector<int> inactiveSwarms;
-        
-        for (auto& [id, swarm] : beeSwarms) {
-            if (!swarm.disconnected && swarm.active && 
-                difftime(currentTime, swarm.lastSeen) > CLIENT_TIMEOUT) {
-                std::cout << "Сервер: Стая #" << swarm.id << " не отвечает и будет помечена как отключенная" << std::endl;
-                swarm.disconnected = true;
-                swarm.active = false;
-                inactiveSwarms.push_back(id);
-                
-                // Освобождаем сектор, если стая находилась в поиске
-                if (swarm.searchInProgress && swarm.currentSector >= 0) {
-                    std::lock_guard<std::mutex> sectorsLock(sectorsMutex);
-                    for (auto& sector : sectors) {
-                        if (sector.id == swarm.currentSector) {
-                            sector.assigned = false;  // Освобождаем сектор для других стай
-                            break;
-                        }
-                    }
-                    swarm.searchInProgress = false;
-                    swarm.currentSector = -1;
-                }
-            }
+// Тип обработчика входящей датаграммы
+typedef void (*DatagramHandler)(Worker& worker, const char* buffer, size_t length, const struct sockaddr_in& addr, socklen_t addrLen);
+
+// Вычитывает из сокета все накопившиеся датаграммы пакетами recvmmsg, пока сокет не опустеет.
+// Ответы пчелам, накопленные за это пробуждение, отправляются одним вызовом sendmmsg
+void drainSocket(Worker& worker, int fd, DatagramHandler handler) {
+    RecvBatch& batch = worker.recvBatch;
+
+    while (running) {
+        for (int i = 0; i < batchSize; i++) {
+            batch.iovs[i].iov_base = batch.data[i];
+            batch.iovs[i].iov_len = RECV_BUFFER_SIZE - 1;
+            memset(&batch.msgs[i], 0, sizeof(batch.msgs[i]));
+            batch.msgs[i].msg_hdr.msg_name = &batch.addrs[i];
+            batch.msgs[i].msg_hdr.msg_namelen = sizeof(batch.addrs[i]);
+            batch.msgs[i].msg_hdr.msg_iov = &batch.iovs[i];
+            batch.msgs[i].msg_hdr.msg_iovlen = 1;
         }
-    }
-    
-    // Проверяем активность мониторов
-    {
-        std::lock_guard<std::mutex> lock(monitorsMutex);
-        std::vector<Monitor> inactiveMonitors;
-        
-        for (const auto& monitor : monitors) {
-            if (difftime(currentTime, monitor.lastSeen) > CLIENT_TIMEOUT) {
-                inactiveMonitors.push_back(monitor);
+
+        int n = recvmmsg(fd, batch.msgs, batchSize, MSG_DONTWAIT, nullptr);
+
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("Ошибка приема");
             }
+            break;
         }
-        
-        for (const auto& monitor : inactiveMonitors) {
-            monitors.erase(monitor);
-            std::cout << "Сервер: Монитор с " << monitor.ip << ":" << monitor.port << " не отвечает и будет удален" << std::endl;
+
+        worker.stats.recvCalls.add(1);
+        worker.stats.recvDatagrams.add(n);
+        worker.metrics.recvBatch.record(n);
+
+        for (int i = 0; i < n; i++) {
+            batch.data[i][batch.msgs[i].msg_len] = '\0';
+            handler(worker, batch.data[i], batch.msgs[i].msg_len, batch.addrs[i], batch.msgs[i].msg_hdr.msg_namelen);
         }
+
+        // Неполный пакет означает, что очередь сокета опустела
+        if (n < batchSize) break;
+    }
+
+    if (worker.beeReplies.count > 0) {
+        flushReplies(worker, worker.beeReplies);
     }
 }
 
-// Поток для обработки запросов управления
-void controlThreadFunction(const char* serverIP, int controlPort) {
-    // Создаем UDP сокет для управления
-    int controlSockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (controlSockfd < 0) {
-        perror("Ошибка создания сокета для управления");
-        return;
+// Регистрирует дескриптор в epoll на событие чтения
+bool addToEpoll(int epollFd, int fd) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+// Создает неблокирующий UDP сокет для пчел; при нескольких рабочих потоках
+// каждый поток привязывает свой сокет к тому же порту через SO_REUSEPORT
+int createBeeSocket(const char* serverIP, int serverPort, bool reusePort) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("Ошибка создания сокета для пчел");
+        return -1;
     }
 
-    // Настраиваем адрес для привязки
-    struct sockaddr_in controlAddr;
-    memset(&controlAddr, 0, sizeof(controlAddr));
-    controlAddr.sin_family = AF_INET;
-    controlAddr.sin_addr.s_addr = inet_addr(serverIP);
-    controlAddr.sin_port = htons(controlPort);
+    if (reusePort) {
+        int enable = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0) {
+            perror("Ошибка установки SO_REUSEPORT");
+            close(fd);
+            return -1;
+        }
+    }
 
-    // Привязываем сокет
-    if (bind(controlSockfd, (struct sockaddr*)&controlAddr, sizeof(controlAddr)) < 0) {
-        perror("Ошибка привязки сокета для управления");
-        close(controlSockfd);
-        return;
+    struct sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_addr.s_addr = inet_addr(serverIP);
+    serverAddr.sin_port = htons(serverPort);
+
+    if (bind(fd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+        perror("Ошибка привязки сокета для пчел");
+        close(fd);
+        return -1;
     }
 
-    std::cout << "Поток управления запущен на порту " << controlPort << std::endl;
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    return fd;
+}
 
-    // Устанавливаем неблокирующий режим
-    int flags = fcntl(controlSockfd, F_GETFL, 0);
-    fcntl(controlSockfd, F_SETFL, flags | O_NONBLOCK);
+// Создает сокет для отправки событий в многоадресную группу, заданную как <IP>:<PORT>
+int createMulticastSocket(const char* group) {
+    const char* colon = strchr(group, ':');
+    if (colon == nullptr) {
+        std::cerr << "Многоадресная группа задается в виде <IP>:<PORT>" << std::endl;
+        return -1;
+    }
+    std::string groupIP(group, colon - group);
 
-    char buffer[1024];
-    struct sockaddr_in clientAddr;
-    socklen_t clientAddrLen = sizeof(clientAddr);
+    memset(&multicastAddr, 0, sizeof(multicastAddr));
+    multicastAddr.sin_family = AF_INET;
+    multicastAddr.sin_port = htons(atoi(colon + 1));
+    if (inet_pton(AF_INET, groupIP.c_str(), &multicastAddr.sin_addr) != 1 ||
+        !IN_MULTICAST(ntohl(multicastAddr.sin_addr.s_addr))) {
+        std::cerr << "Неверный адрес многоадресной группы: " << groupIP << std::endl;
+        return -1;
+    }
 
-    while (running) {
-        memset(buffer, 0, sizeof(buffer));
-        
-        int n = recvfrom(controlSockfd, buffer, sizeof(buffer) - 1, 0,
-                         (struct sockaddr*)&clientAddr, &clientAddrLen);
-        
-        if (n < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // Нет данных, ждем
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                continue;
-            } else {
-                perror("Ошибка приема в потоке управления");
-                break;
-            }
-        }
-        
-        if (n > 0) {
-            buffer[n] = '\0';
-            std::string command(buffer);
-            std::string response;
-            
-            if (command == "LIST_BEES") {
-                // Команда для получения списка всех стай
-                response = "BEES:";
-                
-                std::lock_guard<std::mutex> lock(swarmsMutex);
-                for (const auto& [id, swarm] : beeSwarms) {
-                    response += std::to_string(id) + ":" + 
-                               (swarm.active ? "1:" : "0:") + 
-                               (swarm.disconnected ? "1:" : "0:") + 
-                               std::to_string(swarm.currentSector) + ":";
-                }
-                
-            } else if (command.find("DISCONNECT_BEE:") == 0) {
-                // Команда для отключения стаи
-                int swarmId = std::stoi(command.substr(15));
-                
-                std::lock_guard<std::mutex> lock(swarmsMutex);
-                if (beeSwarms.find(swarmId) != beeSwarms.end() && beeSwarms[swarmId].active) {
-                    beeSwarms[swarmId].disconnected = true;
-                    beeSwarms[swarmId].active = false;
-                    
-                    // Освобождаем сектор, если стая находилась в поиске
-                    if (beeSwarms[swarmId].searchInProgress && beeSwarms[swarmId].currentSector >= 0) {
-                        std::lock_guard<std::mutex> sectorsLock(sectorsMutex);
-                        for (auto& sector : sectors) {
-                            if (sector.id == beeSwarms[swarmId].currentSector) {
-                                sector.assigned = false;  // Освобождаем сектор
-                                break;
-                            }
-                        }
-                        beeSwarms[swarmId].searchInProgress = false;
-                        beeSwarms[swarmId].currentSector = -1;
-                    }
-                    
-                    response = "OK:Стая #" + std::to_string(swarmId) + " отключена";
-                    std::cout << "Управление: " << response << std::endl;
-                } else {
-                    response = "ERROR:Стая #" + std::to_string(swarmId) + " не найдена или уже отключена";
-                }
-                
-            } else if (command.find("RECONNECT_BEE:") == 0) {
-                // Команда для повторного подключения стаи
-                int swarmId = std::stoi(command.substr(14));
-                
-                std::lock_guard<std::mutex> lock(swarmsMutex);
-                if (beeSwarms.find(swarmId) != beeSwarms.end() && beeSwarms[swarmId].disconnected) {
-                    beeSwarms[swarmId].disconnected = false;
-                    beeSwarms[swarmId].active = false;  // Стая должна сама активироваться при подключении
-                    
-                    response = "OK:Стая #" + std::to_string(swarmId) + " готова к переподключению";
-                    std::cout << "Управление: " << response << std::endl;
-                } else {
-                    response = "ERROR:Стая #" + std::to_string(swarmId) + " не найдена или не была отключена";
-                }
-                
-            } else if (command == "STATUS") {
-                // Команда для получения общего статуса
-                response = "STATUS:";
-                
-                // Информация о секторах
-                {
-                    std::lock_guard<std::mutex> lock(sectorsMutex);
-                    int searchedCount = 0;
-                    for (const auto& sector : sectors) {
-                        if (sector.searched) searchedCount++;
-                    }
-                    response += "SECTORS:" + std::to_string(MAX_SECTORS) + ":" + 
-                               std::to_string(searchedCount) + ":";
-                }
-                
-                // Информация о стаях
-                {
-                    std::lock_guard<std::mutex> lock(swarmsMutex);
-                    int activeCount = 0, disconnectedCount = 0;
-                    for (const auto& [id, swarm] : beeSwarms) {
-                        if (swarm.active) activeCount++;
-                        if (swarm.disconnected) disconnectedCount++;
-                    }
-                    response += "BEES:" + std::to_string(beeSwarms.size()) + ":" + 
-                               std::to_string(activeCount) + ":" + 
-                               std::to_string(disconnectedCount) + ":";
-                }
-                
-                // Информация об игре
-                response += "GAME:";
-                response += winnieFoundByBees ? "1:" : "0:";
-                response += allSectorsSearched ? "1" : "0";
-                
-            } else if (command == "HELP") {
-                // Команда для получения списка доступных команд
-                response = "COMMANDS:LIST_BEES - список стай;DISCONNECT_BEE:<id> - отключить стаю;RECONNECT_BEE:<id> - повторно подключить стаю;STATUS - получить общий статус;HELP - список команд";
-            } else {
-                response = "ERROR:Неизвестная команда. Используйте HELP для получения списка команд.";
-            }
-            
-            // Отправляем ответ
-            sendto(controlSockfd, response.c_str(), response.length(), 0,
-                   (struct sockaddr*)&clientAddr, clientAddrLen);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("Ошибка создания сокета для многоадресной рассылки");
+        return -1;
+    }
+
+    // Петля включена, чтобы мониторы на той же машине тоже получали события
+    unsigned char ttl = MULTICAST_TTL;
+    unsigned char loop = 1;
+    if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0) {
+        perror("Ошибка настройки многоадресной рассылки");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Читает сигналы завершения из signalFd: флаг running сбрасывается в цикле главного потока,
+// а не в асинхронном обработчике, и остальные потоки сразу будятся через wakeFd
+void handleSignals() {
+    struct signalfd_siginfo info;
+    while (read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+        if (running) {
+            std::cout << "\nПолучен сигнал завершения. Завершение работы сервера и клиентов..." << std::endl;
         }
+        running = false;
     }
-    
-    close(controlSockfd);
-    std::cout << "Поток управления завершен." << std::endl;
+    wakeWorkers();
 }
 
-// Поток для периодической проверки состояния
-void monitoringThread() {
-    while (running) {
-        // Проверка активности клиентов
-        checkClientsActivity();
-        
-        // Проверка, все ли секторы исследованы
-        bool allSearched = true;
-        {
-            std::lock_guard<std::mutex> lock(sectorsMutex);
-            for (const auto& sector : sectors) {
-                if (!sector.searched) {
-                    allSearched = false;
-                    break;
+// Цикл событий рабочего потока
+void runWorker(Worker& worker) {
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    currentWorker = &worker;
+
+    while (serverActive()) {
+        int nfds = epoll_wait(worker.epollFd, events, MAX_EPOLL_EVENTS, -1);
+
+        if (nfds < 0) {
+            if (errno == EINTR) continue;
+            perror("Ошибка epoll_wait");
+            break;
+        }
+        worker.metrics.epollEvents.record(nfds);
+
+        // Сигналы и таймер обрабатываются раньше сокетов того же пробуждения: вычитывание
+        // сокетов под нагрузкой не откладывает ни завершение, ни тик обслуживания
+        for (int i = 0; i < nfds; i++) {
+            int fd = events[i].data.fd;
+            if (fd == signalFd) {
+                handleSignals();
+            } else if (fd == timerFd) {
+                uint64_t expirations;
+                if (read(timerFd, &expirations, sizeof(expirations)) > 0) {
+                    // Колеса таймеров продвигаются по часам, поэтому один вызов догоняет все пропущенные тики
+                    if (expirations > 1) missedTicks.add(expirations - 1);
+                    housekeeping();
                 }
             }
         }
-        
-        if (allSearched) {
-            allSectorsSearched = true;
-            if (!winnieFoundByBees) {
-                std::cout << "Мониторинг: Все секторы исследованы, но Винни-Пух не найден." << std::endl;
+        if (!running) break;
+
+        for (int i = 0; i < nfds; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == worker.sockfd) {
+                drainSocket(worker, worker.sockfd, handleBeeMessage);
+            } else if (fd == monitorSockfd) {
+                drainSocket(worker, monitorSockfd, handleMonitorMessage);
+            } else if (fd == controlSockfd) {
+                drainSocket(worker, controlSockfd, handleControlCommand);
             }
+            // Событие на wakeFd только будит поток, условие завершения проверяется в заголовке цикла
         }
-        
-        // Пауза между проверками
-        for (int i = 0; i < 5 && running; i++) {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        }
+
+        // События мониторам рассылаются после пакета запросов и не реже тика таймера
+        if (worker.index == 0) flushEvents();
     }
-    
-    std::cout << "Поток мониторинга завершен." << std::endl;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Использование: " << argv[0] << " <IP> <PORT>" << std::endl;
+    if (argc < 3) {
+        std::cerr << "Использование: " << argv[0] << " <IP> <PORT> [--batch N] [--workers N] [--sectors N] [--multicast GROUP:PORT] [--log-level 0-3] [--loss PERCENT] [--state DIR]"
+                  << " [--policy lowest|locality|cost|priority] [--priority X0:Y0:X1:Y1] [--speculate FACTOR]" << std::endl;
+        return 1;
+    }
+
+    int sectorCount = DEFAULT_SECTORS; // Количество участков леса игры по умолчанию (параметр --sectors)
+    std::string stateDir; // Каталог журнала и снимков; пустой - состояние не сохраняется
+
+    // Необязательные параметры
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batchSize = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workerCount = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sectors") == 0 && i + 1 < argc) {
+            sectorCount = std::stoi(argv[++i]);
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            // 0 - журнал отключен, 1 - предупреждения, 2 - подключения и находки, 3 - все события
+            logLevel = std::max<int>(LOG_OFF, std::min<int>(std::stoi(argv[++i]), LOG_DEBUG));
+        } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+            // Доля датаграмм стай (в процентах), теряемых в каждом направлении
+            beeLoss.setPercent(std::stod(argv[++i]));
+        } else if (strcmp(argv[i], "--state") == 0 && i + 1 < argc) {
+            stateDir = argv[++i];
+        } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+            if (!parsePolicy(argv[++i], assignmentPolicy)) {
+                std::cerr << "Неизвестная политика назначения секторов: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--speculate") == 0 && i + 1 < argc) {
+            // 0 отключает повторную выдачу долго исследуемых секторов
+            speculationFactor = std::max(0, std::stoi(argv[++i]));
+        } else if (strcmp(argv[i], "--priority") == 0 && i + 1 < argc) {
+            // Приоритетная область - прямоугольник клеток леса, границы включаются
+            PriorityRegion region;
+            if (sscanf(argv[++i], "%d:%d:%d:%d", &region.x0, &region.y0, &region.x1, &region.y1) != 4 ||
+                (int)priorityRegions.size() >= MAX_PRIORITY_REGIONS) {
+                std::cerr << "Неверная приоритетная область: " << argv[i] << std::endl;
+                return 1;
+            }
+            priorityRegions.push_back(region);
+        } else if (strcmp(argv[i], "--multicast") == 0 && i + 1 < argc) {
+            multicastSockfd = createMulticastSocket(argv[++i]);
+            if (multicastSockfd < 0) return 1;
+        } else {
+            std::cerr << "Неизвестный параметр: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (assignmentPolicy == POLICY_PRIORITY && priorityRegions.empty()) {
+        std::cerr << "Для политики priority нужна хотя бы одна область --priority X0:Y0:X1:Y1" << std::endl;
         return 1;
     }
+    batchSize = std::max(1, std::min(batchSize, MAX_BATCH_SIZE));
+    workerCount = std::max(1, std::min(workerCount, MAX_WORKERS));
+    sectorCount = std::max(1, std::min(sectorCount, MAX_SECTORS));
 
-    // Установка обработчика сигналов для корректного завершения
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    // SIGINT/SIGTERM блокируются до запуска любых потоков, поэтому все потоки наследуют маску
+    // и сигналы не прерывают их системные вызовы; доставляются они только через signalFd
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigaddset(&shutdownSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, nullptr);
+    signalFd = signalfd(-1, &shutdownSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalFd < 0) {
+        perror("Ошибка создания signalfd");
+        return 1;
+    }
 
     const char* serverIP = argv[1];
     int serverPort = std::stoi(argv[2]);
     int monitorPort = serverPort + MONITOR_PORT_OFFSET;
     int controlPort = serverPort + CONTROL_PORT_OFFSET;
 
-    // Инициализация секторов леса
+    // Восстановление игры, прерванной остановкой или сбоем сервера
+    WalState savedState;
+    bool restored = false;
+    size_t replayed = 0;
+    int64_t recoveryStart = monotonicMs();
+    if (!stateDir.empty() && journal.recover(stateDir, savedState, replayed)) {
+        if (savedState.finished()) {
+            std::cout << "Сервер: Сохраненная игра уже завершена, начинается новая" << std::endl;
+        } else {
+            restored = true;
+            sectorCount = savedState.sectorCount;
+        }
+    }
+
+    // Игра по умолчанию: Винни-Пух случайно размещается в одном из секторов леса
     {
-        std::lock_guard<std::mutex> lock(sectorsMutex);
-        sectors.clear();
-        for (int i = 0; i < MAX_SECTORS; i++) {
-            sectors.push_back({i, false, false, false});
-        }
-        
-        // Случайно размещаем Винни-Пуха в одном из секторов
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> distrib(0, MAX_SECTORS - 1);
-        winnieSector = distrib(gen);
+        std::shared_ptr<Game> game = makeGame(BEE_DEFAULT_GAME, sectorCount, restored ? savedState.winnieSector : -1);
+        defaultGame = game.get();
+        publishGameSlot(BEE_DEFAULT_GAME, std::move(game));
     }
-    
-    std::cout << "Сервер: Винни-Пух находится в секторе " << winnieSector << std::endl;
 
-    // Создание UDP сокета для пчел
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd < 0) {
-        perror("Ошибка создания сокета для пчел");
-        return 1;
+    std::cout << "Сервер: Винни-Пух находится в секторе " << defaultGame->winnieSector << std::endl;
+
+    // Колеса таймеров активности клиентов
+    {
+        int64_t now = monotonicMs();
+        for (int s = 0; s < workerCount; s++) {
+            swarmShards[s].liveness.init(now, LIVENESS_TICK_MS, TIMER_WHEEL_SLOTS);
+            swarmShards[s].leases.init(now, LIVENESS_TICK_MS, TIMER_WHEEL_SLOTS);
+        }
+        monitorLiveness.init(now, LIVENESS_TICK_MS, TIMER_WHEEL_SLOTS);
     }
 
-    struct sockaddr_in serverAddr;
-    memset(&serverAddr, 0, sizeof(serverAddr));
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = inet_addr(serverIP);
-    serverAddr.sin_port = htons(serverPort);
+    // Восстановленное состояние становится первым снимком нового журнала
+    if (restored) {
+        restoreGameState(savedState);
+        std::cout << "Сервер: Игра восстановлена из " << stateDir << " за " << monotonicMs() - recoveryStart
+                  << " мс: исследовано секторов " << defaultGame->searchedSectorsCount << " из " << sectorCount
+                  << ", стай " << savedState.swarms.size() << ", применено записей журнала " << replayed << std::endl;
+    }
+    if (!stateDir.empty()) {
+        WalState initial;
+        captureGameState(initial);
+        initial.lastSequence = savedState.lastSequence;
 
-    if (bind(sockfd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
-        perror("Ошибка привязки сокета для пчел");
-        close(sockfd);
-        return 1;
+        if (!journal.start(stateDir, initial, captureGameState)) return 1;
+    }
+
+    // Начальный (пустой) снимок таблицы стай, чтобы читателям всегда было что читать
+    refreshHiveSnapshot();
+
+    // Создание UDP сокетов для пчел: по одному на рабочий поток
+    for (int i = 0; i < workerCount; i++) {
+        std::unique_ptr<Worker> worker(new Worker());
+        worker->index = i;
+        worker->sockfd = createBeeSocket(serverIP, serverPort, workerCount > 1);
+        if (worker->sockfd < 0) {
+            for (auto& w : workers) close(w->sockfd);
+            return 1;
+        }
+        worker->beeReplies.fd = worker->sockfd;
+        workers.push_back(std::move(worker));
     }
+    Worker& mainWorker = *workers[0];
 
     // Создание UDP сокета для мониторов
     monitorSockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (monitorSockfd < 0) {
         perror("Ошибка создания сокета для мониторов");
-        close(sockfd);
+        for (auto& w : workers) close(w->sockfd);
         return 1;
     }
 
@@ -472,371 +2613,186 @@ int main(int argc, char* argv[]) {
 
     if (bind(monitorSockfd, (struct sockaddr*)&monitorServerAddr, sizeof(monitorServerAddr)) < 0) {
         perror("Ошибка привязки сокета для мониторов");
-        close(sockfd);
+        for (auto& w : workers) close(w->sockfd);
+        close(monitorSockfd);
+        return 1;
+    }
+    mainWorker.monitorReplies.fd = monitorSockfd;
+
+    // Создание UDP сокета для управляющего интерфейса
+    controlSockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (controlSockfd < 0) {
+        perror("Ошибка создания сокета для управления");
+        for (auto& w : workers) close(w->sockfd);
+        close(monitorSockfd);
+        return 1;
+    }
+
+    struct sockaddr_in controlAddr;
+    memset(&controlAddr, 0, sizeof(controlAddr));
+    controlAddr.sin_family = AF_INET;
+    controlAddr.sin_addr.s_addr = inet_addr(serverIP);
+    controlAddr.sin_port = htons(controlPort);
+
+    if (bind(controlSockfd, (struct sockaddr*)&controlAddr, sizeof(controlAddr)) < 0) {
+        perror("Ошибка привязки сокета для управления");
+        for (auto& w : workers) close(w->sockfd);
+        close(monitorSockfd);
+        close(controlSockfd);
+        return 1;
+    }
+
+    // Таймер для периодической проверки активности клиентов и состояния игры
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    wakeFd = eventfd(0, EFD_NONBLOCK);
+    if (timerFd < 0 || wakeFd < 0) {
+        perror("Ошибка создания таймера");
+        for (auto& w : workers) close(w->sockfd);
         close(monitorSockfd);
+        close(controlSockfd);
         return 1;
     }
 
-    // Запуск потока управления для обработки команд
-    std::thread controlThread(controlThreadFunction, serverIP, controlPort);
-    
-    // Запуск потока мониторинга
-    std::thread monitThread(monitoringThread);
+    struct itimerspec timerSpec;
+    memset(&timerSpec, 0, sizeof(timerSpec));
+    timerSpec.it_value.tv_nsec = LIVENESS_TICK_MS * 1000000L;
+    timerSpec.it_interval.tv_nsec = LIVENESS_TICK_MS * 1000000L;
+    timerfd_settime(timerFd, 0, &timerSpec, nullptr);
 
     std::cout << "Сервер запущен на " << serverIP << ":" << serverPort << std::endl;
     std::cout << "Порт для мониторов: " << monitorPort << std::endl;
     std::cout << "Порт для управления: " << controlPort << std::endl;
+    std::cout << "Рабочих потоков: " << workerCount << std::endl;
+    const ForestGrid& forest = defaultGame->sectorAssigner.grid();
+    std::cout << "Политика назначения секторов: " << policyName(assignmentPolicy) << ", лес " << forest.width
+              << "x" << forest.height << ", улей в клетке (" << forest.hiveX() << ", " << forest.hiveY() << ")" << std::endl;
+    if (multicastSockfd >= 0) {
+        std::cout << "События мониторам рассылаются в группу " << inet_ntoa(multicastAddr.sin_addr)
+                  << ":" << ntohs(multicastAddr.sin_port) << std::endl;
+    }
     std::cout << "Ожидание пчел и мониторов..." << std::endl;
 
-    // Неблокирующий режим для мониторинга обоих сокетов
-    int flags = fcntl(sockfd, F_GETFL, 0);
-    fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
-    flags = fcntl(monitorSockfd, F_GETFL, 0);
+    // Неблокирующий режим, чтобы вычитывать сокеты до конца за одно пробуждение
+    int flags = fcntl(monitorSockfd, F_GETFL, 0);
     fcntl(monitorSockfd, F_SETFL, flags | O_NONBLOCK);
+    flags = fcntl(controlSockfd, F_GETFL, 0);
+    fcntl(controlSockfd, F_SETFL, flags | O_NONBLOCK);
 
-    struct sockaddr_in clientAddr;
-    socklen_t addrLen = sizeof(clientAddr);
-    
-    struct sockaddr_in monitorAddr;
-    socklen_t monitorAddrLen = sizeof(monitorAddr);
-
-    // Основной цикл сервера
-    while (running && (!allSectorsSearched || !winnieFoundByBees)) {
-        char buffer[1024] = {0};
-        
-        // Проверяем сообщения от пчел
-        int n = recvfrom(sockfd, buffer, sizeof(buffer), 0, (struct sockaddr*)&clientAddr, &addrLen);
-        
-        if (n > 0) {
-            buffer[n] = '\0';
-            std::string message(buffer);
-            std::string clientIP = inet_ntoa(clientAddr.sin_addr);
-            int clientPort = ntohs(clientAddr.sin_port);
-            
-            // Обработка сообщений от стай пчел
-            if (message.find("HEARTBEAT:") == 0) {
-                // Обрабатываем сигнал активности от стаи
-                int swarmId;
-                if (sscanf(buffer + 10, "%d", &swarmId) == 1) {
-                    std::lock_guard<std::mutex> lock(swarmsMutex);
-                    if (beeSwarms.find(swarmId) != beeSwarms.end() && !beeSwarms[swarmId].disconnected) {
-                        beeSwarms[swarmId].lastSeen = time(nullptr);
-                        
-                        // Отправляем ответ для поддержания соединения
-                        char response[] = "HEARTBEAT_ACK";
-                        sendto(sockfd, response, strlen(response), 0, (struct sockaddr*)&clientAddr, addrLen);
-                    }
-                }
-                
-            } else if (message.find("REQUEST:") == 0) {
-                // Если Винни-Пух уже найден, отправляем сообщение о завершении поиска
-                if (winnieFoundByBees) {
-                    char response[] = "WINNIE_FOUND";
-                    sendto(sockfd, response, strlen(response), 0, (struct sockaddr*)&clientAddr, addrLen);
-                    continue;
-                }
-                
-                // Обрабатываем запрос на поиск сектора
-                int swarmId;
-                if (sscanf(buffer + 8, "%d", &swarmId) == 1) {
-                    bool allowRequest = false;
-                    
-                    // Проверяем и обновляем информацию о стае
-                    {
-                        std::lock_guard<std::mutex> lock(swarmsMutex);
-                        if (beeSwarms.find(swarmId) == beeSwarms.end()) {
-                            // Новая стая
-                            beeSwarms[swarmId] = {swarmId, -1, true, false, false, clientIP, clientPort, time(nullptr)};
-                            std::cout << "Сервер: Стая #" << swarmId << " подключена" << std::endl;
-                            allowRequest = true;
-                        } else if (!beeSwarms[swarmId].disconnected) {
-                            // Существующая активная стая
-                            beeSwarms[swarmId].lastSeen = time(nullptr);
-                            beeSwarms[swarmId].ip = clientIP;
-                            beeSwarms[swarmId].port = clientPort;
-                            
-                            // Разрешаем запрос только если стая не выполняет поиск
-                            if (!beeSwarms[swarmId].searchInProgress) {
-                                beeSwarms[swarmId].active = true;
-                                allowRequest = true;
-                            }
-                        } else if (beeSwarms[swarmId].disconnected) {
-                            // Отключенная стая пытается переподключиться
-                            if (!beeSwarms[swarmId].active) {
-                                beeSwarms[swarmId].disconnected = false;
-                                beeSwarms[swarmId].active = true;
-                                beeSwarms[swarmId].lastSeen = time(nullptr);
-                                beeSwarms[swarmId].ip = clientIP;
-                                beeSwarms[swarmId].port = clientPort;
-                                beeSwarms[swarmId].searchInProgress = false;
-                                beeSwarms[swarmId].currentSector = -1;
-                                std::cout << "Сервер: Стая #" << swarmId << " переподключена" << std::endl;
-                                allowRequest = true;
-                            }
-                        }
-                    }
-                    
-                    if (!allowRequest) {
-                        // Отказываем в запросе
-                        char response[] = "DENIED";
-                        sendto(sockfd, response, strlen(response), 0, (struct sockaddr*)&clientAddr, addrLen);
-                        continue;
-                    }
-                    
-                    // Поиск неисследованного и неназначенного сектора
-                    int sectorToSearch = -1;
-                    {
-                        std::lock_guard<std::mutex> lock(sectorsMutex);
-                        for (auto& sector : sectors) {
-                            if (!sector.searched && !sector.assigned) {
-                                sectorToSearch = sector.id;
-                                sector.assigned = true;  // Помечаем сектор как назначенный
-                                break;
-                            }
-                        }
-                    }
-                    
-                    if (sectorToSearch == -1) {
-                        // Нет доступных секторов
-                        std::cout << "Сервер: Все доступные секторы назначены" << std::endl;
-                        char response[] = "NO_MORE_SECTORS";
-                        sendto(sockfd, response, strlen(response), 0, (struct sockaddr*)&clientAddr, addrLen);
-                        
-                        // Проверяем, все ли секторы исследованы
-                        bool allSearched = true;
-                        {
-                            std::lock_guard<std::mutex> lock(sectorsMutex);
-                            for (const auto& sector : sectors) {
-                                if (!sector.searched) {
-                                    allSearched = false;
-                                    break;
-                                }
-                            }
-                        }
-                        
-                        if (allSearched) {
-                            allSectorsSearched = true;
-                        }
-                    } else {
-                        // Отправляем номер сектора для исследования
-                        char response[32];
-                        sprintf(response, "SEARCH:%d", sectorToSearch);
-                        sendto(sockfd, response, strlen(response), 0, (struct sockaddr*)&clientAddr, addrLen);
-                        std::cout << "Сервер: Стая #" << swarmId << " направлена в сектор " << sectorToSearch << std::endl;
-                        
-                        // Обновляем статус стаи
-                        std::lock_guard<std::mutex> lock(swarmsMutex);
-                        beeSwarms[swarmId].currentSector = sectorToSearch;
-                        beeSwarms[swarmId].searchInProgress = true;
-                    }
-                }
-                
-            } else if (message.find("REPORT:") == 0) {
-                // Обрабатываем отчет о поиске
-                int swarmId, sectorId;
-                if (sscanf(buffer + 7, "%d:%d:", &swarmId, &sectorId) == 2) {
-                    // Обновляем время последней активности
-                    {
-                        std::lock_guard<std::mutex> lock(swarmsMutex);
-                        if (beeSwarms.find(swarmId) != beeSwarms.end() && !beeSwarms[swarmId].disconnected) {
-                            beeSwarms[swarmId].lastSeen = time(nullptr);
-                            beeSwarms[swarmId].searchInProgress = false;  // Поиск завершен
-                            beeSwarms[swarmId].currentSector = -1;        // Стая вернулась в улей
-                        } else {
-                            // Если стая не зарегистрирована или отключена, игнорируем отчет
-                            continue;
-                        }
-                    }
-                    
-                    // Проверяем, находится ли Винни-Пух в этом секторе
-                    bool isWinnieInSector = (sectorId == winnieSector);
-                    
-                    // Обновляем статус сектора
-                    {
-                        std::lock_guard<std::mutex> lock(sectorsMutex);
-                        for (auto& sector : sectors) {
-                            if (sector.id == sectorId) {
-                                sector.searched = true;      // Отмечаем сектор как исследованный
-                                sector.assigned = false;     // Сектор больше не назначен
-                                if (isWinnieInSector) {
-                                    sector.winnieFound = true;
-                                }
-                                break;
-                            }
-                        }
-                    }
-                    
-                    if (isWinnieInSector) {
-                        std::cout << "Сервер: Стая пчел #" << swarmId << " сообщает, что Винни-Пух найден в секторе " << sectorId << " и наказан!" << std::endl;
-                        winnieFoundByBees = true;
-                        
-                        // Отправляем подтверждение о находке стае, которая нашла Винни-Пуха
-                        char response[] = "WINNIE_FOUND";
-                        sendto(sockfd, response, strlen(response), 0, (struct sockaddr*)&clientAddr, addrLen);
-                        
-                        // Уведомляем все другие стаи о находке
-                        notifyAllSwarmsWinnieFound();
-                    } else {
-                        std::cout << "Сервер: Стая пчел #" << swarmId << " сообщает, что сектор " << sectorId << " проверен, Винни-Пух не обнаружен" << std::endl;
-                        
-                        // Отправляем подтверждение и инструкцию продолжить поиск
-                        char response[] = "CONTINUE";
-                        sendto(sockfd, response, strlen(response), 0, (struct sockaddr*)&clientAddr, addrLen);
-                    }
-                }
-                
-            } else if (message == "DISCONNECT") {
-                // Обрабатываем запрос на отключение
-                int swarmIdToDisconnect = -1;
-                
-                // Ищем стаю по IP и порту
-                {
-                    std::lock_guard<std::mutex> lock(swarmsMutex);
-                    for (const auto& [id, swarm] : beeSwarms) {
-                        if (swarm.ip == clientIP && swarm.port == clientPort) {
-                            swarmIdToDisconnect = id;
-                            break;
-                        }
-                    }
-                    
-                    if (swarmIdToDisconnect != -1) {
-                        std::cout << "Сервер: Стая #" << swarmIdToDisconnect << " запросила отключение" << std::endl;
-                        beeSwarms[swarmIdToDisconnect].disconnected = true;
-                        beeSwarms[swarmIdToDisconnect].active = false;
-                        
-                        // Если стая выполняла поиск, освобождаем сектор
-                        if (beeSwarms[swarmIdToDisconnect].searchInProgress && beeSwarms[swarmIdToDisconnect].currentSector >= 0) {
-                            std::lock_guard<std::mutex> sectorsLock(sectorsMutex);
-                            for (auto& sector : sectors) {
-                                if (sector.id == beeSwarms[swarmIdToDisconnect].currentSector) {
-                                    sector.assigned = false;  // Освобождаем сектор
-                                    break;
-                                }
-                            }
-                        }
-                        
-                        beeSwarms[swarmIdToDisconnect].searchInProgress = false;
-                        beeSwarms[swarmIdToDisconnect].currentSector = -1;
-                    }
-                }
-                
-                // Отправляем подтверждение отключения
-                char response[] = "DISCONNECT_ACK";
-                sendto(sockfd, response, strlen(response), 0, (struct sockaddr*)&clientAddr, addrLen);
-            }
-        }
-        
-        // Проверяем сообщения от мониторов
-        memset(buffer, 0, sizeof(buffer));
-        n = recvfrom(monitorSockfd, buffer, sizeof(buffer), 0, (struct sockaddr*)&monitorAddr, &monitorAddrLen);
-        
-        if (n > 0) {
-            buffer[n] = '\0';
-            std::string message(buffer);
-            std::string monitorIP = inet_ntoa(monitorAddr.sin_addr);
-            int monitorPort = ntohs(monitorAddr.sin_port);
-            
-            if (message == "CONNECT_MONITOR") {
-                // Регистрируем новый монитор
-                {
-                    std::lock_guard<std::mutex> lock(monitorsMutex);
-                    Monitor newMonitor = {monitorIP, monitorPort, time(nullptr)};
-                    monitors.insert(newMonitor);
-                }
-                
-                std::cout << "Сервер: Монитор подключен с " << monitorIP << ":" << monitorPort << std::endl;
-                
-                // Отправляем начальную информацию
-                char response[1024];
-                sprintf(response, "INIT:%d:%d", MAX_SECTORS, winnieSector);
-                sendto(monitorSockfd, response, strlen(response), 0, (struct sockaddr*)&monitorAddr, monitorAddrLen);
-                
-            } else if (message == "STATUS") {
-                // Обновляем время последнего контакта с монитором
-                {
-                    std::lock_guard<std::mutex> lock(monitorsMutex);
-                    for (auto& monitor : monitors) {
-                        if (monitor.ip == monitorIP && monitor.port == monitorPort) {
-                            const_cast<Monitor&>(monitor).lastSeen = time(nullptr);
-                            break;
-                        }
-                    }
-                }
-                
-                // Формируем статусное сообщение для монитора
-                std::string status = "STATUS:";
-                
-                // Добавляем информацию о секторах
-                {
-                    std::lock_guard<std::mutex> lock(sectorsMutex);
-                    for (const auto& sector : sectors) {
-                        status += std::to_string(sector.id) + ":" + 
-                                (sector.searched ? "1:" : "0:") + 
-                                (sector.winnieFound ? "1:" : "0:");
-                    }
-                }
-                
-                status += "BEES:";
-                
-                // Добавляем информацию о стаях
-                {
-                    std::lock_guard<std::mutex> lock(swarmsMutex);
-                    for (const auto& [id, swarm] : beeSwarms) {
-                        status += std::to_string(swarm.id) + ":" + 
-                                std::to_string(swarm.currentSector) + ":" + 
-                                (swarm.active ? "1:" : "0:") +
-                                (swarm.disconnected ? "1:" : "0:");
-                    }
-                }
-                
-                // Добавляем общий статус игры
-                status += "GAME:";
-                status += winnieFoundByBees ? "1:" : "0:";
-                status += allSectorsSearched ? "1" : "0";
-                
-                sendto(monitorSockfd, status.c_str(), status.length(), 0, 
-                      (struct sockaddr*)&monitorAddr, monitorAddrLen);
-                
-            } else if (message == "DISCONNECT_MONITOR") {
-                // Удаляем монитор из списка
-                {
-                    std::lock_guard<std::mutex> lock(monitorsMutex);
-                    for (auto it = monitors.begin(); it != monitors.end(); ) {
-                        if (it->ip == monitorIP && it->port == monitorPort) {
-                            it = monitors.erase(it);
-                            std::cout << "Сервер: Монитор отключен с " << monitorIP << ":" << monitorPort << std::endl;
-                        } else {
-                            ++it;
-                        }
-                    }
-                }
+    // Свой epoll у каждого рабочего потока; мониторы, управление и таймер - только у главного
+    for (auto& w : workers) {
+        w->epollFd = epoll_create1(0);
+        bool ok = w->epollFd >= 0 && addToEpoll(w->epollFd, w->sockfd) && addToEpoll(w->epollFd, wakeFd);
+        if (ok && w->index == 0) {
+            ok = addToEpoll(w->epollFd, monitorSockfd) && addToEpoll(w->epollFd, controlSockfd) &&
+                 addToEpoll(w->epollFd, timerFd) && addToEpoll(w->epollFd, signalFd);
+        }
+        if (!ok) {
+            perror("Ошибка настройки epoll");
+            for (auto& w2 : workers) {
+                close(w2->sockfd);
+                if (w2->epollFd >= 0) close(w2->epollFd);
             }
+            close(monitorSockfd);
+            close(controlSockfd);
+            close(timerFd);
+            close(signalFd);
+            close(wakeFd);
+            return 1;
         }
-        
-        // Небольшая пауза для уменьшения нагрузки на CPU
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
-    
-    // Устанавливаем флаг для завершения потоков
+
+    startLogWriter();
+    for (int i = 1; i < workerCount; i++) {
+        Worker* worker = workers[i].get();
+        worker->thread = std::thread([worker]() { runWorker(*worker); });
+    }
+
+    // Основной цикл сервера
+    runWorker(mainWorker);
+
+    // Устанавливаем флаг для завершения потоков и будим их
     running = false;
-    
+    wakeWorkers();
+
     // Ждем завершения потоков
-    if (controlThread.joinable()) controlThread.join();
-    if (monitThread.joinable()) monitThread.join();
+    for (auto& w : workers) {
+        if (w->thread.joinable()) w->thread.join();
+    }
+
+    // Фиксируем последние изменения состояния; дальше игра не меняется
+    journal.stop();
+
+    // Выводим накопленные записи журнала до итоговых сообщений
+    drainLogRings();
 
     std::cout << "Сервер: Поиск завершен!" << std::endl;
-    if (winnieFoundByBees) {
+    if (defaultGame->winnieFoundByBees) {
         std::cout << "Сервер: Винни-Пух был найден и наказан!" << std::endl;
-    } else if (allSectorsSearched) {
+    } else if (defaultGame->allSectorsSearched) {
         std::cout << "Сервер: Все секторы проверены, но Винни-Пух не найден." << std::endl;
     }
-    
+
+    // Последние события до сообщения о завершении, чтобы мониторы показали итог игры
+    flushEvents();
+
     // Отправляем сообщение о завершении всем клиентам
-    notifyClientsServerShutdown();
-    
+    notifyClientsServerShutdown(mainWorker);
+    stopLogWriter();
+
+    unsigned long recvCalls = 0, recvDatagrams = 0, sendCalls = 0, sendDatagrams = 0;
+    for (const auto& w : workers) {
+        recvCalls += w->stats.recvCalls.get();
+        recvDatagrams += w->stats.recvDatagrams.get();
+        sendCalls += w->stats.sendCalls.get();
+        sendDatagrams += w->stats.sendDatagrams.get();
+    }
+    std::cout << "Сервер: Пакетный ввод-вывод (размер пакета " << batchSize << "): принято "
+              << recvDatagrams << " датаграмм за " << recvCalls << " вызовов recvmmsg (в среднем "
+              << averageBatch(recvDatagrams, recvCalls) << "), отправлено "
+              << sendDatagrams << " за " << sendCalls << " вызовов sendmmsg (в среднем "
+              << averageBatch(sendDatagrams, sendCalls) << ")" << std::endl;
+    std::unique_ptr<MetricsTotals> metrics = collectMetrics();
+    if (metrics->messages.count > 0) {
+        std::cout << "Сервер: Обработка сообщений пчел: " << metrics->messages.count << ", p50 "
+                  << metrics->messages.percentile(0.5) / 1000.0 << " мкс, p99 " << metrics->messages.percentile(0.99) / 1000.0
+                  << " мкс, p99.9 " << metrics->messages.percentile(0.999) / 1000.0 << " мкс; мьютексы шардов заняты при "
+                  << metrics->lockWait.count << " из " << metrics->lockAcquired << " захватов" << std::endl;
+    }
+    if (!stateDir.empty()) {
+        std::cout << "Сервер: Журнал состояния: записей " << journal.recordsWritten() << " за "
+                  << journal.syncCount() << " вызовов fdatasync (в среднем "
+                  << averageBatch(journal.recordsWritten(), journal.syncCount()) << "), снимков "
+                  << journal.snapshotCount() << ", потеряно при переполнении " << journal.droppedCount() << std::endl;
+    }
+    unsigned long assigned = defaultGame->assignedSectors.load();
+    if (assigned > 0) {
+        double flight = defaultGame->flightDistance.load() / 1000.0;
+        std::cout << "Сервер: Назначение секторов (" << policyName(assignmentPolicy) << "): выдано " << assigned
+                  << ", перелет " << (unsigned long)flight << " (в среднем " << flight / assigned << " на сектор), оценка поиска "
+                  << defaultGame->searchCost.load() << ", игра длилась " << gameDurationMs(*defaultGame) << " мс" << std::endl;
+    }
+    if (defaultGame->speculativeAssigned > 0) {
+        std::cout << "Сервер: Повторная выдача секторов: копий " << defaultGame->speculativeAssigned.load() << ", опередили первую стаю "
+                  << defaultGame->speculativeWins.load() << ", не пригодились " << defaultGame->speculativeLosses.load() << std::endl;
+    }
+    if (missedTicks.get() > 0) {
+        std::cout << "Сервер: Пропущено тиков обслуживания (" << LIVENESS_TICK_MS << " мс): " << missedTicks.get() << std::endl;
+    }
+    if (beeLoss.droppedCount() > 0) {
+        std::cout << "Сервер: Искусственно потеряно датаграмм стай: " << beeLoss.droppedCount() << std::endl;
+    }
+
     // Закрываем сокеты
-    close(sockfd);
+    for (auto& w : workers) {
+        close(w->epollFd);
+        close(w->sockfd);
+    }
+    close(wakeFd);
+    close(timerFd);
+    close(signalFd);
+    close(controlSockfd);
     close(monitorSockfd);
+    if (multicastSockfd >= 0) close(multicastSockfd);
     std::cout << "Сервер: Работа завершена." << std::endl;
     return 0;
 }
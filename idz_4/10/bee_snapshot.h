@@ -0,0 +1,85 @@
+// bee_snapshot.h
+#ifndef BEE_SNAPSHOT_H
+#define BEE_SNAPSHOT_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Публикация неизменяемых снимков состояния в стиле RCU.
+// Писатель (один поток) создает новый снимок и атомарно подменяет указатель на него;
+// читатели получают снимок без блокировок. Старый снимок удаляется, когда ни один
+// читатель, который мог его видеть, больше не находится внутри секции чтения
+// (освобождение по эпохам).
+template <class T, int MaxReaders>
+class SnapshotDomain {
+public:
+    SnapshotDomain() {
+        for (int i = 0; i < MaxReaders; i++) readerEpochs[i].store(0);
+    }
+
+    ~SnapshotDomain() {
+        delete current.load();
+        for (auto& [snapshot, epoch] : retired) delete snapshot;
+    }
+
+    // Секция чтения: пока объект жив, снимок не будет удален.
+    // Каждый поток-читатель использует собственный номер слота
+    class ReadGuard {
+    public:
+        ReadGuard(SnapshotDomain& domain, int slot) : domain(domain), slot(slot) {
+            domain.readerEpochs[slot].store(domain.globalEpoch.load());
+            snapshot = domain.current.load();
+        }
+        ~ReadGuard() { domain.readerEpochs[slot].store(0); }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        const T* get() const { return snapshot; }
+        const T* operator->() const { return snapshot; }
+
+    private:
+        SnapshotDomain& domain;
+        int slot;
+        const T* snapshot;
+    };
+
+    // Текущий снимок для писателя (только из потока писателя)
+    const T* latest() const { return current.load(); }
+
+    // Публикует новый снимок и освобождает старые, которые больше никто не читает.
+    // Вызывается только из потока писателя
+    void publish(T* next) {
+        T* previous = current.exchange(next);
+        uint64_t epoch = globalEpoch.fetch_add(1);
+        if (previous != nullptr) retired.push_back({previous, epoch});
+        reclaim();
+    }
+
+private:
+    void reclaim() {
+        // Минимальная эпоха среди читателей внутри секции чтения
+        uint64_t oldestReader = UINT64_MAX;
+        for (int i = 0; i < MaxReaders; i++) {
+            uint64_t epoch = readerEpochs[i].load();
+            if (epoch != 0) oldestReader = std::min(oldestReader, epoch);
+        }
+
+        // Снимок, снятый в эпоху E, мог видеть только читатель с эпохой не больше E
+        auto it = std::remove_if(retired.begin(), retired.end(), [oldestReader](const std::pair<T*, uint64_t>& entry) {
+            if (entry.second >= oldestReader) return false;
+            delete entry.first;
+            return true;
+        });
+        retired.erase(it, retired.end());
+    }
+
+    std::atomic<T*> current{nullptr};
+    std::atomic<uint64_t> globalEpoch{1}; // 0 в слоте читателя означает "вне секции чтения"
+    std::atomic<uint64_t> readerEpochs[MaxReaders];
+    std::vector<std::pair<T*, uint64_t>> retired; // Только для писателя
+};
+
+#endif // BEE_SNAPSHOT_H
@@ -0,0 +1,139 @@
+// bee_swarm_table.h
+#ifndef BEE_SWARM_TABLE_H
+#define BEE_SWARM_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Хеш-таблица с открытой адресацией и линейным пробированием.
+// Значения лежат прямо в массиве ячеек, поэтому поиск - одно вычисление хеша и
+// просмотр нескольких соседних ячеек без выделения памяти и переходов по указателям.
+// Удаление сдвигает следующие элементы цепочки назад, поэтому "надгробий" нет.
+// Указатели на значения действительны до следующей вставки или удаления.
+// Потокобезопасность обеспечивает владелец таблицы
+template <class Value>
+class FlatTable {
+public:
+    static constexpr uint64_t EMPTY_KEY = UINT64_MAX; // Ключ свободной ячейки, в таблицу не вставляется
+
+    struct Slot {
+        uint64_t key;
+        Value value;
+    };
+
+    FlatTable() { rehash(MIN_CAPACITY); }
+
+    // Значение по ключу или nullptr
+    Value* find(uint64_t key) {
+        for (size_t i = indexFor(key); ; i = (i + 1) & mask) {
+            if (slots[i].key == key) return &slots[i].value;
+            if (slots[i].key == EMPTY_KEY) return nullptr;
+        }
+    }
+
+    // Значение по ключу; отсутствующий ключ вставляется со значением по умолчанию.
+    // inserted сообщает, был ли ключ вставлен
+    Value& insert(uint64_t key, bool& inserted) {
+        if ((count + 1) * MAX_LOAD_DEN > slots.size() * MAX_LOAD_NUM) rehash(slots.size() * 2);
+
+        size_t i = indexFor(key);
+        for (; slots[i].key != EMPTY_KEY; i = (i + 1) & mask) {
+            if (slots[i].key == key) {
+                inserted = false;
+                return slots[i].value;
+            }
+        }
+        slots[i].key = key;
+        slots[i].value = Value();
+        count++;
+        inserted = true;
+        return slots[i].value;
+    }
+
+    // Удаляет ключ; возвращает false, если его не было
+    bool erase(uint64_t key) {
+        size_t i = indexFor(key);
+        for (; slots[i].key != key; i = (i + 1) & mask) {
+            if (slots[i].key == EMPTY_KEY) return false;
+        }
+
+        // Сдвигаем назад элементы, чья исходная ячейка не лежит между освобожденной и текущей
+        size_t hole = i;
+        for (size_t j = (i + 1) & mask; slots[j].key != EMPTY_KEY; j = (j + 1) & mask) {
+            size_t home = indexFor(slots[j].key);
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                slots[hole] = std::move(slots[j]);
+                hole = j;
+            }
+        }
+        slots[hole].key = EMPTY_KEY;
+        slots[hole].value = Value();
+        count--;
+        return true;
+    }
+
+    size_t size() const { return count; }
+
+    // Обход занятых ячеек: for (auto& [key, value] : table)
+    template <class SlotType>
+    class Iterator {
+    public:
+        Iterator(SlotType* slot, SlotType* end) : slot(slot), end(end) { skipEmpty(); }
+        SlotType& operator*() const { return *slot; }
+        SlotType* operator->() const { return slot; }
+        Iterator& operator++() {
+            ++slot;
+            skipEmpty();
+            return *this;
+        }
+        bool operator!=(const Iterator& other) const { return slot != other.slot; }
+
+    private:
+        void skipEmpty() {
+            while (slot != end && slot->key == EMPTY_KEY) ++slot;
+        }
+        SlotType* slot;
+        SlotType* end;
+    };
+
+    Iterator<Slot> begin() { return Iterator<Slot>(slots.data(), slots.data() + slots.size()); }
+    Iterator<Slot> end() { return Iterator<Slot>(slots.data() + slots.size(), slots.data() + slots.size()); }
+    Iterator<const Slot> begin() const { return Iterator<const Slot>(slots.data(), slots.data() + slots.size()); }
+    Iterator<const Slot> end() const { return Iterator<const Slot>(slots.data() + slots.size(), slots.data() + slots.size()); }
+
+private:
+    static constexpr size_t MIN_CAPACITY = 16;
+    static constexpr size_t MAX_LOAD_NUM = 3; // Максимальная заполненность 3/4
+    static constexpr size_t MAX_LOAD_DEN = 4;
+
+    // Фибоначчиево хеширование: последовательные номера стай расходятся по всей таблице
+    size_t indexFor(uint64_t key) const {
+        return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> shift);
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.resize(capacity);
+        for (Slot& slot : slots) slot.key = EMPTY_KEY;
+        mask = capacity - 1;
+        shift = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) shift--;
+
+        for (Slot& slot : old) {
+            if (slot.key == EMPTY_KEY) continue;
+            size_t i = indexFor(slot.key);
+            while (slots[i].key != EMPTY_KEY) i = (i + 1) & mask;
+            slots[i] = std::move(slot);
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+    size_t mask = 0;
+    int shift = 64;
+};
+
+#endif // BEE_SWARM_TABLE_H
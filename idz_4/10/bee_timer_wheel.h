@@ -0,0 +1,115 @@
+// bee_timer_wheel.h
+#ifndef BEE_TIMER_WHEEL_H
+#define BEE_TIMER_WHEEL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Монотонное время в миллисекундах
+inline int64_t monotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Хешированное колесо таймеров для отслеживания активности клиентов.
+// Каждый ключ (номер стаи или адрес монитора) имеет не больше одного таймера.
+// Перепланирование при каждом сигнале активности - перенос узла списка в другую ячейку
+// через splice, без выделения памяти и без просмотра остальных клиентов.
+// На каждом тике просматривается только ячейка текущего тика, поэтому активные клиенты
+// ничего не стоят при проверке, а точность обнаружения равна длительности тика.
+// Таймеры дальше одного оборота колеса остаются в своей ячейке до нужного оборота.
+// Потокобезопасность обеспечивает владелец колеса.
+class TimerWheel {
+public:
+    // Инициализация: tickMs - длительность тика, slotCount - количество ячеек
+    void init(int64_t nowMs, int tickMs, int slotCount) {
+        tick = tickMs;
+        slots.assign(slotCount, std::list<Entry>());
+        timers.clear();
+        currentTick = nowMs / tick;
+    }
+
+    // Устанавливает или переносит таймер ключа на момент deadlineMs
+    void schedule(uint64_t key, int64_t deadlineMs) {
+        int slot = slotFor(deadlineMs);
+        auto found = timers.find(key);
+        if (found == timers.end()) {
+            slots[slot].push_back({key, deadlineMs, slot});
+            timers[key] = std::prev(slots[slot].end());
+            return;
+        }
+
+        auto entry = found->second;
+        entry->deadline = deadlineMs;
+        if (entry->slot != slot) {
+            slots[slot].splice(slots[slot].end(), slots[entry->slot], entry);
+            entry->slot = slot;
+        }
+    }
+
+    // Снимает таймер ключа, если он был установлен
+    void cancel(uint64_t key) {
+        auto found = timers.find(key);
+        if (found == timers.end()) return;
+        slots[found->second->slot].erase(found->second);
+        timers.erase(found);
+    }
+
+    // Продвигает колесо до момента nowMs и вызывает onExpire(key) для истекших таймеров.
+    // Истекший таймер снимается до вызова, поэтому onExpire может снова его установить
+    template <class Callback>
+    void advance(int64_t nowMs, Callback onExpire) {
+        int64_t targetTick = nowMs / tick;
+        if (targetTick <= currentTick) return;
+
+        // После долгой паузы достаточно одного оборота по всем ячейкам
+        int64_t firstTick = std::max(currentTick + 1, targetTick - (int64_t)slots.size() + 1);
+        expired.clear();
+        for (int64_t t = firstTick; t <= targetTick; t++) {
+            std::list<Entry>& slot = slots[t % slots.size()];
+            for (auto it = slot.begin(); it != slot.end(); ) {
+                if (it->deadline <= nowMs) {
+                    expired.push_back(it->key);
+                    timers.erase(it->key);
+                    it = slot.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        currentTick = targetTick;
+
+        for (uint64_t key : expired) {
+            onExpire(key);
+        }
+    }
+
+    size_t size() const { return timers.size(); }
+
+private:
+    struct Entry {
+        uint64_t key;
+        int64_t deadline;
+        int slot;
+    };
+
+    int slotFor(int64_t deadlineMs) const {
+        // Таймер срабатывает на первом тике после deadline, но не раньше следующего тика
+        int64_t t = std::max(deadlineMs / tick + 1, currentTick + 1);
+        return (int)(t % slots.size());
+    }
+
+    int tick = 1;
+    int64_t currentTick = 0;
+    std::vector<std::list<Entry>> slots;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> timers;
+    std::vector<uint64_t> expired;
+};
+
+#endif // BEE_TIMER_WHEEL_H
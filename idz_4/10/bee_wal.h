@@ -0,0 +1,538 @@
+// bee_wal.h
+#ifndef BEE_WAL_H
+#define BEE_WAL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bee_protocol.h"
+
+// Журнал упреждающей записи (WAL) и снимки состояния игры для восстановления после сбоя.
+// Рабочий поток не пишет в файл: он кладет запись фиксированного размера в собственное кольцо,
+// а фоновый поток раз в WAL_COMMIT_INTERVAL_MS дописывает записи всех колец в файл журнала и
+// выполняет один fdatasync на всю группу (групповая фиксация). Ответ стае не ждет фиксации:
+// потерянный при сбое хвост журнала восстанавливается повторами запросов стай.
+// Каждая запись получает глобальный порядковый номер. Изменения стаи записываются под мьютексом
+// ее шарда, поэтому номера записей одной стаи идут в порядке изменений, а стая помнит номер
+// своей последней записи. Снимок (исследованные секторы битовой картой и все стаи) делается без
+// остановки сервера: журнал переключается на следующий файл (поколение), состояние копируется,
+// снимок записывается во временный файл и атомарно переименовывается, после чего старые файлы
+// журнала удаляются. При восстановлении к снимку применяются записи журнала по возрастанию номеров;
+// запись стаи с номером не больше сохраненного в снимке уже учтена и пропускается, а отметки об
+// исследовании секторов можно применять повторно.
+#define WAL_RING_SIZE 65536 // Записей в кольце одного потока (степень двойки)
+#define WAL_COMMIT_INTERVAL_MS 5 // Период групповой фиксации журнала (мс)
+#define WAL_SNAPSHOT_INTERVAL_MS 30000 // Период снимков состояния (мс)
+#define WAL_SNAPSHOT_RECORDS 1000000 // Снимок делается раньше, если в журнале накопилось столько записей
+#define WAL_SNAPSHOT_MAGIC 0x53454542 // "BEES"
+#define WAL_SNAPSHOT_VERSION 1
+
+// Типы записей журнала
+enum WalRecordType : uint8_t {
+    WAL_SEARCHED = 1,    // value - исследованный сектор, флаг WAL_FLAG_WINNIE - в нем Винни-Пух
+    WAL_SWARM_JOIN = 2,  // Стая подключилась: value - IPv4 адрес, port - порт
+    WAL_SWARM_LEAVE = 3, // Стая отключилась (по запросу или по таймауту)
+    WAL_LEASE = 4,       // Стае выдан сектор value
+    WAL_LEASE_CLEAR = 5  // Аренда стаи возвращена в пул
+};
+
+#define WAL_FLAG_WINNIE 1 // В исследованном секторе Винни-Пух
+#define WAL_FLAG_BINARY 2 // Стая использует двоичный протокол
+
+// Запись журнала в файле и в кольце
+#pragma pack(push, 1)
+struct WalRecord {
+    uint64_t sequence;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t port;
+    int32_t swarmId;
+    int32_t value;
+    uint32_t checksum; // FNV-1a предыдущих полей: оборванная при сбое запись отбрасывается
+};
+#pragma pack(pop)
+
+// Стая в снимке состояния
+struct WalSwarm {
+    int32_t id = 0;
+    bool active = false;
+    bool disconnected = false;
+    bool binary = false;
+    uint32_t ip = 0;
+    uint16_t port = 0;
+    uint64_t walSequence = 0; // Номер последней учтенной записи стаи
+    int leaseCount = 0;
+    int32_t lease[BEE_MAX_BATCH];
+};
+
+// Состояние игры, которое сохраняется в снимке и восстанавливается при запуске
+struct WalState {
+    int sectorCount = 0;
+    int winnieSector = -1;
+    bool winnieFound = false;
+    uint64_t lastSequence = 0; // Наибольший номер записи, учтенной в состоянии
+    std::vector<uint64_t> searched; // Битовая карта исследованных секторов
+    std::vector<WalSwarm> swarms;
+
+    void reset(int sectors, int winnie) {
+        sectorCount = sectors;
+        winnieSector = winnie;
+        winnieFound = false;
+        searched.assign((sectors + 63) / 64, 0);
+        swarms.clear();
+    }
+    bool isSearched(int sector) const { return (searched[sector / 64] >> (sector % 64)) & 1; }
+    void setSearched(int sector) { searched[sector / 64] |= 1ULL << (sector % 64); }
+    int searchedCount() const {
+        int count = 0;
+        for (uint64_t word : searched) count += __builtin_popcountll(word);
+        return count;
+    }
+    // Игра окончена: продолжать ее после перезапуска незачем
+    bool finished() const { return winnieFound || searchedCount() == sectorCount; }
+};
+
+// FNV-1a для обнаружения оборванных записей и поврежденных снимков
+inline uint64_t walHash(const void* data, size_t len, uint64_t hash = 1469598103934665603ULL) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+inline uint32_t walRecordChecksum(const WalRecord& record) {
+    return (uint32_t)walHash(&record, offsetof(WalRecord, checksum));
+}
+
+// Кольцо записей одного потока: один писатель (поток-владелец) и один читатель (фоновый поток)
+struct WalRing {
+    WalRecord records[WAL_RING_SIZE];
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+};
+
+class WriteAheadLog {
+public:
+    bool enabled() const { return active.load(std::memory_order_relaxed); }
+
+    // Добавляет запись и возвращает ее номер (0 - журнал отключен).
+    // Если кольцо потока переполнено, запись теряется, а фоновый поток делает внеочередной снимок
+    uint64_t append(uint8_t type, int32_t swarmId, int32_t value = 0, uint16_t port = 0, uint8_t flags = 0) {
+        if (!enabled()) return 0;
+        WalRing& ring = threadRing();
+        uint64_t sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        if (head - ring.tail.load(std::memory_order_acquire) >= WAL_RING_SIZE) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return sequence;
+        }
+        WalRecord& record = ring.records[head & (WAL_RING_SIZE - 1)];
+        record.sequence = sequence;
+        record.type = type;
+        record.flags = flags;
+        record.port = port;
+        record.swarmId = swarmId;
+        record.value = value;
+        record.checksum = walRecordChecksum(record);
+        ring.head.store(head + 1, std::memory_order_release);
+        return sequence;
+    }
+
+    // Читает снимок и журнал из каталога dir. Возвращает false, если сохраненного состояния нет
+    bool recover(const std::string& dir, WalState& state, size_t& replayed) {
+        replayed = 0;
+        uint32_t firstGeneration = 0;
+        if (!readSnapshot(dir + "/snapshot", state, firstGeneration)) return false;
+
+        // Записи всех оставшихся поколений журнала применяются по возрастанию номеров
+        std::vector<WalRecord> records;
+        for (uint32_t generation : listGenerations(dir)) {
+            if (generation >= firstGeneration) readJournal(journalPath(dir, generation), records);
+        }
+        std::sort(records.begin(), records.end(),
+                  [](const WalRecord& a, const WalRecord& b) { return a.sequence < b.sequence; });
+
+        std::unordered_map<int32_t, size_t> swarmIndex;
+        for (size_t i = 0; i < state.swarms.size(); i++) swarmIndex[state.swarms[i].id] = i;
+        for (const WalRecord& record : records) {
+            if (apply(state, swarmIndex, record)) replayed++;
+            state.lastSequence = std::max(state.lastSequence, record.sequence);
+        }
+        return true;
+    }
+
+    // Записывает начальный снимок state, удаляет старые файлы и запускает фоновый поток.
+    // capture копирует текущее состояние сервера для следующих снимков
+    bool start(const std::string& dir, const WalState& state, std::function<void(WalState&)> capture) {
+        directory = dir;
+        captureState = capture;
+        if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+            perror("Ошибка создания каталога состояния");
+            return false;
+        }
+        nextSequence = state.lastSequence + 1;
+
+        std::vector<uint32_t> generations = listGenerations(dir);
+        generation = generations.empty() ? 1 : generations.back() + 1;
+        if (!writeSnapshot(state, generation)) return false;
+        for (uint32_t old : generations) unlink(journalPath(dir, old).c_str());
+        if (!openJournal()) return false;
+
+        active = true;
+        writerRunning = true;
+        writer = std::thread([this]() { writerLoop(); });
+        return true;
+    }
+
+    // Фиксирует оставшиеся записи и останавливает фоновый поток. Вызывается после остановки рабочих потоков
+    void stop() {
+        if (!writerRunning) return;
+        writerRunning = false;
+        if (writer.joinable()) writer.join();
+        commit();
+        active = false;
+        if (journalFd >= 0) close(journalFd);
+        journalFd = -1;
+    }
+
+    unsigned long recordsWritten() const { return written; }
+    unsigned long syncCount() const { return syncs; }
+    unsigned long snapshotCount() const { return snapshots; }
+    unsigned long droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+    // Записи, которые потоки уже добавили, а фоновый поток еще не забрал из колец
+    unsigned long pendingCount() {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        unsigned long pending = 0;
+        for (auto& ring : rings) {
+            pending += ring->head.load(std::memory_order_acquire) - ring->tail.load(std::memory_order_acquire);
+        }
+        return pending;
+    }
+
+private:
+    WalRing& threadRing() {
+        thread_local WalRing* ring = nullptr;
+        if (ring == nullptr) {
+            std::unique_ptr<WalRing> created(new WalRing());
+            ring = created.get();
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.push_back(std::move(created));
+        }
+        return *ring;
+    }
+
+    static std::string journalPath(const std::string& dir, uint32_t generation) {
+        return dir + "/wal." + std::to_string(generation);
+    }
+
+    // Номера поколений журнала в каталоге по возрастанию
+    static std::vector<uint32_t> listGenerations(const std::string& dir) {
+        std::vector<uint32_t> generations;
+        DIR* d = opendir(dir.c_str());
+        if (d == nullptr) return generations;
+        while (struct dirent* entry = readdir(d)) {
+            if (strncmp(entry->d_name, "wal.", 4) == 0) generations.push_back((uint32_t)strtoul(entry->d_name + 4, nullptr, 10));
+        }
+        closedir(d);
+        std::sort(generations.begin(), generations.end());
+        return generations;
+    }
+
+    // Читает записи файла журнала до конца или до первой оборванной записи
+    static void readJournal(const std::string& path, std::vector<WalRecord>& records) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        std::vector<WalRecord> buffer(4096);
+        size_t pending = 0; // Байты неполной записи в начале буфера
+        bool intact = true;
+        while (intact) {
+            ssize_t n = read(fd, (char*)buffer.data() + pending, buffer.size() * sizeof(WalRecord) - pending);
+            if (n <= 0) break;
+            size_t bytes = pending + n;
+            size_t count = bytes / sizeof(WalRecord);
+            for (size_t i = 0; i < count; i++) {
+                if (buffer[i].checksum != walRecordChecksum(buffer[i])) {
+                    intact = false;
+                    break;
+                }
+                records.push_back(buffer[i]);
+            }
+            pending = bytes % sizeof(WalRecord);
+            memmove(buffer.data(), (char*)buffer.data() + count * sizeof(WalRecord), pending);
+        }
+        close(fd);
+    }
+
+    static bool apply(WalState& state, std::unordered_map<int32_t, size_t>& swarmIndex, const WalRecord& record) {
+        if (record.type == WAL_SEARCHED) {
+            if (record.value < 0 || record.value >= state.sectorCount) return false;
+            state.setSearched(record.value);
+            if (record.flags & WAL_FLAG_WINNIE) state.winnieFound = true;
+            return true;
+        }
+
+        auto found = swarmIndex.find(record.swarmId);
+        if (found == swarmIndex.end()) {
+            found = swarmIndex.emplace(record.swarmId, state.swarms.size()).first;
+            state.swarms.emplace_back();
+            state.swarms.back().id = record.swarmId;
+        }
+        WalSwarm& swarm = state.swarms[found->second];
+        if (record.sequence <= swarm.walSequence) return false; // Уже учтено в снимке
+        swarm.walSequence = record.sequence;
+
+        switch (record.type) {
+        case WAL_SWARM_JOIN:
+            swarm.active = true;
+            swarm.disconnected = false;
+            swarm.binary = record.flags & WAL_FLAG_BINARY;
+            swarm.ip = (uint32_t)record.value;
+            swarm.port = record.port;
+            break;
+        case WAL_SWARM_LEAVE:
+            swarm.active = false;
+            swarm.disconnected = true;
+            swarm.leaseCount = 0;
+            break;
+        case WAL_LEASE:
+            if (swarm.leaseCount < BEE_MAX_BATCH) swarm.lease[swarm.leaseCount++] = record.value;
+            break;
+        case WAL_LEASE_CLEAR:
+            swarm.leaseCount = 0;
+            break;
+        default:
+            return false;
+        }
+        return true;
+    }
+
+    // Заголовок файла снимка; за ним битовая карта секторов, стаи и контрольная сумма всего файла
+    struct SnapshotHeader {
+        uint32_t magic;
+        uint32_t version;
+        int32_t sectorCount;
+        int32_t winnieSector;
+        uint32_t winnieFound;
+        uint32_t generation; // Первое поколение журнала, которое применяется к снимку
+        uint64_t lastSequence;
+        uint64_t swarmCount;
+    };
+
+    bool writeSnapshot(const WalState& state, uint32_t journalGeneration) {
+        std::string path = directory + "/snapshot";
+        std::string tmpPath = path + ".tmp";
+        int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            perror("Ошибка создания снимка состояния");
+            return false;
+        }
+
+        SnapshotHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = WAL_SNAPSHOT_MAGIC;
+        header.version = WAL_SNAPSHOT_VERSION;
+        header.sectorCount = state.sectorCount;
+        header.winnieSector = state.winnieSector;
+        header.winnieFound = state.winnieFound;
+        header.generation = journalGeneration;
+        header.lastSequence = state.lastSequence;
+        header.swarmCount = state.swarms.size();
+
+        uint64_t hash = walHash(&header, sizeof(header));
+        hash = walHash(state.searched.data(), state.searched.size() * sizeof(uint64_t), hash);
+        hash = walHash(state.swarms.data(), state.swarms.size() * sizeof(WalSwarm), hash);
+
+        bool ok = writeAll(fd, &header, sizeof(header)) &&
+                  writeAll(fd, state.searched.data(), state.searched.size() * sizeof(uint64_t)) &&
+                  writeAll(fd, state.swarms.data(), state.swarms.size() * sizeof(WalSwarm)) &&
+                  writeAll(fd, &hash, sizeof(hash)) && fsync(fd) == 0;
+        close(fd);
+        if (!ok || rename(tmpPath.c_str(), path.c_str()) < 0) {
+            perror("Ошибка записи снимка состояния");
+            return false;
+        }
+        syncDirectory();
+        snapshots++;
+        return true;
+    }
+
+    static bool readSnapshot(const std::string& path, WalState& state, uint32_t& journalGeneration) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        SnapshotHeader header;
+        bool ok = readAll(fd, &header, sizeof(header)) && header.magic == WAL_SNAPSHOT_MAGIC &&
+                  header.version == WAL_SNAPSHOT_VERSION && header.sectorCount > 0;
+        if (ok) {
+            state.reset(header.sectorCount, header.winnieSector);
+            state.winnieFound = header.winnieFound;
+            state.lastSequence = header.lastSequence;
+            state.swarms.resize(header.swarmCount);
+            journalGeneration = header.generation;
+
+            uint64_t stored = 0;
+            ok = readAll(fd, state.searched.data(), state.searched.size() * sizeof(uint64_t)) &&
+                 readAll(fd, state.swarms.data(), state.swarms.size() * sizeof(WalSwarm)) &&
+                 readAll(fd, &stored, sizeof(stored));
+            uint64_t hash = walHash(&header, sizeof(header));
+            hash = walHash(state.searched.data(), state.searched.size() * sizeof(uint64_t), hash);
+            hash = walHash(state.swarms.data(), state.swarms.size() * sizeof(WalSwarm), hash);
+            ok = ok && stored == hash;
+        }
+        close(fd);
+        if (!ok) std::cerr << "Снимок состояния " << path << " поврежден и не будет использован" << std::endl;
+        return ok;
+    }
+
+    static bool writeAll(int fd, const void* data, size_t len) {
+        const char* p = (const char*)data;
+        while (len > 0) {
+            ssize_t n = write(fd, p, len);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    static bool readAll(int fd, void* data, size_t len) {
+        char* p = (char*)data;
+        while (len > 0) {
+            ssize_t n = read(fd, p, len);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                return false;
+            }
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // Переименование файла надежно только после fsync каталога
+    void syncDirectory() {
+        int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0) return;
+        fsync(fd);
+        close(fd);
+    }
+
+    bool openJournal() {
+        journalFd = open(journalPath(directory, generation).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (journalFd < 0) {
+            perror("Ошибка открытия журнала");
+            return false;
+        }
+        syncDirectory();
+        return true;
+    }
+
+    // Забирает записи из всех колец, дописывает их в журнал и фиксирует одним fdatasync
+    void commit() {
+        batch.clear();
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            for (auto& ring : rings) {
+                uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+                uint64_t head = ring->head.load(std::memory_order_acquire);
+                for (; tail != head; tail++) batch.push_back(ring->records[tail & (WAL_RING_SIZE - 1)]);
+                ring->tail.store(tail, std::memory_order_release);
+            }
+        }
+        if (batch.empty() || journalFd < 0) return;
+
+        if (!writeAll(journalFd, batch.data(), batch.size() * sizeof(WalRecord))) {
+            perror("Ошибка записи журнала");
+            return;
+        }
+        if (fdatasync(journalFd) < 0) perror("Ошибка fdatasync журнала");
+        written += batch.size();
+        sinceSnapshot += batch.size();
+        syncs++;
+    }
+
+    // Переключает журнал на новое поколение, копирует состояние и записывает снимок.
+    // Записи, попавшие в новое поколение до копирования, при восстановлении применяются повторно
+    // и отсеиваются по номерам
+    void takeSnapshot() {
+        uint32_t previous = generation;
+        close(journalFd);
+        generation++;
+        if (!openJournal()) return;
+
+        // Номер берется после копирования: он не меньше номеров записей, учтенных в копии
+        captureState(snapshotState);
+        snapshotState.lastSequence = nextSequence.load() - 1;
+        if (writeSnapshot(snapshotState, generation)) {
+            for (uint32_t old : listGenerations(directory)) {
+                if (old <= previous) unlink(journalPath(directory, old).c_str());
+            }
+        }
+        sinceSnapshot = 0;
+    }
+
+    void writerLoop() {
+        auto lastSnapshot = std::chrono::steady_clock::now();
+        unsigned long droppedAtSnapshot = 0;
+        while (writerRunning) {
+            commit();
+
+            // Потерянные при переполнении кольца записи покрывает внеочередной снимок
+            auto now = std::chrono::steady_clock::now();
+            unsigned long droppedNow = droppedCount();
+            bool due = sinceSnapshot > 0 && now - lastSnapshot >= std::chrono::milliseconds(WAL_SNAPSHOT_INTERVAL_MS);
+            if (due || sinceSnapshot >= WAL_SNAPSHOT_RECORDS || droppedNow != droppedAtSnapshot) {
+                takeSnapshot();
+                lastSnapshot = now;
+                droppedAtSnapshot = droppedNow;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(WAL_COMMIT_INTERVAL_MS));
+        }
+    }
+
+    std::atomic<bool> active{false};
+    std::atomic<uint64_t> nextSequence{1};
+    std::atomic<unsigned long> dropped{0};
+    std::mutex ringsMutex;
+    std::vector<std::unique_ptr<WalRing>> rings;
+
+    // Состояние фонового потока
+    std::string directory;
+    std::function<void(WalState&)> captureState;
+    uint32_t generation = 0;
+    int journalFd = -1;
+    std::vector<WalRecord> batch;
+    WalState snapshotState;
+    unsigned long sinceSnapshot = 0;
+    std::atomic<bool> writerRunning{false};
+    std::thread writer;
+    unsigned long written = 0;
+    unsigned long syncs = 0;
+    unsigned long snapshots = 0;
+};
+
+#endif // BEE_WAL_H